@@ -155,8 +155,10 @@ protected:
         return m_value == reinterpret_cast<const Value<tag, T> *>(other)->m_value;
     }
     bool less(const JsonValue * other) const {
-        return m_value < reinterpret_cast<const Value<tag, T> *>(other)->m_value;
+        return lt(m_value, reinterpret_cast<const Value<tag, T> *>(other)->m_value);
     }
+    template<class U> static bool lt(const U& a, const U& b) { return a < b; }
+    static bool lt(std::nullptr_t, std::nullptr_t) { return false; }
 
     const T m_value;
     void dump(string &out) const { json11::dump(m_value, out); }
@@ -38,6 +38,20 @@ public:
     m_ptr.reset();
   }
 
+  /// <returns>
+  /// A pointer to the same object of the same type which does not share ownership of it
+  /// </returns>
+  /// <remarks>
+  /// Copying the returned pointer does not touch any reference count.  The caller is responsible for
+  /// ensuring that the object outlives every copy.
+  /// </remarks>
+  AnySharedPointer unowned(void) const {
+    AnySharedPointer retVal;
+    retVal.m_ti = m_ti;
+    retVal.m_ptr = std::shared_ptr<void>(std::shared_ptr<void>{}, m_ptr.get());
+    return retVal;
+  }
+
   std::shared_ptr<CoreObject> as_obj(void) const {
     return
       m_ti.block->pToObj ?
@@ -82,6 +96,10 @@ public:
   }
 
   bool operator==(const AnySharedPointer& rhs) const {
+    // Unowned pointers have no control block, and so can only be compared by address
+    if (!m_ptr.use_count() || !rhs.m_ptr.use_count())
+      return m_ptr.get() == rhs.m_ptr.get();
+
     // Need to compare the control blocks, not the pointer values, because we could be pointing to
     // different spots in the same object.
     return
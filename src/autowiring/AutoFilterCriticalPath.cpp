@@ -0,0 +1,213 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#include "stdafx.h"
+#include "AutoFilterCriticalPath.h"
+#include "demangle.h"
+#include <algorithm>
+#include <deque>
+#include <iomanip>
+#include <ostream>
+#include <unordered_map>
+
+using namespace autowiring;
+
+AutoFilterCriticalPath::AutoFilterCriticalPath(const std::vector<AutoFilterDescriptor>& descriptors, const std::vector<AutoFilterProfile>& profiles) {
+  m_filters.resize(descriptors.size());
+  for (size_t i = 0; i < descriptors.size(); i++) {
+    AutoFilterSchedule& filter = m_filters[i];
+    filter.descriptor = descriptors[i];
+
+    // Profiles identify filters the same way descriptors do, by address and call routine
+    for (const auto& profile : profiles)
+      if (profile.pFilter == filter.descriptor.GetAutoFilter().ptr() && profile.descriptor.GetCall() == filter.descriptor.GetCall()) {
+        filter.latency = profile.latency.GetMean();
+        break;
+      }
+    m_totalWork += filter.latency;
+  }
+
+  // Producers, modifiers and consumers of each decoration
+  struct Users {
+    std::vector<size_t> producers;
+    std::vector<size_t> modifiers;
+    std::vector<size_t> consumers;
+  };
+  std::unordered_map<auto_id, Users> users;
+  for (size_t i = 0; i < m_filters.size(); i++) {
+    const AutoFilterDescriptor& descriptor = m_filters[i].descriptor;
+    const AutoFilterArgument* args = descriptor.GetAutoFilterArguments();
+    for (size_t j = 0; j < descriptor.GetArity(); j++) {
+      if (args[j].tshift)
+        // Satisfied by an earlier packet
+        continue;
+
+      Users& cur = users[args[j].id];
+      if (args[j].is_rvalue)
+        cur.modifiers.push_back(i);
+      else if (args[j].is_output)
+        cur.producers.push_back(i);
+      else if (args[j].is_input)
+        cur.consumers.push_back(i);
+    }
+  }
+
+  auto link = [this] (const std::vector<size_t>& from, const std::vector<size_t>& to) {
+    for (size_t src : from)
+      for (size_t dst : to)
+        if (src != dst) {
+          m_filters[src].successors.push_back(dst);
+          m_filters[dst].predecessors.push_back(src);
+        }
+  };
+  for (const auto& cur : users) {
+    link(cur.second.producers, cur.second.modifiers);
+    link(cur.second.producers, cur.second.consumers);
+    link(cur.second.modifiers, cur.second.consumers);
+  }
+
+  // Filters sharing more than one decoration are only linked once
+  auto unique = [] (std::vector<size_t>& indices) {
+    std::sort(indices.begin(), indices.end());
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+  };
+  for (auto& filter : m_filters) {
+    unique(filter.predecessors);
+    unique(filter.successors);
+  }
+
+  // Topological order, any filters caught in a cycle are placed last in the order they were given
+  std::vector<size_t> order;
+  std::vector<size_t> position(m_filters.size(), ~size_t(0));
+  {
+    std::vector<size_t> nRemaining(m_filters.size());
+    std::deque<size_t> ready;
+    for (size_t i = 0; i < m_filters.size(); i++)
+      if (!(nRemaining[i] = m_filters[i].predecessors.size()))
+        ready.push_back(i);
+
+    for (; !ready.empty(); ready.pop_front()) {
+      position[ready.front()] = order.size();
+      order.push_back(ready.front());
+      for (size_t successor : m_filters[ready.front()].successors)
+        if (!--nRemaining[successor])
+          ready.push_back(successor);
+    }
+
+    for (size_t i = 0; i < m_filters.size(); i++)
+      if (position[i] == ~size_t(0)) {
+        position[i] = order.size();
+        order.push_back(i);
+      }
+  }
+
+  // Only edges which agree with the order are considered, the rest close a cycle
+  for (size_t i : order) {
+    AutoFilterSchedule& filter = m_filters[i];
+    for (size_t predecessor : filter.predecessors)
+      if (position[predecessor] < position[i])
+        filter.earliestStart = std::max(filter.earliestStart, m_filters[predecessor].earliestStart + m_filters[predecessor].latency);
+    m_length = std::max(m_length, filter.earliestStart + filter.latency);
+  }
+
+  for (auto i = order.rbegin(); i != order.rend(); ++i) {
+    AutoFilterSchedule& filter = m_filters[*i];
+    std::chrono::nanoseconds latestFinish = m_length;
+    for (size_t successor : filter.successors)
+      if (position[*i] < position[successor])
+        latestFinish = std::min(latestFinish, m_filters[successor].latestStart);
+    filter.latestStart = latestFinish - filter.latency;
+  }
+
+  // Walk back from the filter that finishes last, through the predecessor that held up each filter
+  size_t last = ~size_t(0);
+  for (size_t i : order)
+    if (last == ~size_t(0) || m_filters[i].earliestStart + m_filters[i].latency > m_filters[last].earliestStart + m_filters[last].latency)
+      last = i;
+
+  for (size_t cur = last; cur != ~size_t(0);) {
+    m_criticalPath.push_back(cur);
+
+    size_t next = ~size_t(0);
+    for (size_t predecessor : m_filters[cur].predecessors)
+      if (
+        position[predecessor] < position[cur] &&
+        m_filters[predecessor].earliestStart + m_filters[predecessor].latency == m_filters[cur].earliestStart &&
+        m_filters[predecessor].IsCritical()
+      ) {
+        next = predecessor;
+        break;
+      }
+    cur = next;
+  }
+  std::reverse(m_criticalPath.begin(), m_criticalPath.end());
+}
+
+double AutoFilterCriticalPath::GetSpeedup(void) const {
+  if (!m_length.count())
+    return 1.0;
+  return static_cast<double>(m_totalWork.count()) / m_length.count();
+}
+
+/// <returns>The specified duration in microseconds</returns>
+static double us(std::chrono::nanoseconds duration) {
+  return duration.count() / 1000.0;
+}
+
+void AutoFilterCriticalPath::Write(std::ostream& os) const {
+  os << "Critical path: " << us(m_length) << " us" << std::endl
+     << "Total work: " << us(m_totalWork) << " us" << std::endl
+     << "Speedup bound: " << GetSpeedup() << std::endl;
+
+  for (size_t i : m_criticalPath)
+    os << "  " << demangle(m_filters[i].descriptor.GetType()) << " (" << us(m_filters[i].latency) << " us)" << std::endl;
+  os << std::endl;
+
+  os << std::left << std::setw(40) << "AutoFilter" << std::right
+     << std::setw(14) << "latency(us)"
+     << std::setw(14) << "start(us)"
+     << std::setw(14) << "slack(us)"
+     << std::setw(10) << "critical" << std::endl;
+
+  for (const auto& filter : m_filters)
+    os << std::left << std::setw(40) << demangle(filter.descriptor.GetType()) << std::right
+       << std::setw(14) << us(filter.latency)
+       << std::setw(14) << us(filter.earliestStart)
+       << std::setw(14) << us(filter.GetSlack())
+       << std::setw(10) << (filter.IsCritical() ? "yes" : "") << std::endl;
+}
+
+/// <returns>The specified name with double quotes replaced, so that it may be used as a GraphViz label</returns>
+static std::string Quote(std::string name) {
+  std::replace(name.begin(), name.end(), '"', '\'');
+  return '"' + name + '"';
+}
+
+void AutoFilterCriticalPath::WriteGV(std::ostream& os) const {
+  os << "digraph AutoFilterCriticalPath {" << std::endl;
+
+  for (size_t i = 0; i < m_filters.size(); i++) {
+    const AutoFilterSchedule& filter = m_filters[i];
+    os << i << " [shape=box label="
+       << Quote(
+         demangle(filter.descriptor.GetType()) +
+         "\\nlatency " + std::to_string(us(filter.latency)) + " us" +
+         "\\nslack " + std::to_string(us(filter.GetSlack())) + " us"
+       );
+    if (filter.IsCritical())
+      os << " color=red";
+    os << "];" << std::endl;
+  }
+
+  for (size_t i = 0; i < m_filters.size(); i++)
+    for (size_t successor : m_filters[i].successors) {
+      os << i << " -> " << successor;
+      if (
+        m_filters[i].IsCritical() &&
+        m_filters[successor].IsCritical() &&
+        m_filters[i].earliestStart + m_filters[i].latency == m_filters[successor].earliestStart
+      )
+        os << " [color=red penwidth=2]";
+      os << ";" << std::endl;
+    }
+
+  os << "}" << std::endl;
+}
@@ -0,0 +1,95 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#pragma once
+#include "AutoFilterDescriptor.h"
+#include "AutoFilterProfiler.h"
+#include CHRONO_HEADER
+#include <iosfwd>
+#include <vector>
+
+namespace autowiring {
+
+/// <summary>
+/// A single AutoFilter as scheduled by an AutoFilterCriticalPath
+/// </summary>
+struct AutoFilterSchedule {
+  AutoFilterDescriptor descriptor;
+
+  // The mean time taken by a call to this filter, or zero if the filter has never been profiled
+  std::chrono::nanoseconds latency{0};
+
+  // The earliest time at which this filter can be called, measured from the issuance of a packet with
+  // every filter run as soon as its inputs are available, and the latest time at which it can be called
+  // without lengthening the critical path
+  std::chrono::nanoseconds earliestStart{0};
+  std::chrono::nanoseconds latestStart{0};
+
+  // Indices of the filters which produce an input to this filter, and which consume an output of it
+  std::vector<size_t> predecessors;
+  std::vector<size_t> successors;
+
+  /// <returns>The time by which this filter may be delayed without delaying the packet</returns>
+  std::chrono::nanoseconds GetSlack(void) const { return latestStart - earliestStart; }
+
+  /// <returns>True if speeding up this filter would shorten the critical path</returns>
+  bool IsCritical(void) const { return GetSlack() == std::chrono::nanoseconds::zero(); }
+};
+
+/// <summary>
+/// Combines the dependency graph of a set of AutoFilters with their measured latencies to find the
+/// sequence of filters which bounds the time taken to process a packet
+/// </summary>
+/// <remarks>
+/// A filter depends on every filter which produces or modifies one of its inputs, and a filter which
+/// modifies a decoration depends on every filter which produces it.  Time-shifted inputs are satisfied
+/// by earlier packets and so do not constrain scheduling.  Each filter is weighted by its mean latency
+/// as recorded by an AutoFilterProfiler; deferred filters are weighted by the time taken to queue them,
+/// not by the time taken to run them.
+///
+/// Dependency cycles cannot be satisfied by any packet.  Should the graph contain one, the edges
+/// which close it are ignored.
+/// </remarks>
+class AutoFilterCriticalPath {
+public:
+  AutoFilterCriticalPath(const std::vector<AutoFilterDescriptor>& descriptors, const std::vector<AutoFilterProfile>& profiles);
+
+private:
+  std::vector<AutoFilterSchedule> m_filters;
+
+  // Indices of the filters on the critical path, in the order in which they are called
+  std::vector<size_t> m_criticalPath;
+
+  std::chrono::nanoseconds m_length{0};
+  std::chrono::nanoseconds m_totalWork{0};
+
+public:
+  // Accessor methods:
+  const std::vector<AutoFilterSchedule>& GetFilters(void) const { return m_filters; }
+  const std::vector<size_t>& GetCriticalPath(void) const { return m_criticalPath; }
+
+  /// <returns>The time taken to process a packet if every filter were run as soon as it could be</returns>
+  std::chrono::nanoseconds GetLength(void) const { return m_length; }
+
+  /// <returns>The time taken to process a packet if every filter were run on a single thread</returns>
+  std::chrono::nanoseconds GetTotalWork(void) const { return m_totalWork; }
+
+  /// <returns>
+  /// The largest speedup which running filters in parallel could give over running them on a single
+  /// thread, which is the ratio of the total work to the length of the critical path
+  /// </returns>
+  double GetSpeedup(void) const;
+
+  /// <summary>
+  /// Writes the critical path and the slack of each filter as a table
+  /// </summary>
+  void Write(std::ostream& os) const;
+
+  /// <summary>
+  /// Writes the filter dependency graph in GraphViz format, annotated with latency and slack
+  /// </summary>
+  /// <remarks>
+  /// Filters and edges on the critical path are drawn in red
+  /// </remarks>
+  void WriteGV(std::ostream& os) const;
+};
+
+}
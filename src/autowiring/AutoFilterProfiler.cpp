@@ -0,0 +1,75 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#include "stdafx.h"
+#include "AutoFilterProfiler.h"
+#include <algorithm>
+#include <thread>
+
+using namespace autowiring;
+
+AutoFilterProfiler::AutoFilterProfiler(void) {}
+
+AutoFilterProfiler::~AutoFilterProfiler(void) {}
+
+AutoFilterProfiler::Entry& AutoFilterProfiler::FindEntry(const AutoFilterDescriptor& filter) {
+  Shard& shard = m_shards[std::hash<std::thread::id>()(std::this_thread::get_id()) % sc_nShards];
+
+  // Entries are never removed from a shard, so the returned entry remains valid once the lock is released
+  std::lock_guard<std::mutex> lk(shard.lock);
+  auto& entry = shard.entries[t_key{filter.GetAutoFilter().ptr(), filter.GetCall()}];
+  if (!entry)
+    entry.reset(new Entry(filter));
+  return *entry;
+}
+
+void AutoFilterProfiler::RecordCall(const AutoFilterDescriptor& filter, std::chrono::nanoseconds duration) {
+  FindEntry(filter).latency.Record(duration);
+}
+
+void AutoFilterProfiler::RecordSkip(const AutoFilterDescriptor& filter) {
+  FindEntry(filter).nSkipped.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<AutoFilterProfile> AutoFilterProfiler::GetProfiles(void) const {
+  std::vector<AutoFilterProfile> retVal;
+  std::unordered_map<t_key, size_t, KeyHash> indexes;
+
+  for (auto& shard : m_shards) {
+    std::lock_guard<std::mutex> lk(shard.lock);
+    for (auto& entry : shard.entries) {
+      auto q = indexes.find(entry.first);
+      if (q == indexes.end()) {
+        q = indexes.emplace(entry.first, retVal.size()).first;
+        retVal.emplace_back();
+        retVal.back().descriptor = entry.second->descriptor;
+        retVal.back().pFilter = entry.first.first;
+      }
+
+      AutoFilterProfile& profile = retVal[q->second];
+      profile.nSkipped += entry.second->nSkipped.load(std::memory_order_relaxed);
+      profile.latency.Merge(entry.second->latency);
+    }
+  }
+
+  // Entries persist across a reset, leave out those with nothing recorded since then
+  retVal.erase(
+    std::remove_if(
+      retVal.begin(),
+      retVal.end(),
+      [] (const AutoFilterProfile& profile) {
+        return !profile.nSkipped && !profile.GetCallCount();
+      }
+    ),
+    retVal.end()
+  );
+  return retVal;
+}
+
+void AutoFilterProfiler::Reset(void) {
+  for (auto& shard : m_shards) {
+    std::lock_guard<std::mutex> lk(shard.lock);
+    for (auto& entry : shard.entries) {
+      entry.second->nSkipped.store(0, std::memory_order_relaxed);
+      entry.second->latency.Reset();
+    }
+  }
+}
@@ -0,0 +1,95 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#pragma once
+#include "AutoFilterDescriptor.h"
+#include "LatencyHistogram.h"
+#include MEMORY_HEADER
+#include MUTEX_HEADER
+#include <unordered_map>
+#include <vector>
+
+namespace autowiring {
+
+/// <summary>
+/// Statistics gathered about a single AutoFilter
+/// </summary>
+struct AutoFilterProfile {
+  // The filter these statistics describe.  The filter itself is identified by address only, because
+  // statistics may outlive the filter.
+  AutoFilterDescriptorStub descriptor;
+  const void* pFilter = nullptr;
+
+  // The number of packets on which the filter was never called because its inputs could not be satisfied
+  uint64_t nSkipped = 0;
+
+  // The time taken by each call to the filter.  The number of samples is the number of calls.
+  LatencyHistogram latency;
+
+  /// <returns>The number of times the filter was called</returns>
+  uint64_t GetCallCount(void) const { return latency.GetCount(); }
+};
+
+/// <summary>
+/// Accumulates AutoFilterProfile statistics for each AutoFilter called by an AutoPacketFactory's packets
+/// </summary>
+/// <remarks>
+/// Statistics are recorded to one of several shards, chosen by the identity of the recording thread, so
+/// that filters being called on different threads rarely contend with one another.  The shards are only
+/// combined when profiles are requested.
+/// </remarks>
+class AutoFilterProfiler {
+public:
+  AutoFilterProfiler(void);
+  ~AutoFilterProfiler(void);
+
+  // The number of shards among which recording threads are distributed
+  static const size_t sc_nShards = 16;
+
+private:
+  // Filters are identified by their address and call routine, as they are by AutoFilterDescriptor
+  typedef std::pair<const void*, t_extractedCall> t_key;
+
+  struct KeyHash {
+    size_t operator()(const t_key& key) const { return (size_t)key.first; }
+  };
+
+  struct Entry {
+    Entry(const AutoFilterDescriptorStub& descriptor) :
+      descriptor(descriptor)
+    {}
+
+    const AutoFilterDescriptorStub descriptor;
+    std::atomic<uint64_t> nSkipped{0};
+    LatencyHistogram latency;
+  };
+
+  struct Shard {
+    mutable std::mutex lock;
+    std::unordered_map<t_key, std::unique_ptr<Entry>, KeyHash> entries;
+  };
+
+  Shard m_shards[sc_nShards];
+
+  /// <returns>The entry for the specified filter in the current thread's shard, which is created if needed</returns>
+  Entry& FindEntry(const AutoFilterDescriptor& filter);
+
+public:
+  /// <summary>
+  /// Records one call to the specified filter, which took the specified amount of time
+  /// </summary>
+  void RecordCall(const AutoFilterDescriptor& filter, std::chrono::nanoseconds duration);
+
+  /// <summary>
+  /// Records that a packet is being discarded without having called the specified filter
+  /// </summary>
+  void RecordSkip(const AutoFilterDescriptor& filter);
+
+  /// <returns>The statistics for every filter that has been called or skipped since the last reset</returns>
+  std::vector<AutoFilterProfile> GetProfiles(void) const;
+
+  /// <summary>
+  /// Discards all statistics recorded so far
+  /// </summary>
+  void Reset(void);
+};
+
+}
@@ -4,14 +4,20 @@
 #include "AutoPacket.h"
 #include "AutoPacketFactory.h"
 #include "AutoPacketInternal.hpp"
+#include "AutoPacketTemplate.h"
 #include "AutoFilterDescriptor.h"
+#include "AutoFilterProfiler.h"
 #include "autowiring_error.h"
 #include "ContextEnumerator.h"
 #include "demangle.h"
+#include "FlightRecorder.h"
+#include "PacketContinuation.h"
 #include "SatCounter.h"
 #include "thread_specific_ptr.h"
+#include "ThreadPool.h"
 #include <algorithm>
 #include <sstream>
+#include ATOMIC_HEADER
 #include RVALUE_HEADER
 
 using namespace autowiring;
@@ -21,6 +27,65 @@ using namespace autowiring;
 /// </summary>
 static thread_specific_ptr<AutoPacket> autoCurrentPacket{ nullptr };
 
+namespace {
+  /// <summary>
+  /// The instruments applied to each AutoFilter call made on a packet
+  /// </summary>
+  struct CallInstruments {
+    autowiring::AutoFilterProfiler* profiler;
+    autowiring::FlightRecorder* recorder;
+    uint64_t sequence;
+  };
+}
+
+/// <returns>
+/// True if the specified filter takes an optional input, and so is prepared to run on whatever a late
+/// packet has to offer
+/// </returns>
+static bool HasOptionalInput(const AutoFilterArgument* args) {
+  for (; *args; args++)
+    if (args->is_input && args->is_shared && !args->is_multi)
+      return true;
+  return false;
+}
+
+/// <summary>
+/// Calls the AutoFilter held by the specified counter, timing and recording the call as requested
+/// </summary>
+/// <remarks>
+/// Nothing is called if the packet has been abandoned.  If the packet's deadline has passed, the filter
+/// is shed unless it takes an optional input.
+/// </remarks>
+static void CallFilter(const CallInstruments& instruments, const SatCounter& call, AutoPacket& packet) {
+  if (packet.IsAbandoned())
+    // The factory gave up on this packet, don't start anything new
+    return;
+
+  if (packet.ShedIfPastDeadline(call.GetAutoFilterArguments()))
+    return;
+
+  if (!instruments.profiler && !instruments.recorder) {
+    call.GetCall()(call.GetAutoFilter().ptr(), packet, call.dispositions);
+    return;
+  }
+
+  // Calls which throw are recorded as well, they still took time
+  if (instruments.recorder)
+    instruments.recorder->Record(FlightEvent::Type::FilterStarted, instruments.sequence, call.GetType());
+  std::chrono::steady_clock::time_point start;
+  if (instruments.profiler)
+    start = std::chrono::steady_clock::now();
+  auto record = MakeAtExit(
+    [&] {
+      if (instruments.profiler)
+        instruments.profiler->RecordCall(call, std::chrono::steady_clock::now() - start);
+      if (instruments.recorder)
+        instruments.recorder->Record(FlightEvent::Type::FilterFinished, instruments.sequence, call.GetType());
+    }
+  );
+  call.GetCall()(call.GetAutoFilter().ptr(), packet, call.dispositions);
+}
+
 AutoPacket::AutoPacket(AutoPacketFactory& factory, std::shared_ptr<void>&& outstanding):
   m_parentFactory(std::static_pointer_cast<AutoPacketFactory>(factory.shared_from_this())),
   m_outstanding(std::move(outstanding))
@@ -30,17 +95,48 @@ AutoPacket::AutoPacket(AutoPacketFactory& factory, std::shared_ptr<void>&& outst
 }
 
 AutoPacket::~AutoPacket(void) {
-  m_parentFactory->RecordPacketDuration(
-    std::chrono::duration_cast<std::chrono::nanoseconds>(
-      std::chrono::high_resolution_clock::now() - m_initTime
-    )
-  );
+  // Packets that were returned to a pool have already been finalized
+  if (m_parentFactory)
+    Finalize();
+
+  // Safe linked list unwind
+  DeleteSatCountersUnsafe();
+
+  // Continuation nodes outlive each issuance, but not the packet
+  for (auto cur = m_freeContinuations; cur;) {
+    auto next = cur->pFlink;
+    delete cur;
+    cur = next;
+  }
+}
+
+void AutoPacket::Finalize(void) {
+  // Packets that were never issued have no lifetime to speak of
+  if (m_initialized)
+    m_parentFactory->RecordPacketDuration(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::high_resolution_clock::now() - m_initTime
+      )
+    );
+
+  if (m_flightRecorder)
+    m_flightRecorder->Record(FlightEvent::Type::PacketReleased, m_sequence);
+
+  // Make room for another packet under the factory's cap
+  if (m_inFlight.exchange(false))
+    m_parentFactory->ReleaseInFlightPacket();
+
+  // Any filter still waiting on an input will never be called on this packet
+  if (m_filterProfiler)
+    for (auto cur = m_firstCounter; cur; cur = cur->flink)
+      if (cur->remaining && !cur->GetAutoFilter().empty())
+        m_filterProfiler->RecordSkip(*cur);
+
+  // Later packets waiting on decorations this packet never completed must not wait forever
+  PublishHistory(true);
 
-  // Mark decorations of successor packets that use decorations
-  // originating from this packet as unsatisfiable
-  for (auto& pair : m_decoration_map)
-    if (!pair.first.tshift && pair.second.m_state != DispositionState::Complete)
-      MarkSuccessorsUnsatisfiable(DecorationKey(pair.first.id, 0));
+  // Completion callbacks, and continuations which will now never be called
+  RunContinuations();
 
   // Needed for the AutoPacketGraph
   NotifyTeardownListeners();
@@ -58,19 +154,12 @@ AutoPacket::~AutoPacket(void) {
     current = current->m_successor.get();
     prev_current->m_successor.reset();
   }
-
-  // Safe linked list unwind
-  for (auto cur = m_firstCounter; cur;) {
-    auto next = cur->flink;
-    delete cur;
-    cur = next;
-  }
 }
 
 DecorationDisposition& AutoPacket::DecorateImmediateUnsafe(const DecorationKey& key, const void* pvImmed)
 {
   // Obtain the decoration disposition of the entry we will be returning
-  DecorationDisposition& dec = m_decoration_map[key];
+  DecorationDisposition& dec = EmplaceDispositionUnsafe(key);
 
   if (dec.m_state != DispositionState::Unsatisfied) {
     std::stringstream ss;
@@ -86,123 +175,36 @@ DecorationDisposition& AutoPacket::DecorateImmediateUnsafe(const DecorationKey&
 }
 
 void AutoPacket::AddSatCounterUnsafe(SatCounter& satCounter) {
-  for(auto pCur = satCounter.GetAutoFilterArguments(); *pCur; pCur++) {
-    DecorationKey key(pCur->id, pCur->tshift);
-    DecorationDisposition& entry = m_decoration_map[key];
-
-    // Make sure decorations exist for timeshifts less that key's timeshift
-    for (int tshift = 0; tshift < key.tshift; ++tshift)
-      m_decoration_map[DecorationKey(key.id, tshift)];
-
-    // Decide what to do with this entry:
-    if (pCur->is_input) {
-      if (entry.m_publishers.size() > 1 && !pCur->is_multi) {
-        std::stringstream ss;
-        ss << "Cannot add listener for multi-broadcast type " << demangle(pCur->id);
-        throw autowiring_error(ss.str());
-      }
-      if (entry.m_state == DispositionState::Complete) {
-        // Either decorations must be present, or the decoration type must be a shared_ptr.
-        if (!entry.m_decorations.empty() || pCur->is_shared) {
-          satCounter.Decrement();
-        }
-      }
-    }
-
-    if (pCur->is_rvalue) {
-      // Throw exception when there is already a modifier with the same altitude,
-      // otherwise insert it to the right position so that the modifiers vector is sorted by altitude
-      auto it = entry.m_modifiers.begin();
-      while (it != entry.m_modifiers.end()) {
-        if (it->altitude == satCounter.GetAltitude()) {
-          std::stringstream ss;
-          ss << "Added multiple rvalue decorations with same altitudes for type " << demangle(pCur->id);
-          throw autowiring_error(ss.str());
-        }
-
-        if (it->altitude < satCounter.GetAltitude())
-          break;
-        it++;
-      }
-      entry.m_modifiers.emplace(it, pCur->is_shared, satCounter.GetAltitude(), &satCounter);
-    } else {
-      if (pCur->is_input) {
-          entry.m_subscribers.emplace(
-          pCur->is_shared,
-          pCur->is_multi ?
-          DecorationDisposition::Subscriber::Type::Multi :
-          pCur->is_shared ?
-          DecorationDisposition::Subscriber::Type::Optional :
-          DecorationDisposition::Subscriber::Type::Normal,
-          satCounter.GetAltitude(),
-          &satCounter
-        );
-      }
-
-      if (pCur->is_output) {
-        if (!entry.m_publishers.empty()) {
-          for (const auto& subscriber : entry.m_subscribers) {
-            for (auto pOther = subscriber.satCounter->GetAutoFilterArguments(); *pOther; pOther++) {
-              if (pOther->id == pCur->id && !pOther->is_multi) {
-                std::stringstream ss;
-                ss << "Added identical data broadcasts of type " << demangle(pCur->id) << " with existing subscriber.";
-                throw autowiring_error(ss.str());
-              }
-            }
-          }
-
-          if (!entry.m_modifiers.empty()) {
-            std::stringstream ss;
-            ss << "Added identical data broadcasts of type " << demangle(pCur->id) << " with existing modifier.";
-            throw autowiring_error(ss.str());
-          }
-        }
-        entry.m_publishers.push_back(&satCounter);
-      }
-    }
-  }
+  AutoPacketTemplate::t_dispositionAccessor accessor = [this](const DecorationKey& key) -> DecorationDisposition& {
+    return EmplaceDispositionUnsafe(key);
+  };
+  AutoPacketTemplate::AddSatCounter(accessor, satCounter);
+  PrimeSatCounterUnsafe(satCounter);
 
   auto tempVisited = std::unordered_set<SatCounter*>();
   auto permVisited = std::unordered_set<SatCounter*>();
-  DetectCycle(satCounter, tempVisited, permVisited);
+  AutoPacketTemplate::DetectCycle(accessor, satCounter, tempVisited, permVisited);
 }
 
-void AutoPacket::DetectCycle(SatCounter& satCounter, std::unordered_set<SatCounter*>& tempVisited, std::unordered_set<SatCounter*>& permVisited) {
-  if (tempVisited.count(&satCounter)) {
-    std::stringstream ss;
-    ss << "Detected cycle in the auto filter graph involving type " << demangle(satCounter.GetType());
-    throw autowiring_error(ss.str());
-  }
-
-  if (permVisited.count(&satCounter))
-    return;
-
-  std::unordered_set<SatCounter*> nextCounters;
-  for(auto pCur = satCounter.GetAutoFilterArguments(); *pCur; pCur++) {
-    if (!pCur->is_output) continue;
+void AutoPacket::PrimeSatCounterUnsafe(SatCounter& satCounter) {
+  for (auto pCur = satCounter.GetAutoFilterArguments(); *pCur; pCur++) {
+    if (!pCur->is_input)
+      continue;
 
-    DecorationKey key(pCur->id, pCur->tshift);
-    DecorationDisposition& entry = m_decoration_map[key];
-    for (auto& subscriber : entry.m_subscribers) {
-      auto ptr = subscriber.satCounter;
-      nextCounters.insert(ptr);
-    }
-  }
-  if (nextCounters.empty())
-    return;
+    const DecorationDisposition* disposition = FindDispositionUnsafe(DecorationKey(pCur->id, pCur->tshift));
+    if (!disposition || disposition->m_state != DispositionState::Complete)
+      continue;
 
-  tempVisited.insert(&satCounter);
-  for (auto pCounter : nextCounters) {
-    DetectCycle(*pCounter, tempVisited, permVisited);
+    // Either decorations must be present, or the decoration type must be a shared_ptr.
+    if (!disposition->m_decorations.empty() || pCur->is_shared)
+      satCounter.Decrement();
   }
-  permVisited.insert(&satCounter);
-  tempVisited.erase(&satCounter);
 }
 
 void AutoPacket::RemoveSatCounterUnsafe(const SatCounter& satCounter) {
   for (auto pCur = satCounter.GetAutoFilterArguments(); *pCur; pCur++) {
     DecorationKey key(pCur->id, pCur->tshift);
-    DecorationDisposition& entry = m_decoration_map[key];
+    DecorationDisposition& entry = EmplaceDispositionUnsafe(key);
 
     if (pCur->is_rvalue) {
       entry.m_modifiers.erase(
@@ -216,12 +218,15 @@ void AutoPacket::RemoveSatCounterUnsafe(const SatCounter& satCounter) {
       );
     } else {
       if (pCur->is_input) {
-        for (auto& sub : entry.m_subscribers) {
-          if (sub.satCounter && *sub.satCounter == satCounter) {
-            entry.m_subscribers.erase(sub);
-            break;
+        auto q = std::find_if(
+          entry.m_subscribers.begin(),
+          entry.m_subscribers.end(),
+          [&satCounter](const DecorationDisposition::Subscriber& sub) {
+            return sub.satCounter && *sub.satCounter == satCounter;
           }
-        }
+        );
+        if (q != entry.m_subscribers.end())
+          entry.m_subscribers.erase(q);
       }
       if (pCur->is_output) {
         entry.m_publishers.erase(
@@ -238,10 +243,74 @@ void AutoPacket::RemoveSatCounterUnsafe(const SatCounter& satCounter) {
   }
 }
 
+void AutoPacket::ReleaseSatCountersUnsafe(void) {
+  // Slots are only valid for the template that assigned them, move their state out first
+  for (size_t i = 0; i < m_slots.size(); i++)
+    m_decoration_map[m_packetTemplate->GetKey(i)] = std::move(m_slots[i]);
+  m_slots.clear();
+  m_packetTemplate.reset();
+
+  for (auto& entry : m_decoration_map) {
+    entry.second.m_publishers.clear();
+    entry.second.m_subscribers.clear();
+    entry.second.m_modifiers.clear();
+  }
+
+  DeleteSatCountersUnsafe();
+  m_filterVersion = 0;
+}
+
+void AutoPacket::DeleteSatCountersUnsafe(void) {
+  // Counters that came from the template are released all at once
+  const SatCounter* first = m_templateCounters.get();
+  const SatCounter* last = first + m_nTemplateCounters;
+  for (auto cur = m_firstCounter; cur;) {
+    auto next = cur->flink;
+    if (!first || cur < first || last <= cur)
+      delete cur;
+    cur = next;
+  }
+  m_firstCounter = nullptr;
+  m_templateCounters.reset();
+  m_templateBindings.reset();
+  m_nTemplateCounters = 0;
+}
+
+DecorationDisposition* AutoPacket::FindDispositionUnsafe(const DecorationKey& key) {
+  if (m_packetTemplate) {
+    int slot = m_packetTemplate->FindSlot(key);
+    if (slot >= 0)
+      return &m_slots[slot];
+  }
+
+  auto q = m_decoration_map.find(key);
+  return q == m_decoration_map.end() ? nullptr : &q->second;
+}
+
+const DecorationDisposition* AutoPacket::FindDispositionUnsafe(const DecorationKey& key) const {
+  return const_cast<AutoPacket*>(this)->FindDispositionUnsafe(key);
+}
+
+DecorationDisposition& AutoPacket::EmplaceDispositionUnsafe(const DecorationKey& key) {
+  if (m_packetTemplate) {
+    int slot = m_packetTemplate->FindSlot(key);
+    if (slot >= 0)
+      return m_slots[slot];
+  }
+  return m_decoration_map[key];
+}
+
+void AutoPacket::ForEachDispositionUnsafe(const std::function<void(const DecorationKey&, const DecorationDisposition&)>& fn) const {
+  for (size_t i = 0; i < m_slots.size(); i++)
+    fn(m_packetTemplate->GetKey(i), m_slots[i]);
+  for (auto& entry : m_decoration_map)
+    fn(entry.first, entry.second);
+}
+
 void AutoPacket::MarkUnsatisfiable(const DecorationKey& key) {
   // Ensure correct type if instantiated here
   std::unique_lock<std::mutex> lk(m_lock);
-  auto& entry = m_decoration_map[key];
+  auto& entry = EmplaceDispositionUnsafe(key);
 
   // Clear all decorations and pointers attached here
   entry.m_state = DispositionState::Complete;
@@ -249,34 +318,72 @@ void AutoPacket::MarkUnsatisfiable(const DecorationKey& key) {
   entry.m_pImmediate = nullptr;
 
   // Notify all consumers
+  bool publish = IsHistoryKeyUnsafe(key);
   UpdateSatisfactionUnsafe(std::move(lk), entry);
+  if (publish)
+    PublishDecoration(key);
 }
 
-void AutoPacket::MarkSuccessorsUnsatisfiable(DecorationKey key) {
-  std::lock_guard<std::mutex> lk(m_lock);
+bool AutoPacket::IsHistoryKeyUnsafe(const DecorationKey& key) const {
+  return
+    m_initialized &&
+    !key.tshift &&
+    m_packetTemplate &&
+    m_packetTemplate->GetShiftCount(key.id) > 1;
+}
 
-  // Update key and successor
-  key.tshift++;
-  auto successor = SuccessorUnsafe();
+void AutoPacket::PublishDecoration(const DecorationKey& key) {
+  AnySharedPointer value;
+  {
+    std::lock_guard<std::mutex> lk(m_lock);
+    const DecorationDisposition* disposition = FindDispositionUnsafe(key);
+    if (!disposition || disposition->m_state != DispositionState::Complete)
+      return;
 
-  while (m_decoration_map.count(key)) {
-    successor->MarkUnsatisfiable(key);
+    // Prior decorations are single-valued, only the first of several decorations can be published
+    if (!disposition->m_decorations.empty())
+      value = disposition->m_decorations.front();
+  }
+  m_parentFactory->PublishDecoration(m_sequence, key.id, value);
+}
 
-    // Update key and successor
-    key.tshift++;
-    successor = successor->Successor();
+void AutoPacket::PublishHistory(bool final) {
+  std::vector<std::pair<auto_id, AnySharedPointer>> published;
+  {
+    std::lock_guard<std::mutex> lk(m_lock);
+    if (!m_initialized || !m_packetTemplate)
+      return;
+
+    for (const auto& type : m_packetTemplate->GetTimeShiftedTypes()) {
+      const DecorationDisposition* disposition = FindDispositionUnsafe(DecorationKey(type.first, 0));
+      const bool complete = disposition && disposition->m_state == DispositionState::Complete;
+      if (complete && !disposition->m_decorations.empty())
+        published.emplace_back(type.first, disposition->m_decorations.front());
+      else if (complete || final)
+        published.emplace_back(type.first, AnySharedPointer{});
+    }
   }
+
+  for (const auto& entry : published)
+    m_parentFactory->PublishDecoration(m_sequence, entry.first, entry.second);
 }
 
 void AutoPacket::UpdateSatisfactionUnsafe(std::unique_lock<std::mutex> lk, const DecorationDisposition& disposition) {
-  // Update satisfaction inside of lock
-  if (disposition.m_state != DispositionState::Complete)
-    // Nothing to do yet
+  const DecorationDisposition* pDisposition = &disposition;
+  UpdateSatisfactionUnsafe(std::move(lk), &pDisposition, 1);
+}
+
+void AutoPacket::UpdateSatisfactionUnsafe(std::unique_lock<std::mutex> lk, const DecorationDisposition* const* dispositions, size_t nDispositions) {
+  if (!m_initialized)
+    // Counters will be primed when this packet is issued
     return;
 
   // Any filter that who can take this decoration as an optional input should be called
   std::vector<SatCounter*> callQueue;
 
+  // Modifiers must run before any subscriber is given the decoration they modify
+  std::vector<SatCounter*> modifierQueue;
+
   // Recursively mark unsatisfiable any single-output arguments on these subscribers:
   std::vector<const AutoFilterArgument*> unsatOutputArgs;
   auto MarkOutputsUnsat = [&unsatOutputArgs] (const SatCounter& satCounter) {
@@ -289,105 +396,124 @@ void AutoPacket::UpdateSatisfactionUnsafe(std::unique_lock<std::mutex> lk, const
     }
   };
 
-  if (!disposition.m_modifiers.empty() && disposition.m_decorations.size() > 1)
-    throw autowiring_error("An AutoFilter was detected which has single-decorate rvalue argument in a graph with multi-decorate outputs");
+  for (size_t d = 0; d < nDispositions; d++) {
+    const DecorationDisposition& disposition = *dispositions[d];
 
-  for (auto modifier : disposition.m_modifiers) {
-    if (!modifier.satCounter)
+    // Update satisfaction inside of lock
+    if (disposition.m_state != DispositionState::Complete)
+      // Nothing to do yet
       continue;
-    auto& satCounter = *modifier.satCounter;
-    if (modifier.is_shared) {
-      if (satCounter.Decrement()) {
-        lk.unlock();
-        callQueue.push_back(&satCounter);
-        {
-          AutoCurrentPacketPusher apkt(*this);
-          for (SatCounter* call : callQueue)
-            call->GetCall()(call->GetAutoFilter().ptr(), *this);
+
+    if (!disposition.m_modifiers.empty() && disposition.m_decorations.size() > 1)
+      throw autowiring_error("An AutoFilter was detected which has single-decorate rvalue argument in a graph with multi-decorate outputs");
+
+    for (auto modifier : disposition.m_modifiers) {
+      if (!modifier.satCounter)
+        continue;
+      auto& satCounter = *modifier.satCounter;
+      if (modifier.is_shared) {
+        if (satCounter.Decrement()) {
+          lk.unlock();
+          modifierQueue.push_back(&satCounter);
+          {
+            AutoCurrentPacketPusher apkt(*this);
+            for (SatCounter* call : modifierQueue)
+              CallFilter({ m_filterProfiler.get(), m_flightRecorder.get(), m_sequence }, *call, *this);
+          }
+          modifierQueue.clear();
+          lk.lock();
+        }
+      } else {
+        switch(disposition.m_decorations.size()) {
+        case 0:
+          MarkOutputsUnsat(satCounter);
+          break;
+        case 1:
+          if (satCounter.Decrement())
+            modifierQueue.push_back(&satCounter);
+          break;
+        default:
+          // should not reach here
+          throw autowiring_error("An AutoFilter was detected which has single-decorate rvalue argument in a graph with multi-decorate outputs");
         }
-        callQueue.clear();
-        lk.lock();
-      }
-    } else {
-      switch(disposition.m_decorations.size()) {
-      case 0:
-        MarkOutputsUnsat(satCounter);
-        break;
-      case 1:
-        if (satCounter.Decrement())
-          callQueue.push_back(&satCounter);
-        break;
-      default:
-        // should not reach here
-        throw autowiring_error("An AutoFilter was detected which has single-decorate rvalue argument in a graph with multi-decorate outputs");
       }
     }
-  }
-
-  switch (disposition.m_decorations.size()) {
-  case 0:
-    // No decorations here whatsoever.
-    // Subscribers that cannot be invoked should have their outputs recursively marked unsatisfiable.
-    // Subscribers that can be invoked should be.
-    for (auto subscriber : disposition.m_subscribers) {
-      auto& satCounter = *subscriber.satCounter;
-      if (!satCounter.remaining)
-        // Skip subscribers that have already been called--a decoration is being expunged from the packet,
-        // but the filter in question has already been invoked, and so its outputs are already on the packet
-        continue;
 
-      switch (subscriber.type) {
-      case DecorationDisposition::Subscriber::Type::Multi:
-      case DecorationDisposition::Subscriber::Type::Optional:
-        // Optional, we will just generate a call to this subscriber, if possible:
+    switch (disposition.m_decorations.size()) {
+    case 0:
+      // No decorations here whatsoever.
+      // Subscribers that cannot be invoked should have their outputs recursively marked unsatisfiable.
+      // Subscribers that can be invoked should be.
+      for (auto subscriber : disposition.m_subscribers) {
+        auto& satCounter = *subscriber.satCounter;
+        if (!satCounter.remaining)
+          // Skip subscribers that have already been called--a decoration is being expunged from the packet,
+          // but the filter in question has already been invoked, and so its outputs are already on the packet
+          continue;
+
+        switch (subscriber.type) {
+        case DecorationDisposition::Subscriber::Type::Multi:
+        case DecorationDisposition::Subscriber::Type::Optional:
+          // Optional, we will just generate a call to this subscriber, if possible:
+          if (satCounter.Decrement())
+            callQueue.push_back(&satCounter);
+          break;
+        case DecorationDisposition::Subscriber::Type::Normal:
+          // Non-optional, consider outputs and recursively invalidate
+          MarkOutputsUnsat(satCounter);
+          break;
+        }
+      }
+      break;
+    case 1:
+      // One unique decoration available.  We should be able to call everyone.
+      for (auto subscriber : disposition.m_subscribers) {
+        auto& satCounter = *subscriber.satCounter;
         if (satCounter.Decrement())
           callQueue.push_back(&satCounter);
-        break;
-      case DecorationDisposition::Subscriber::Type::Normal:
-        // Non-optional, consider outputs and recursively invalidate
-        MarkOutputsUnsat(satCounter);
-        break;
       }
+      break;
+    default:
+      // Multiple decorations.  Single-input types should never be encountered, but if they are,
+      // we can't call them.  Always call multi-input entries.
+      for (auto subscriber : disposition.m_subscribers) {
+        if (subscriber.type != DecorationDisposition::Subscriber::Type::Multi)
+          throw autowiring_error("An AutoFilter was detected which has single-decorate inputs in a graph with multi-decorate outputs");
+
+        // One more entry for this input to consider
+        if(subscriber.satCounter->Decrement())
+          callQueue.push_back(subscriber.satCounter);
+      }
+      break;
     }
-    break;
-  case 1:
-    // One unique decoration available.  We should be able to call everyone.
-    for (auto subscriber : disposition.m_subscribers) {
-      auto& satCounter = *subscriber.satCounter;
-      if (satCounter.Decrement())
-        callQueue.push_back(&satCounter);
-    }
-    break;
-  default:
-    // Multiple decorations.  Single-input types should never be encountered, but if they are,
-    // we can't call them.  Always call multi-input entries.
-    for (auto subscriber : disposition.m_subscribers) {
-      if (subscriber.type != DecorationDisposition::Subscriber::Type::Multi)
-        throw autowiring_error("An AutoFilter was detected which has single-decorate inputs in a graph with multi-decorate outputs");
-
-      // One more entry for this input to consider
-      if(subscriber.satCounter->Decrement())
-        callQueue.push_back(subscriber.satCounter);
-    }
-    break;
   }
   lk.unlock();
 
   // Generate all calls
   {
     AutoCurrentPacketPusher apkt(*this);
-    for (SatCounter* call : callQueue)
-      call->GetCall()(call->GetAutoFilter().ptr(), *this);
+    for (SatCounter* call : modifierQueue)
+      CallFilter({ m_filterProfiler.get(), m_flightRecorder.get(), m_sequence }, *call, *this);
   }
+  CallSatCounters(callQueue);
 
   // Mark all unsatisfiable output types
-  for (auto unsatOutputArg : unsatOutputArgs) {
+  for (auto unsatOutputArg : unsatOutputArgs)
     // One more producer run, even though we couldn't attach any new decorations
-    auto& disposition = m_decoration_map[DecorationKey{unsatOutputArg->id, 0}];
-    if(disposition.IncProducerCount())
-      // Recurse on this entry
-      UpdateSatisfactionUnsafe(std::unique_lock<std::mutex>{m_lock}, disposition);
-  }
+    SkipProducer(DecorationKey(unsatOutputArg->id, 0));
+}
+
+void AutoPacket::SkipProducer(const DecorationKey& key) {
+  std::unique_lock<std::mutex> lk(m_lock);
+  auto& disposition = EmplaceDispositionUnsafe(key);
+  if (!disposition.IncProducerCount())
+    return;
+
+  // Recurse on this entry
+  bool publish = IsHistoryKeyUnsafe(key);
+  UpdateSatisfactionUnsafe(std::move(lk), disposition);
+  if (publish)
+    PublishDecoration(key);
 }
 
 void AutoPacket::PulseSatisfactionUnsafe(std::unique_lock<std::mutex> lk, DecorationDisposition* pTypeSubs[], size_t nInfos) {
@@ -436,25 +562,126 @@ void AutoPacket::PulseSatisfactionUnsafe(std::unique_lock<std::mutex> lk, Decora
     // Run through calls while unsynchronized:
     lk.unlock();
     for (SatCounter* call : callQueue) {
-      call->GetCall()(call->GetAutoFilter().ptr(), *this);
+      CallFilter({ m_filterProfiler.get(), m_flightRecorder.get(), m_sequence }, *call, *this);
       call->remaining = 0;
     }
     lk.lock();
   } while (!callQueue.empty());
 }
 
+namespace {
+  /// <summary>
+  /// A group of satisfied counters of equal altitude, called concurrently by a pool and the decorating thread
+  /// </summary>
+  struct ParallelCallGroup {
+    ParallelCallGroup(AutoPacket& packet, const CallInstruments& instruments, SatCounter* const* calls, size_t nCalls) :
+      packet(packet),
+      instruments(instruments),
+      calls(calls),
+      nCalls(nCalls)
+    {}
+
+    AutoPacket& packet;
+    const CallInstruments instruments;
+    SatCounter* const* const calls;
+    const size_t nCalls;
+
+    // The index of the next call to be claimed
+    std::atomic<size_t> next{0};
+
+    // Set once any call has thrown, calls claimed afterwards are not made
+    std::atomic<bool> failed{false};
+
+    // Completion count and the first exception thrown by a call, guarded by lock
+    std::mutex lock;
+    std::condition_variable cv;
+    size_t nComplete = 0;
+    std::exception_ptr ex;
+
+    /// <summary>
+    /// Claims and runs calls until none remain
+    /// </summary>
+    void Run(void) {
+      if (next >= nCalls)
+        // Everything was claimed before this thread could help
+        return;
+
+      AutoCurrentPacketPusher apkt(packet);
+      for (size_t i; (i = next++) < nCalls;) {
+        std::exception_ptr caught;
+        if (!failed)
+          try {
+            CallFilter(instruments, *calls[i], packet);
+          }
+          catch (...) {
+            caught = std::current_exception();
+            failed = true;
+          }
+
+        std::lock_guard<std::mutex> lk(lock);
+        if (caught && !ex)
+          ex = caught;
+        if (++nComplete == nCalls)
+          cv.notify_all();
+      }
+    }
+  };
+}
+
+void AutoPacket::CallSatCounters(std::vector<SatCounter*>& calls) {
+  if (!m_threadPool || calls.size() < 2) {
+    AutoCurrentPacketPusher apkt(*this);
+    for (SatCounter* call : calls)
+      CallFilter({ m_filterProfiler.get(), m_flightRecorder.get(), m_sequence }, *call, *this);
+    return;
+  }
+
+  // Higher altitudes are called first.  Subscribers are already sorted by altitude, counters from
+  // other sources might not be.
+  std::stable_sort(
+    calls.begin(),
+    calls.end(),
+    [] (const SatCounter* lhs, const SatCounter* rhs) {
+      return lhs->GetAltitude() > rhs->GetAltitude();
+    }
+  );
+
+  for (size_t first = 0, last; first < calls.size(); first = last) {
+    for (last = first + 1; last < calls.size() && calls[last]->GetAltitude() == calls[first]->GetAltitude(); last++);
+
+    auto group = std::make_shared<ParallelCallGroup>(
+      *this,
+      CallInstruments{ m_filterProfiler.get(), m_flightRecorder.get(), m_sequence },
+      &calls[first],
+      last - first
+    );
+
+    // One helper for each call beyond the first, this thread takes calls as well so that progress
+    // is made even if every thread in the pool is busy.  Once a call throws, the remaining calls are
+    // claimed without being made, so we only wait for the calls that were already underway.
+    for (size_t i = group->nCalls - 1; i--;)
+      *m_threadPool += [group] { group->Run(); };
+    group->Run();
+
+    std::unique_lock<std::mutex> lk(group->lock);
+    group->cv.wait(lk, [&group] { return group->nComplete == group->nCalls; });
+    if (group->ex)
+      std::rethrow_exception(group->ex);
+  }
+}
+
 bool AutoPacket::HasUnsafe(const DecorationKey& key) const {
-  auto q = m_decoration_map.find(key);
-  if(q == m_decoration_map.end())
+  auto q = FindDispositionUnsafe(key);
+  if(!q)
     return false;
-  return !q->second.m_decorations.empty();
+  return !q->m_decorations.empty();
 }
 
 void AutoPacket::DecorateNoPriors(const AnySharedPointer& ptr, DecorationKey key) {
   DecorationDisposition* disposition;
   std::unique_lock<std::mutex> lk(m_lock);
 
-  disposition = &m_decoration_map[key];
+  disposition = &EmplaceDispositionUnsafe(key);
   switch (disposition->m_state) {
   case DispositionState::Complete:
     {
@@ -474,65 +701,108 @@ void AutoPacket::DecorateNoPriors(const AnySharedPointer& ptr, DecorationKey key
   }
 
   // Decoration attaches here, if it is non-null
-  if(ptr)
+  if(ptr) {
     disposition->m_decorations.push_back(ptr);
-  if(disposition->IncProducerCount())
-    UpdateSatisfactionUnsafe(std::move(lk), *disposition);
+    if (m_flightRecorder)
+      m_flightRecorder->Record(FlightEvent::Type::DecorationPublished, m_sequence, key.id);
+  }
+  if(!disposition->IncProducerCount())
+    return;
+
+  // Later packets that want this decoration receive it from the factory's history once it is complete
+  bool publish = IsHistoryKeyUnsafe(key);
+  UpdateSatisfactionUnsafe(std::move(lk), *disposition);
+  if (publish)
+    PublishDecoration(key);
 }
 
 void AutoPacket::Decorate(const AnySharedPointer& ptr, DecorationKey key) {
-  auto cur = shared_from_this();
-
-  do {
-    // Update satisfaction set on this entry
-    cur->DecorateNoPriors(ptr, key);
-
-    // Obtain the successor
-    cur = cur->Successor();
-    key.tshift++;
-  } while (
-    // If there are any filters on _this_ packet that desire to know the prior packet, then
-    // we must proactively preserve the value of this decoration for our successor.
-    (std::lock_guard<std::mutex>)m_lock,
-    m_decoration_map.count(key)
-  );
+  DecorateNoPriors(ptr, key);
+}
+
+void AutoPacket::DecorateBatch(const AnySharedPointer* ptrs, size_t nPtrs) {
+  std::vector<DecorationDisposition*> dispositions(nPtrs);
+  std::vector<const DecorationDisposition*> completed;
+  std::vector<DecorationKey> published;
+  completed.reserve(nPtrs);
+
+  std::unique_lock<std::mutex> lk(m_lock);
+
+  // Everything is checked before anything is attached, so that nothing is attached if this throws
+  for (size_t i = 0; i < nPtrs; i++) {
+    dispositions[i] = &EmplaceDispositionUnsafe(DecorationKey(ptrs[i].type(), 0));
+    if (dispositions[i]->m_state == DispositionState::Complete) {
+      std::stringstream ss;
+      ss << "Cannot decorate this packet with type " << demangle(ptrs[i])
+        << ", the requested decoration is already satisfied";
+      throw autowiring_error(ss.str());
+    }
+
+    for (size_t j = 0; j < i; j++)
+      if (dispositions[j] == dispositions[i]) {
+        std::stringstream ss;
+        ss << "Cannot decorate this packet with type " << demangle(ptrs[i])
+          << " more than once in a single call";
+        throw autowiring_error(ss.str());
+      }
+  }
+
+  for (size_t i = 0; i < nPtrs; i++) {
+    DecorationDisposition& disposition = *dispositions[i];
+    DecorationKey key(ptrs[i].type(), 0);
+    if (ptrs[i]) {
+      disposition.m_decorations.push_back(ptrs[i]);
+      if (m_flightRecorder)
+        m_flightRecorder->Record(FlightEvent::Type::DecorationPublished, m_sequence, key.id);
+    }
+    if (!disposition.IncProducerCount())
+      continue;
+
+    completed.push_back(&disposition);
+    if (IsHistoryKeyUnsafe(key))
+      published.push_back(key);
+  }
+
+  UpdateSatisfactionUnsafe(std::move(lk), completed.data(), completed.size());
+  for (const auto& key : published)
+    PublishDecoration(key);
 }
 
 void AutoPacket::RemoveDecoration(DecorationKey key) {
   std::lock_guard<std::mutex> lk(m_lock);
 
-  auto q = m_decoration_map.find(key);
-  if (q == m_decoration_map.end())
+  auto q = FindDispositionUnsafe(key);
+  if (!q)
     return;
-  q->second.m_decorations.clear();
+  q->m_decorations.clear();
 }
 
 const DecorationDisposition* AutoPacket::GetDisposition(const DecorationKey& key) const {
   std::lock_guard<std::mutex> lk(m_lock);
 
-  auto q = m_decoration_map.find(key);
-  if (q != m_decoration_map.end() && q->second.m_state == DispositionState::Complete)
-    return &q->second;
+  auto q = FindDispositionUnsafe(key);
+  if (q && q->m_state == DispositionState::Complete)
+    return q;
 
   return nullptr;
 }
 
 bool AutoPacket::HasSubscribers(const DecorationKey& key) const {
   std::lock_guard<std::mutex> lk(m_lock);
-  auto q = m_decoration_map.find(key);
+  auto q = FindDispositionUnsafe(key);
   return
-    q == m_decoration_map.end() ?
+    !q ?
     false :
-    q->second.m_subscribers.size() != 0;
+    q->m_subscribers.size() != 0;
 }
 
 size_t AutoPacket::HasPublishers(const DecorationKey& key) const {
   std::lock_guard<std::mutex> lk(m_lock);
-  auto q = m_decoration_map.find(key);
+  auto q = FindDispositionUnsafe(key);
   return
-    q == m_decoration_map.end() ?
+    !q ?
     0 :
-    q->second.m_publishers.size();
+    q->m_publishers.size();
 }
 
 const SatCounter& AutoPacket::GetSatisfaction(auto_id subscriber) const {
@@ -558,13 +828,52 @@ void AutoPacket::ThrowMultiplyDecoratedException(const DecorationKey& key) {
 size_t AutoPacket::GetDecorationTypeCount(void) const
 {
   std::lock_guard<std::mutex> lk(m_lock);
-  return m_decoration_map.size();
+  return m_slots.size() + m_decoration_map.size();
 }
 
 AutoPacket::t_decorationMap AutoPacket::GetDecorations(void) const
 {
   std::lock_guard<std::mutex> lk(m_lock);
-  return m_decoration_map;
+  t_decorationMap retVal = m_decoration_map;
+  for (size_t i = 0; i < m_slots.size(); i++)
+    retVal[m_packetTemplate->GetKey(i)] = m_slots[i];
+  return retVal;
+}
+
+void AutoPacket::SetDeadline(std::chrono::steady_clock::time_point deadline) {
+  // Zero is reserved to mean that there is no deadline
+  m_deadline = std::max<int64_t>(1, std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count());
+}
+
+std::chrono::steady_clock::time_point AutoPacket::GetDeadline(void) const {
+  return std::chrono::steady_clock::time_point(
+    std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(m_deadline))
+  );
+}
+
+bool AutoPacket::IsPastDeadline(void) const {
+  const int64_t deadline = m_deadline;
+  return
+    deadline &&
+    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() > deadline;
+}
+
+bool AutoPacket::ShedIfPastDeadline(const AutoFilterArgument* args) {
+  if (!IsPastDeadline() || HasOptionalInput(args))
+    return false;
+
+  // Too late for this filter to be of use, but anyone optionally waiting on it can still run
+  static_cast<AutoPacketInternal*>(this)->Shed(args);
+  return true;
+}
+
+void AutoPacket::ForEachDecoration(const std::function<void(const DecorationKey&, const DecorationDisposition&)>& fn) const
+{
+  std::lock_guard<std::mutex> lk(m_lock);
+  for (const auto& cur : m_decoration_map)
+    fn(cur.first, cur.second);
+  for (size_t i = 0; i < m_slots.size(); i++)
+    fn(m_packetTemplate->GetKey(i), m_slots[i]);
 }
 
 bool AutoPacket::IsUnsatisfiable(const auto_id& id) const
@@ -589,10 +898,13 @@ void AutoPacket::ForwardAll(const std::shared_ptr<AutoPacket>& recipient) const
   std::vector<std::pair<DecorationKey, DecorationDisposition>> dd;
   {
     std::lock_guard<std::mutex> lk(m_lock);
-    for (const auto& decoration : m_decoration_map)
-      // Only fully complete decorations are considered for propagation
-      if (decoration.second.m_state == DispositionState::Complete)
-        dd.push_back(decoration);
+    ForEachDispositionUnsafe(
+      [&dd] (const DecorationKey& key, const DecorationDisposition& disposition) {
+        // Only fully complete decorations are considered for propagation
+        if (disposition.m_state == DispositionState::Complete)
+          dd.emplace_back(key, disposition);
+      }
+    );
   }
 
   // Lock down recipient collection while we go through and attach decorations:
@@ -617,17 +929,124 @@ const SatCounter* AutoPacket::AddRecipient(const AutoFilterDescriptor& descripto
       m_firstCounter->blink = &sat;
     m_firstCounter = &sat;
 
+    // The counter list now differs from the one the factory would build
+    m_filterVersion = 0;
+
     // Update satisfaction & Append types from subscriber
     AddSatCounterUnsafe(sat);
   }
 
   if (!sat.remaining)
     // Filter is ready to be called, oblige it
-    sat.GetCall()(sat.GetAutoFilter().ptr(), *this);
+    CallFilter({ m_filterProfiler.get(), m_flightRecorder.get(), m_sequence }, sat, *this);
 
   return &sat;
 }
 
+void* AutoPacket::AllocateContinuation(PacketContinuation*& node, size_t size, size_t alignment) {
+  {
+    std::lock_guard<std::mutex> lk(m_lock);
+    node = m_freeContinuations;
+    if (node)
+      m_freeContinuations = node->pFlink;
+  }
+  if (!node)
+    node = new PacketContinuation;
+  node->pFlink = nullptr;
+  return node->Allocate(size, alignment);
+}
+
+void AutoPacket::FreeContinuation(PacketContinuation& node) {
+  node.Free();
+
+  std::lock_guard<std::mutex> lk(m_lock);
+  node.pFlink = m_freeContinuations;
+  m_freeContinuations = &node;
+}
+
+void AutoPacket::AttachContinuation(PacketContinuation& node, void(*pfnDestroy)(void*), const AutoFilterDescriptor& descriptor) {
+  node.pfnDestroy = pfnDestroy;
+  node.counter = SatCounter(descriptor);
+
+  SatCounter& sat = node.counter;
+  bool ready;
+  {
+    std::lock_guard<std::mutex> lk(m_lock);
+    node.pFlink = m_firstContinuation;
+    m_firstContinuation = &node;
+
+    // Linked ahead of everything else.  The counter is unlinked again when the packet is finalized, so
+    // unlike a recipient it does not prevent the graph from being reused.
+    sat.flink = m_firstCounter;
+    if (m_firstCounter)
+      m_firstCounter->blink = &sat;
+    m_firstCounter = &sat;
+    node.linked = true;
+
+    // A continuation has no outputs and so cannot close a cycle, only its inputs need be added
+    AutoPacketTemplate::t_dispositionAccessor accessor = [this](const DecorationKey& key) -> DecorationDisposition& {
+      return EmplaceDispositionUnsafe(key);
+    };
+    AutoPacketTemplate::AddSatCounter(accessor, sat);
+    PrimeSatCounterUnsafe(sat);
+
+    // Decided under the lock, otherwise a decoration arriving now could cause a second call
+    ready = !sat.remaining;
+  }
+
+  if (ready)
+    CallFilter({ m_filterProfiler.get(), m_flightRecorder.get(), m_sequence }, sat, *this);
+}
+
+void AutoPacket::AttachCompletion(PacketContinuation& node, void(*pfnDestroy)(void*), void(*pfnComplete)(void*, const AutoPacket&)) {
+  node.pfnDestroy = pfnDestroy;
+  node.pfnComplete = pfnComplete;
+
+  std::lock_guard<std::mutex> lk(m_lock);
+  node.pFlink = m_firstContinuation;
+  m_firstContinuation = &node;
+}
+
+void AutoPacket::RunContinuations(void) {
+  PacketContinuation* first;
+  {
+    std::lock_guard<std::mutex> lk(m_lock);
+    first = m_firstContinuation;
+    m_firstContinuation = nullptr;
+
+    for (auto cur = first; cur; cur = cur->pFlink) {
+      if (!cur->linked)
+        continue;
+
+      SatCounter& sat = cur->counter;
+      if (sat.blink)
+        sat.blink->flink = sat.flink;
+      else
+        m_firstCounter = sat.flink;
+      if (sat.flink)
+        sat.flink->blink = sat.blink;
+      RemoveSatCounterUnsafe(sat);
+    }
+  }
+  if (!first)
+    return;
+
+  for (auto cur = first; cur; cur = cur->pFlink)
+    if (cur->pfnComplete)
+      cur->pfnComplete(cur->pFn, *this);
+
+  // Callables are destroyed outside of the lock, this may fulfill a promise or release anything at all
+  PacketContinuation* last = nullptr;
+  for (auto cur = first; cur; cur = cur->pFlink) {
+    cur->Reset();
+    last = cur;
+  }
+
+  std::lock_guard<std::mutex> lk(m_lock);
+  last->pFlink = m_freeContinuations;
+  m_freeContinuations = first;
+}
+
 void AutoPacket::RemoveRecipient(const SatCounter& recipient) {
   // Remove the recipient from our list
   std::lock_guard<std::mutex> lk(m_lock);
@@ -635,6 +1054,7 @@ void AutoPacket::RemoveRecipient(const SatCounter& recipient) {
     recipient.blink->flink = recipient.flink;
   if (recipient.flink)
     recipient.flink->blink = recipient.blink;
+  m_filterVersion = 0;
 
   RemoveSatCounterUnsafe(recipient);
 }
@@ -687,7 +1107,7 @@ bool AutoPacket::Wait(std::condition_variable& cv, const AutoFilterArgument* inp
         altitude::Dispatch,
         inputs,
         false,
-        [] (const void* pObj, AutoPacket&) {
+        [] (const void* pObj, AutoPacket&, const DecorationDisposition* const*) {
           SignalStub* stub = (SignalStub*)pObj;
 
           // Completed, mark the output as satisfied and update the condition variable
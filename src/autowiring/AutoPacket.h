@@ -6,8 +6,12 @@
 #include "auto_id.h"
 #include "auto_tuple.h"
 #include "AutoFilterArgument.h"
+#include "autowiring_error.h"
 #include "Decompose.h"
+#include "DecorationArena.h"
 #include "DecorationDisposition.h"
+#include "DecorationPool.h"
+#include "DecorationView.h"
 #include "is_any.h"
 #include "index_tuple.h"
 #include "is_shared_ptr.h"
@@ -15,7 +19,10 @@
 #include "TeardownNotifier.h"
 #include <typeinfo>
 #include <unordered_set>
+#include <vector>
 #include CHRONO_HEADER
+#include FUNCTIONAL_HEADER
+#include FUTURE_HEADER
 #include MEMORY_HEADER
 #include STL_UNORDERED_MAP
 #include MUTEX_HEADER
@@ -28,6 +35,12 @@ namespace autowiring {
   template<class MemFn, class Index>
   struct CE;
 
+  class AutoFilterProfiler;
+  class AutoPacketTemplate;
+  class FlightRecorder;
+  struct PacketContinuation;
+  class ThreadPool;
+
   template<typename Arg, typename Pack, typename = void>
   struct choice;
 
@@ -65,24 +78,100 @@ public:
 
 protected:
   // A pointer back to the factory that created us. Used for recording lifetime statistics.
-  const std::shared_ptr<AutoPacketFactory> m_parentFactory;
+  // Pooled packets release this pointer when they are returned to the pool.
+  std::shared_ptr<AutoPacketFactory> m_parentFactory;
 
   // The successor to this packet
   std::shared_ptr<AutoPacketInternal> m_successor;
 
+  // The position of this packet in the order of issuance by its factory, used to find prior decorations
+  uint64_t m_sequence = 0;
+
   // Hold the time point at which this packet was last initalized.
   std::chrono::high_resolution_clock::time_point m_initTime;
 
   // Outstanding count local and remote holds:
-  const std::shared_ptr<void> m_outstanding;
+  std::shared_ptr<void> m_outstanding;
+
+  // Set while this packet counts against the factory's cap on outstanding packets, and cleared by
+  // whichever of Finalize or an abandonment by the factory happens first
+  std::atomic<bool> m_inFlight{false};
+
+  // Set if the factory abandoned this packet to make room for a newer one
+  std::atomic<bool> m_abandoned{false};
+
+  // The time, since the steady clock's epoch, after which AutoFilters are no longer called on this
+  // packet, or zero if there is no deadline
+  std::atomic<int64_t> m_deadline{0};
+
+  // Set once an AutoFilter has been skipped because the deadline passed
+  std::atomic<bool> m_shed{false};
 
   // Pointer to a forward linked list of saturation counters, constructed when the packet is created
   autowiring::SatCounter* m_firstCounter = nullptr;
 
+  // Contiguous block holding the counters copied from the packet template of the factory.  These
+  // are linked into m_firstCounter, but unlike recipients they are not individually allocated.
+  std::unique_ptr<autowiring::SatCounter[]> m_templateCounters;
+  size_t m_nTemplateCounters = 0;
+
+  // The input dispositions of m_templateCounters, which each of those counters refers to
+  std::unique_ptr<const autowiring::DecorationDisposition*[]> m_templateBindings;
+
+  // The factory filter set version from which m_firstCounter was built, or zero if the counter list
+  // has been modified with per-packet recipients and may not be reused when the packet is recycled
+  size_t m_filterVersion = 0;
+
+  // True once this packet has been issued by the factory.  Satisfaction updates are suppressed until
+  // then, because a recycled packet may still carry the satisfaction graph of its prior issuance.
+  bool m_initialized = false;
+
+  // The template this packet was wired from, if any.  Dispositions for decorations named by the
+  // template are held in m_slots, at the positions the template assigns them.  Dispositions for all
+  // other decorations are held in m_decoration_map.  The template also holds the AutoFilters called
+  // through m_templateCounters, which do not hold them.
+  std::shared_ptr<const autowiring::AutoPacketTemplate> m_packetTemplate;
+  std::vector<autowiring::DecorationDisposition> m_slots;
   t_decorationMap m_decoration_map;
 
+  // The pool used to run independent AutoFilters concurrently, obtained from the factory when the
+  // packet is issued.  If this is nullptr, all AutoFilters are run on the thread that satisfied them.
+  std::shared_ptr<autowiring::ThreadPool> m_threadPool;
+
+  // The profiler to which AutoFilter statistics are recorded, obtained from the factory when the packet
+  // is issued.  If this is nullptr, AutoFilter calls are not timed.
+  std::shared_ptr<autowiring::AutoFilterProfiler> m_filterProfiler;
+
+  // The recorder to which packet events are logged, obtained from the factory when the packet is issued.
+  // If this is nullptr, no events are recorded.
+  std::shared_ptr<autowiring::FlightRecorder> m_flightRecorder;
+
+  // Arena in which decorations are constructed, if the factory enabled one when this packet was issued
+  std::unique_ptr<autowiring::DecorationArena> m_arena;
+
+  // Pools from which decorations are constructed, obtained from the factory when the packet is issued.
+  // If this is nullptr, the factory had no pools registered.
+  std::shared_ptr<const autowiring::DecorationPoolMap> m_decorationPools;
+
+  // Continuations and completion callbacks attached to this issuance of the packet, and the nodes
+  // left over from prior issuances, which are reused before any new node is allocated
+  autowiring::PacketContinuation* m_firstContinuation = nullptr;
+  autowiring::PacketContinuation* m_freeContinuations = nullptr;
+
   mutable std::mutex m_lock;
 
+  /// <returns>The disposition for the specified key, or nullptr if no such disposition exists</returns>
+  autowiring::DecorationDisposition* FindDispositionUnsafe(const autowiring::DecorationKey& key);
+  const autowiring::DecorationDisposition* FindDispositionUnsafe(const autowiring::DecorationKey& key) const;
+
+  /// <returns>The disposition for the specified key, which is created if it does not exist</returns>
+  autowiring::DecorationDisposition& EmplaceDispositionUnsafe(const autowiring::DecorationKey& key);
+
+  /// <summary>
+  /// Invokes the specified function on every disposition held by this packet
+  /// </summary>
+  void ForEachDispositionUnsafe(const std::function<void(const autowiring::DecorationKey&, const autowiring::DecorationDisposition&)>& fn) const;
+
   /// <summary>
   /// Checks out the decoration named by the specified type information and attaches the specified immediate pointer to it
   /// </summary>
@@ -98,13 +187,98 @@ protected:
   /// </summary>
   void AddSatCounterUnsafe(autowiring::SatCounter& satCounter);
 
+  /// <summary>
+  /// Decrements the specified counter once for each of its inputs that is already available
+  /// </summary>
+  void PrimeSatCounterUnsafe(autowiring::SatCounter& satCounter);
+
   /// <summary>
   /// Remove all AutoFilter argument information for a recipient
   void RemoveSatCounterUnsafe(const autowiring::SatCounter& satCounter);
 
   /// <summary>
-  /// Detect cycle in the auto filter graph using DFS
-  void DetectCycle(autowiring::SatCounter& satCounter, std::unordered_set<autowiring::SatCounter*>& tempVisited, std::unordered_set<autowiring::SatCounter*>& permVisited);
+  /// Deletes all saturation counters on this packet and removes them from the satisfaction graph
+  /// </summary>
+  /// <remarks>
+  /// Decorations are left untouched
+  /// </remarks>
+  void ReleaseSatCountersUnsafe(void);
+
+  /// <summary>
+  /// Deletes all saturation counters on this packet without updating the satisfaction graph
+  /// </summary>
+  void DeleteSatCountersUnsafe(void);
+
+  /// <summary>
+  /// Records lifetime statistics, notifies teardown listeners, and releases successors
+  /// </summary>
+  /// <remarks>
+  /// Called exactly once per issuance, either when the packet is destroyed or when it is returned to
+  /// the packet pool of its factory.
+  /// </remarks>
+  void Finalize(void);
+
+  /// <summary>
+  /// Obtains a continuation node, and memory within or for it, to hold a callable of the specified size
+  /// </summary>
+  /// <returns>The memory in which the callable is to be constructed</returns>
+  void* AllocateContinuation(autowiring::PacketContinuation*& node, size_t size, size_t alignment);
+
+  /// <summary>
+  /// Returns a node obtained from AllocateContinuation whose callable could not be constructed
+  /// </summary>
+  void FreeContinuation(autowiring::PacketContinuation& node);
+
+  /// <summary>
+  /// Attaches a continuation node to be called as the specified AutoFilter once its inputs are satisfied
+  /// </summary>
+  /// <remarks>
+  /// The descriptor does not own the callable, which is held by the node.  If the inputs are already
+  /// satisfied, the continuation is called before this method returns.
+  /// </remarks>
+  void AttachContinuation(autowiring::PacketContinuation& node, void(*pfnDestroy)(void*), const autowiring::AutoFilterDescriptor& descriptor);
+
+  /// <summary>
+  /// Attaches a continuation node to be called when this packet is finalized
+  /// </summary>
+  void AttachCompletion(autowiring::PacketContinuation& node, void(*pfnDestroy)(void*), void(*pfnComplete)(void*, const AutoPacket&));
+
+  /// <summary>
+  /// Calls completion callbacks, then destroys every continuation attached to this issuance
+  /// </summary>
+  /// <remarks>
+  /// Continuations which were never called are removed from the satisfaction graph.  The nodes are
+  /// retained for use by the next issuance.
+  /// </remarks>
+  void RunContinuations(void);
+
+  template<class Fn>
+  static void DestroyContinuation(void* pFn) {
+    static_cast<Fn*>(pFn)->~Fn();
+  }
+
+  template<class Fn>
+  static void CallCompletion(void* pFn, const AutoPacket& packet) {
+    (*static_cast<Fn*>(pFn))(packet);
+  }
+
+  /// <summary>
+  /// Constructs a copy of the callable within a new continuation node
+  /// </summary>
+  template<class Fn, class Fx>
+  autowiring::PacketContinuation& ConstructContinuation(Fn*& pFn, Fx&& fx) {
+    autowiring::PacketContinuation* node;
+    void* pMem = AllocateContinuation(node, sizeof(Fn), alignof(Fn));
+    try {
+      pFn = new (pMem) Fn(std::forward<Fx>(fx));
+    }
+    catch (...) {
+      FreeContinuation(*node);
+      throw;
+    }
+    return *node;
+  }
+
 
   /// <summary>
   /// Marks the specified entry as being unsatisfiable
@@ -112,9 +286,36 @@ protected:
   void MarkUnsatisfiable(const autowiring::DecorationKey& key);
 
   /// <summary>
-  /// Marks timeshifted decorations on successor packets as unsatisfiable
+  /// Records that one producer of the specified decoration has run without decorating this packet
   /// </summary>
-  void MarkSuccessorsUnsatisfiable(autowiring::DecorationKey type);
+  /// <remarks>
+  /// Once every producer has run, the decoration is complete, and unsatisfiable if no producer attached it
+  /// </remarks>
+  void SkipProducer(const autowiring::DecorationKey& key);
+
+  /// <returns>True if the specified decoration is to be published to the decoration history of the factory</returns>
+  /// <remarks>
+  /// Only decorations of types which some AutoFilter requests from a prior packet are published, and only
+  /// once this packet has been issued
+  /// </remarks>
+  bool IsHistoryKeyUnsafe(const autowiring::DecorationKey& key) const;
+
+  /// <summary>
+  /// Publishes the specified decoration to the decoration history of the factory, if it is complete
+  /// </summary>
+  /// <remarks>
+  /// This method must be called without m_lock held
+  /// </remarks>
+  void PublishDecoration(const autowiring::DecorationKey& key);
+
+  /// <summary>
+  /// Publishes every complete decoration of this packet that later packets may request
+  /// </summary>
+  /// <param name="final">True to publish incomplete decorations as well, as unsatisfiable</param>
+  /// <remarks>
+  /// This method must be called without m_lock held
+  /// </remarks>
+  void PublishHistory(bool final);
 
   /// <summary>
   /// Updates subscriber statuses given that the specified type information has been satisfied
@@ -127,6 +328,15 @@ protected:
   /// </remarks>
   void UpdateSatisfactionUnsafe(std::unique_lock<std::mutex> lk, const autowiring::DecorationDisposition& disposition);
 
+  /// <summary>
+  /// Updates subscriber statuses given that all of the specified decorations have been satisfied
+  /// </summary>
+  /// <remarks>
+  /// Every subscriber satisfied by any of the decorations is found before any of them is called, and
+  /// each is called once.  This method must be called with m_lock held.
+  /// </remarks>
+  void UpdateSatisfactionUnsafe(std::unique_lock<std::mutex> lk, const autowiring::DecorationDisposition* const* dispositions, size_t nDispositions);
+
   /// <summary>
   /// Performs a "satisfaction pulse", which will avoid notifying any deferred filters
   /// </summary>
@@ -136,17 +346,50 @@ protected:
   /// </remarks>
   void PulseSatisfactionUnsafe(std::unique_lock<std::mutex> lk, autowiring::DecorationDisposition* pTypeSubs [], size_t nInfos);
 
+  /// <summary>
+  /// Invokes the AutoFilters of the specified satisfied counters
+  /// </summary>
+  /// <remarks>
+  /// This method must be called without m_lock held.  If the packet has a thread pool, counters of equal
+  /// altitude are called concurrently, and all calls at one altitude complete before any call at a lower
+  /// altitude begins.  The calling thread participates in the calls.  If an AutoFilter throws, calls at
+  /// lower altitudes are abandoned and the first exception is rethrown once the altitude has completed.
+  /// Otherwise, counters are called in order on the calling thread.
+  /// </remarks>
+  void CallSatCounters(std::vector<autowiring::SatCounter*>& calls);
+
   /// <summary>Unsynchronized runtime counterpart to Has</summary>
   bool HasUnsafe(const autowiring::DecorationKey& key) const;
 
   /// <summary>
-  /// Performs a decoration operation but does not attach priors to successors.
+  /// Performs a decoration operation on this packet alone
   /// </summary>
   void DecorateNoPriors(const AnySharedPointer& ptr, autowiring::DecorationKey key);
 
   /// <summary>Runtime counterpart to Decorate</summary>
   void Decorate(const AnySharedPointer& ptr, autowiring::DecorationKey key);
 
+  /// <summary>Runtime counterpart to DecorateAll</summary>
+  void DecorateBatch(const AnySharedPointer* ptrs, size_t nPtrs);
+
+  /// <summary>
+  /// Wraps a decoration passed to DecorateAll in a shared pointer, copying it if necessary
+  /// </summary>
+  template<class T>
+  AnySharedPointer MakeBatchDecoration(const std::shared_ptr<T>& ptr) {
+    static_assert(!std::is_same<typename std::remove_const<T>::type, AutoPacket>::value, "Cannot decorate a packet with another packet");
+    return AnySharedPointer(std::const_pointer_cast<typename std::remove_const<T>::type>(ptr));
+  }
+
+  template<class T>
+  typename std::enable_if<
+    !autowiring::is_shared_ptr<typename std::decay<T>::type>::value,
+    AnySharedPointer
+  >::type MakeBatchDecoration(T&& t) {
+    static_assert(!std::is_pointer<typename std::decay<T>::type>::value, "Can't decorate using a pointer type.");
+    return AnySharedPointer(autowiring::MakeDecoration<typename std::decay<T>::type>(*this, std::forward<T&&>(t)));
+  }
+
   /// <summary>Runtime counterpart to RemoveDecoration</summary>
   void RemoveDecoration(autowiring::DecorationKey key);
 
@@ -199,6 +442,15 @@ public:
   /// </remarks>
   t_decorationMap GetDecorations(void) const;
 
+  /// <summary>
+  /// Visits each decoration disposition on this packet without copying them
+  /// </summary>
+  /// <remarks>
+  /// The packet's lock is held for the duration of the visit, so the visitor must not call back into
+  /// this packet.  Like GetDecorations, this is a diagnostic method.
+  /// </remarks>
+  void ForEachDecoration(const std::function<void(const autowiring::DecorationKey&, const autowiring::DecorationDisposition&)>& fn) const;
+
   /// <returns>
   /// True if the specified type is unsatisfiable
   /// </returns>
@@ -245,7 +497,15 @@ public:
   template<class T>
   bool Get(const T*& out, int tshift=0) const {
     autowiring::DecorationKey key(auto_id_t<T>{}, tshift);
-    const autowiring::DecorationDisposition* pDisposition = GetDisposition(key);
+    return Extract(GetDisposition(key), key, out);
+  }
+
+  /// <summary>
+  /// The portion of Get(const T*&, int) which follows the lookup of the disposition
+  /// </summary>
+  /// <param name="pDisposition">The disposition for the key if it is complete, otherwise nullptr</param>
+  template<class T>
+  static bool Extract(const autowiring::DecorationDisposition* pDisposition, const autowiring::DecorationKey& key, const T*& out) {
     if (pDisposition) {
       switch (pDisposition->m_decorations.size()) {
       case 0:
@@ -287,9 +547,17 @@ public:
     static_assert(std::is_const<T>::value, "Cannot get a non-const shared pointer from AutoPacket, declare as `const std::shared_ptr<const T>*`");
     typedef typename std::remove_const<T>::type TActual;
 
-    // Decoration must be present and the shared pointer itself must also be present
     autowiring::DecorationKey key(auto_id_t<TActual>{}, tshift);
-    const autowiring::DecorationDisposition* pDisposition = GetDisposition(key);
+    return Extract(GetDisposition(key), key, out);
+  }
+
+  /// <summary>
+  /// The portion of Get(const std::shared_ptr<T>*&, int) which follows the lookup of the disposition
+  /// </summary>
+  /// <param name="pDisposition">The disposition for the key if it is complete, otherwise nullptr</param>
+  template<class T>
+  static bool Extract(const autowiring::DecorationDisposition* pDisposition, const autowiring::DecorationKey& key, const std::shared_ptr<T>*& out) {
+    // Decoration must be present and the shared pointer itself must also be present
     if (!pDisposition) {
       out = nullptr;
       return false;
@@ -319,9 +587,9 @@ public:
   template<class T>
   bool Get(std::shared_ptr<const T>& out, int tshift = 0) const {
     std::lock_guard<std::mutex> lk(m_lock);
-    auto deco = m_decoration_map.find(autowiring::DecorationKey(auto_id_t<T>{}, tshift));
-    if(deco != m_decoration_map.end() && deco->second.m_state == autowiring::DispositionState::Complete) {
-      auto& disposition = deco->second;
+    auto deco = FindDispositionUnsafe(autowiring::DecorationKey(auto_id_t<T>{}, tshift));
+    if(deco && deco->m_state == autowiring::DispositionState::Complete) {
+      auto& disposition = *deco;
       if(disposition.m_decorations.size() == 1) {
         out = disposition.m_decorations[0].as<T>();
         return true;
@@ -365,11 +633,10 @@ public:
     const autowiring::DecorationKey key(auto_id_t<TActual>{}, tshift);
 
     std::lock_guard<std::mutex> lk(m_lock);
-    auto q = m_decoration_map.find(key);
-    if (q == m_decoration_map.end() || q->second.m_state != autowiring::DispositionState::Complete)
+    autowiring::DecorationDisposition* pDisposition = FindDispositionUnsafe(key);
+    if (!pDisposition || pDisposition->m_state != autowiring::DispositionState::Complete)
       ThrowNotDecoratedException(key);
 
-    autowiring::DecorationDisposition* pDisposition =  &q->second;
     switch (pDisposition->m_decorations.size()) {
     case 0:
       // No shared pointer decorations available, we have add one
@@ -384,23 +651,53 @@ public:
     return std::move(pDisposition->m_decorations[0].as<T>());
   }
 
+  /// <summary>
+  /// Returns a view of all decorations of type T, without copying them
+  /// </summary>
+  /// <remarks>
+  /// The view is only stable once every producer of T has run, see autowiring::DecorationView
+  /// </remarks>
+  template<class T>
+  autowiring::DecorationView<T> GetAllView(int tshift = 0) const {
+    typedef typename std::remove_const<T>::type TActual;
+    std::lock_guard<std::mutex> lk(m_lock);
+
+    return ExtractAll<T>(FindDispositionUnsafe(autowiring::DecorationKey(auto_id_t<TActual>{}, tshift)));
+  }
+
+  /// <summary>
+  /// The portion of GetAllView which follows the lookup of the disposition
+  /// </summary>
+  /// <param name="pDisposition">The disposition for the decoration, or nullptr if there is none</param>
+  template<class T>
+  static autowiring::DecorationView<T> ExtractAll(const autowiring::DecorationDisposition* pDisposition) {
+    if (!pDisposition || pDisposition->m_decorations.empty())
+      return autowiring::DecorationView<T>{};
+
+    const AnySharedPointer* first = pDisposition->m_decorations.data();
+    return autowiring::DecorationView<T>{first, first + pDisposition->m_decorations.size()};
+  }
+
   /// <summary>
   /// Returns a null-terminated buffer containing all decorations
   /// </summary>
   /// <returns>The null-terminated buffer</returns>
+  /// <remarks>
+  /// GetAllView returns the same decorations without allocating
+  /// </remarks>
   template<class T>
   std::unique_ptr<const T*[]> GetAll(int tshift = 0) const {
     std::lock_guard<std::mutex> lk(m_lock);
 
     // If decoration doesn't exist, return empty null-terminated buffer
-    auto q = m_decoration_map.find(autowiring::DecorationKey(auto_id_t<T>{}, tshift));
-    if (q == m_decoration_map.end())
+    auto q = FindDispositionUnsafe(autowiring::DecorationKey(auto_id_t<T>{}, tshift));
+    if (!q)
       return std::unique_ptr<const T*[]>{
         new const T*[1] {nullptr}
       };
 
     // Transfer in, return to caller:
-    const auto& decorations = q->second.m_decorations;
+    const auto& decorations = q->m_decorations;
     std::unique_ptr<const T* []> retVal{new const T*[decorations.size() + 1]};
     for (size_t i = 0; i < decorations.size(); i++)
       retVal[i] = static_cast<const T*>(decorations[i].ptr());
@@ -418,14 +715,14 @@ public:
     typedef typename std::remove_const<T>::type TActual;
 
     // If decoration doesn't exist, return empty null-terminated buffer
-    auto q = m_decoration_map.find(autowiring::DecorationKey(auto_id_t<TActual>{}, tshift));
-    if (q == m_decoration_map.end())
+    auto q = FindDispositionUnsafe(autowiring::DecorationKey(auto_id_t<TActual>{}, tshift));
+    if (!q)
       return std::unique_ptr<std::shared_ptr<const T>[]>{
         new std::shared_ptr<const T>[1] {nullptr}
       };
 
     // Transfer in, return to caller:
-    const auto& decorations = q->second.m_decorations;
+    const auto& decorations = q->m_decorations;
     std::unique_ptr<std::shared_ptr<const T>[]> retVal{
       new std::shared_ptr<const T>[decorations.size() + 1]
     };
@@ -510,7 +807,7 @@ public:
     typedef typename std::decay<T>::type TActual;
 
     // Create a copy of the input, put the copy in a shared pointer
-    auto ptr = std::make_shared<TActual>(std::forward<T&&>(t));
+    auto ptr = autowiring::MakeDecoration<TActual>(*this, std::forward<T&&>(t));
     Decorate(
       AnySharedPointer(ptr),
       autowiring::DecorationKey(auto_id_t<TActual>{}, 0)
@@ -518,6 +815,24 @@ public:
     return *ptr;
   }
 
+  /// <summary>
+  /// Decorates this packet with every one of the passed values at once
+  /// </summary>
+  /// <remarks>
+  /// Each value is attached as though by Decorate, shared pointers directly and other values by copy.
+  /// All values are attached under a single acquisition of this packet's lock, and only then are the
+  /// AutoFilters satisfied by any of them called, each one once.  No AutoFilter observes the packet with
+  /// only some of the values attached.
+  ///
+  /// If any value cannot be attached because its type is already satisfied, an exception is thrown and
+  /// none of the values are attached.
+  /// </remarks>
+  template<class... Ts>
+  void DecorateAll(Ts&&... ts) {
+    AnySharedPointer ptrs[] = { MakeBatchDecoration(std::forward<Ts&&>(ts))... };
+    DecorateBatch(ptrs, sizeof...(Ts));
+  }
+
   /// <summary>
   /// Decorates this packet with a particular type T, forwarding the arguments to the constructor of T.
   /// </summary>
@@ -530,7 +845,7 @@ public:
   const T& Emplace(Args&&... args) {
     static_assert(!std::is_pointer<T>::value, "Can't decorate using a pointer type.");
     // Create a copy of the input, put the copy in a shared pointer
-    auto ptr = std::make_shared<T>(std::forward<Args&&>(args)...);
+    auto ptr = autowiring::MakeDecoration<T>(*this, std::forward<Args&&>(args)...);
     Decorate(
       AnySharedPointer(ptr),
       autowiring::DecorationKey(auto_id_t<T>(), 0)
@@ -737,6 +1052,92 @@ public:
     return Wait(cv, inputs, duration);
   }
 
+  /// <summary>
+  /// Calls the passed function once all of its inputs are present on this packet
+  /// </summary>
+  /// <remarks>
+  /// The function is called as an AutoFilter on whichever thread satisfies its last input, or before
+  /// this method returns if its inputs are already satisfied.  Nothing blocks while it waits.  If the
+  /// packet is released before the inputs are satisfied, the function is destroyed without being
+  /// called.
+  ///
+  /// The function must not take any output arguments.  A function no larger than eight pointers is
+  /// held within the packet, and pooled packets reuse that storage, so that attaching it allocates
+  /// nothing.
+  /// </remarks>
+  template<class Fx>
+  void Then(Fx&& fx) {
+    typedef typename std::decay<Fx>::type Fn;
+    typedef decltype(&Fn::operator()) t_call;
+    static_assert(
+      !autowiring::Decompose<t_call>::template any<autowiring::arg_is_out>::value,
+      "A packet continuation may not take any output arguments"
+    );
+    typedef autowiring::CE<t_call, typename autowiring::make_index_tuple<autowiring::Decompose<t_call>::N>::type> t_extractor;
+
+    // Fn must be completely defined at this point because we are trying to pull out an AutoFilter from it
+    (void) auto_id_t_init<Fn>::init;
+
+    Fn* pFn;
+    autowiring::PacketContinuation& node = ConstructContinuation(pFn, std::forward<Fx>(fx));
+    AttachContinuation(
+      node,
+      &DestroyContinuation<Fn>,
+      {
+        AnySharedPointer(std::shared_ptr<Fn>(std::shared_ptr<Fn>(), pFn)),
+        auto_id_t<Fn>{},
+        autowiring::altitude::Dispatch,
+        autowiring::Decompose<t_call>::template Enumerate<autowiring::AutoFilterArgument, autowiring::AutoFilterArgumentT>::types,
+        false,
+        &t_extractor::template Call<&Fn::operator()>
+      }
+    );
+  }
+
+  /// <summary>
+  /// Calls the passed function with this packet when the packet is released
+  /// </summary>
+  /// <remarks>
+  /// The function is called on the thread releasing the last reference to the packet, after every
+  /// AutoFilter has run and before teardown listeners are notified.  The packet may be inspected but
+  /// not decorated.  Storage for the function is obtained as described for Then.
+  /// </remarks>
+  template<class Fx>
+  void OnComplete(Fx&& fx) {
+    typedef typename std::decay<Fx>::type Fn;
+    Fn* pFn;
+    AttachCompletion(
+      ConstructContinuation(pFn, std::forward<Fx>(fx)),
+      &DestroyContinuation<Fn>,
+      &CallCompletion<Fn>
+    );
+  }
+
+  template<class T>
+  struct FutureStub {
+    std::promise<std::shared_ptr<const T>> promise;
+
+    void operator()(std::shared_ptr<const T> value) {
+      if (value)
+        promise.set_value(std::move(value));
+      else
+        promise.set_exception(std::make_exception_ptr(autowiring_error("Decoration was marked unsatisfiable")));
+    }
+  };
+
+  /// <returns>A future which becomes ready once a decoration of type T is attached to this packet</returns>
+  /// <remarks>
+  /// If the decoration is marked unsatisfiable, the future holds an autowiring_error.  If the packet is
+  /// released without the decoration, the future holds a broken_promise error.
+  /// </remarks>
+  template<class T>
+  std::future<std::shared_ptr<const T>> GetFuture(void) {
+    FutureStub<T> stub;
+    auto retVal = stub.promise.get_future();
+    Then(std::move(stub));
+    return retVal;
+  }
+
   /// <summary>
   /// Retrieves the current packet being processed by an AutoFilter
   /// </summary>
@@ -825,8 +1226,88 @@ public:
 
   /// Get the context of this packet (The context of the AutoPacketFactory that created this context)
   std::shared_ptr<CoreContext> GetContext(void) const;
+
+  /// <returns>True if the factory abandoned this packet to make room for a newer one</returns>
+  /// <remarks>
+  /// AutoFilters are not called on an abandoned packet, but calls already underway are allowed to
+  /// finish.  Long-running and deferred AutoFilters may check this flag to give up early.
+  /// </remarks>
+  bool IsAbandoned(void) const { return m_abandoned; }
+
+  /// <summary>
+  /// Sets the time after which no more AutoFilters are to be called on this packet
+  /// </summary>
+  /// <remarks>
+  /// Calls already underway when the deadline passes are allowed to finish.  AutoFilters which become
+  /// ready after the deadline are skipped, and their outputs are marked unsatisfiable, so that
+  /// AutoFilters taking those outputs as optional inputs are still called.  AutoFilters with an optional
+  /// input are never skipped, they are expected to cope with whatever the packet has to offer.  Skipped
+  /// AutoFilters are counted by the factory; see AutoPacketFactory::GetShedStatistics.
+  ///
+  /// Deferred AutoFilters are checked again when their pended call is run, so a deferred AutoFilter
+  /// whose call waited in its dispatch queue until after the deadline is skipped as well.
+  /// </remarks>
+  void SetDeadline(std::chrono::steady_clock::time_point deadline);
+
+  /// <summary>
+  /// Sets the deadline of this packet to the specified time from now
+  /// </summary>
+  void SetDeadline(std::chrono::nanoseconds budget) { SetDeadline(std::chrono::steady_clock::now() + budget); }
+
+  /// <summary>
+  /// Removes the deadline from this packet, AutoFilters not yet skipped will be called
+  /// </summary>
+  void ClearDeadline(void) { m_deadline = 0; }
+
+  /// <returns>True if this packet has a deadline</returns>
+  bool HasDeadline(void) const { return m_deadline != 0; }
+
+  /// <returns>The deadline of this packet, valid only if HasDeadline returns true</returns>
+  std::chrono::steady_clock::time_point GetDeadline(void) const;
+
+  /// <returns>True if this packet has a deadline which has passed</returns>
+  bool IsPastDeadline(void) const;
+
+  /// <summary>
+  /// Skips an AutoFilter if this packet's deadline has passed, unless the AutoFilter takes an optional input
+  /// </summary>
+  /// <param name="args">The arguments of the AutoFilter, terminated by a default-constructed argument</param>
+  /// <returns>True if the AutoFilter was skipped and must not be called</returns>
+  /// <remarks>
+  /// The outputs of a skipped AutoFilter are marked unsatisfiable.
+  /// </remarks>
+  bool ShedIfPastDeadline(const autowiring::AutoFilterArgument* args);
+
+  /// <returns>The arena in which this packet's decorations are constructed, or nullptr if there is none</returns>
+  autowiring::DecorationArena* GetDecorationArena(void) const { return m_arena.get(); }
+
+  /// <returns>The pool from which decorations of type T are constructed, or nullptr if there is none</returns>
+  template<class T>
+  autowiring::DecorationPool<T>* GetDecorationPool(void) const {
+    if (!m_decorationPools)
+      return nullptr;
+    auto q = m_decorationPools->find(auto_id_t<T>{});
+    return q == m_decorationPools->end() ? nullptr : static_cast<autowiring::DecorationPool<T>*>(q->second.get());
+  }
 };
 
+namespace autowiring {
+  template<class T, class... Args>
+  std::shared_ptr<T> MakeDecoration(AutoPacket& packet, Args&&... args) {
+    if (DecorationPool<T>* pool = packet.GetDecorationPool<T>()) {
+      std::shared_ptr<T> retVal = pool->Obtain(std::forward<Args&&>(args)...);
+      if (retVal)
+        return retVal;
+    }
+
+    // Types with extended alignment cannot be placed in the arena
+    DecorationArena* arena = packet.GetDecorationArena();
+    if (arena && alignof(T) <= DecorationArena::sc_alignment)
+      return std::allocate_shared<T>(DecorationArenaAllocator<T>(*arena), std::forward<Args&&>(args)...);
+    return std::make_shared<T>(std::forward<Args&&>(args)...);
+  }
+}
+
 namespace autowiring {
   template<typename Arg, typename Pack, typename>
   struct choice {
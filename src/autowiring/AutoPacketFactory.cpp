@@ -2,14 +2,30 @@
 #include "stdafx.h"
 #include "AutoPacketFactory.h"
 #include "AutoPacketInternal.hpp"
+#include "AutoPacketTemplate.h"
 #include "CoreContext.h"
-#include "SatCounter.h"
-#include <cmath>
+#include "ThreadPool.h"
+#include <algorithm>
+#include <thread>
 
 using namespace autowiring;
 
 AutoPacketFactory::AutoPacketFactory(void):
-  ContextMember("AutoPacketFactory")
+  ContextMember("AutoPacketFactory"),
+  m_packetPool(
+    ~0,
+    ~0,
+    [this] (AutoPacketInternal* ptr) {
+      new (ptr) AutoPacketInternal(*this, std::shared_ptr<void>());
+    },
+    [this] (AutoPacketInternal& packet) {
+      packet.Reissue(*this, GetInternalOutstanding());
+    },
+    [] (AutoPacketInternal& packet) {
+      packet.Recycle();
+    }
+  ),
+  m_packetLifetimes(new LatencyHistogram[sc_nLifetimeShards])
 {}
 
 AutoPacketFactory::~AutoPacketFactory() {}
@@ -25,29 +41,234 @@ std::shared_ptr<AutoPacket> AutoPacketFactory::NewPacket(void) {
   if(!IsRunning())
     throw autowiring_error("Cannot create a packet until the AutoPacketFactory is started");
 
+  // Obtain the compiled satisfaction graph, this is where an invalid graph will be detected
+  auto packetTemplate = GetPacketTemplate();
+
   std::shared_ptr<AutoPacketInternal> retVal;
-  bool isFirstPacket;
+  std::shared_ptr<AutoPacketInternal> abandoned;
+  uint64_t sequence;
   {
-    std::lock_guard<std::mutex> lk(m_lock);
-
-    // New packet issued
-    isFirstPacket = !m_packetCount;
-    ++m_packetCount;
+    std::unique_lock<std::mutex> lk(m_lock);
+
+    if (m_packetCap && m_nInFlight >= m_packetCap)
+      switch (m_capPolicy) {
+      case CapPolicy::RecycleOldest:
+        while (!abandoned && !m_inFlightPackets.empty()) {
+          abandoned = m_inFlightPackets.front().lock();
+          m_inFlightPackets.pop_front();
+        }
+        if (abandoned) {
+          m_capStatistics.nRecycled++;
+          break;
+        }
+
+        // None of the outstanding packets can be abandoned, they were issued before this policy was
+        // selected or are already being destroyed.  Wait for one of them to be released instead.
+        // Fall through
+      case CapPolicy::Block:
+        {
+          m_capStatistics.nBlocked++;
+          m_nCapWaiters++;
+          auto pred = [this] { return m_nInFlight < m_packetCap || !m_packetCap || ShouldStop(); };
+          bool released = true;
+          if (m_capTimeout == std::chrono::nanoseconds::max())
+            m_stateCondition.wait(lk, pred);
+          else
+            released = m_stateCondition.wait_for(lk, m_capTimeout, pred);
+          m_nCapWaiters--;
+
+          if (!released) {
+            m_capStatistics.nTimedOut++;
+            throw autowiring_error("Timed out waiting for an outstanding packet to be released");
+          }
+          if (ShouldStop())
+            throw autowiring_error("Attempted to create a packet on an AutoPacketFactory that was already terminated");
+        }
+        break;
+      case CapPolicy::Fail:
+        m_capStatistics.nFailed++;
+        throw autowiring_error("Cannot create a packet, the cap on outstanding packets has been reached");
+      }
+
+    // New packet issued, counted before it can be abandoned by anyone else
+    sequence = m_packetCount++;
+    ++m_nInFlight;
 
     // Create a new next packet
     retVal = m_nextPacket;
     m_nextPacket = retVal->SuccessorInternal();
     m_curPacket = retVal;
+    retVal->MarkInFlight();
+
+    // Packets must be registered with the history in the order they are issued
+    m_history.Issue(sequence, retVal, *packetTemplate);
+
+    if (m_packetCap && m_capPolicy == CapPolicy::RecycleOldest) {
+      // Packets released out of order leave expired entries behind, sweep them out occasionally
+      if (m_inFlightPackets.size() >= 2 * m_packetCap)
+        m_inFlightPackets.erase(
+          std::remove_if(
+            m_inFlightPackets.begin(),
+            m_inFlightPackets.end(),
+            [] (const std::weak_ptr<AutoPacketInternal>& packet) { return packet.expired(); }
+          ),
+          m_inFlightPackets.end()
+        );
+      m_inFlightPackets.push_back(retVal);
+    }
+  }
+
+  // Abandon outside of the lock, this may be the last reference to the packet
+  if (abandoned) {
+    abandoned->Abandon();
+    abandoned.reset();
   }
 
-  retVal->Initialize(isFirstPacket);
+  retVal->Initialize(sequence, packetTemplate);
   return retVal;
 }
 
 std::shared_ptr<AutoPacketInternal> AutoPacketFactory::ConstructPacket(void) {
+  if (IsPacketPoolingEnabled())
+    return m_packetPool();
   return std::make_shared<AutoPacketInternal>(*this, GetInternalOutstanding());
 }
 
+void AutoPacketFactory::SetPacketPooling(bool enabled) {
+  m_poolPackets = enabled;
+}
+
+bool AutoPacketFactory::IsPacketPoolingEnabled(void) const {
+  return m_poolPackets;
+}
+
+void AutoPacketFactory::SetFilterThreadPool(std::shared_ptr<ThreadPool> threadPool) {
+  std::lock_guard<std::mutex> lk(m_lock);
+  m_threadPool.swap(threadPool);
+}
+
+std::shared_ptr<ThreadPool> AutoPacketFactory::GetFilterThreadPool(void) const {
+  std::lock_guard<std::mutex> lk(m_lock);
+  return m_threadPool;
+}
+
+void AutoPacketFactory::SetFilterProfiling(bool enabled) {
+  std::lock_guard<std::mutex> lk(m_lock);
+  m_profileFilters = enabled;
+  if (enabled && !m_filterProfiler)
+    m_filterProfiler = std::make_shared<AutoFilterProfiler>();
+}
+
+bool AutoPacketFactory::IsFilterProfilingEnabled(void) const {
+  std::lock_guard<std::mutex> lk(m_lock);
+  return m_profileFilters;
+}
+
+std::shared_ptr<AutoFilterProfiler> AutoPacketFactory::GetFilterProfiler(void) const {
+  std::lock_guard<std::mutex> lk(m_lock);
+  return m_profileFilters ? m_filterProfiler : nullptr;
+}
+
+std::vector<AutoFilterProfile> AutoPacketFactory::GetFilterProfiles(void) const {
+  std::shared_ptr<AutoFilterProfiler> profiler;
+  {
+    std::lock_guard<std::mutex> lk(m_lock);
+    profiler = m_filterProfiler;
+  }
+  return profiler ? profiler->GetProfiles() : std::vector<AutoFilterProfile>{};
+}
+
+void AutoPacketFactory::ResetFilterProfiles(void) {
+  std::shared_ptr<AutoFilterProfiler> profiler;
+  {
+    std::lock_guard<std::mutex> lk(m_lock);
+    profiler = m_filterProfiler;
+  }
+  if (profiler)
+    profiler->Reset();
+}
+
+void AutoPacketFactory::SetFlightRecorder(std::shared_ptr<FlightRecorder> recorder) {
+  std::lock_guard<std::mutex> lk(m_lock);
+  m_flightRecorder = std::move(recorder);
+}
+
+std::shared_ptr<FlightRecorder> AutoPacketFactory::GetFlightRecorder(void) const {
+  std::lock_guard<std::mutex> lk(m_lock);
+  return m_flightRecorder;
+}
+
+void AutoPacketFactory::SetDecorationPool(auto_id id, std::shared_ptr<DecorationPoolBase> pool) {
+  std::shared_ptr<const DecorationPoolMap> prior;
+  std::lock_guard<std::mutex> lk(m_lock);
+
+  // Outstanding packets keep the map they were issued with, so a new map is always made
+  std::shared_ptr<DecorationPoolMap> pools = m_decorationPools ?
+    std::make_shared<DecorationPoolMap>(*m_decorationPools) :
+    std::make_shared<DecorationPoolMap>();
+  if (pool)
+    (*pools)[id] = std::move(pool);
+  else
+    pools->erase(id);
+
+  // The prior map is released after the lock, it may hold the last reference to a pool
+  prior = std::move(m_decorationPools);
+  if (!pools->empty())
+    m_decorationPools = std::move(pools);
+}
+
+std::shared_ptr<const DecorationPoolMap> AutoPacketFactory::GetDecorationPools(void) const {
+  std::lock_guard<std::mutex> lk(m_lock);
+  return m_decorationPools;
+}
+
+void AutoPacketFactory::SetOutstandingPacketCap(size_t cap, CapPolicy policy, std::chrono::nanoseconds timeout) {
+  std::lock_guard<std::mutex> lk(m_lock);
+  m_packetCap = cap;
+  m_capPolicy = policy;
+  m_capTimeout = timeout;
+  if (!cap || policy != CapPolicy::RecycleOldest)
+    m_inFlightPackets.clear();
+
+  // Waiters may be able to proceed under the new cap
+  m_stateCondition.notify_all();
+}
+
+size_t AutoPacketFactory::GetOutstandingPacketCap(void) const {
+  std::lock_guard<std::mutex> lk(m_lock);
+  return m_packetCap;
+}
+
+AutoPacketFactory::CapStatistics AutoPacketFactory::GetCapStatistics(void) const {
+  std::lock_guard<std::mutex> lk(m_lock);
+  return m_capStatistics;
+}
+
+void AutoPacketFactory::SetPacketDeadline(std::chrono::nanoseconds budget) {
+  m_packetDeadline = std::max(budget, std::chrono::nanoseconds::zero()).count();
+}
+
+AutoPacketFactory::ShedStatistics AutoPacketFactory::GetShedStatistics(void) const {
+  ShedStatistics retVal;
+  retVal.nFilters = m_nShedFilters;
+  retVal.nPackets = m_nShedPackets;
+  return retVal;
+}
+
+void AutoPacketFactory::RecordShedFilter(bool firstOnPacket) {
+  m_nShedFilters++;
+  if (firstOnPacket)
+    m_nShedPackets++;
+}
+
+void AutoPacketFactory::ReleaseInFlightPacket(void) {
+  m_nInFlight--;
+  if (m_nCapWaiters) {
+    std::lock_guard<std::mutex> lk(m_lock);
+    m_stateCondition.notify_all();
+  }
+}
+
 bool AutoPacketFactory::IsAutoPacketType(const std::type_info& dataType) {
   return
     dataType == typeid(AutoPacket) ||
@@ -83,25 +304,24 @@ std::vector<AutoFilterDescriptor> AutoPacketFactory::GetAutoFilters(void) const
   return retVal;
 }
 
-SatCounter* AutoPacketFactory::CreateSatCounterList(void) const {
+size_t AutoPacketFactory::GetFilterVersion(void) const {
   std::lock_guard<std::mutex> lk(m_lock);
+  return m_filterVersion;
+}
 
-  // Trivial return check
-  if (m_autoFilters.empty())
-    return nullptr;
-
-  auto q = m_autoFilters.begin();
+std::shared_ptr<const AutoPacketTemplate> AutoPacketFactory::GetPacketTemplate(void) {
+  // Any template being replaced is released outside of the lock
+  std::shared_ptr<const AutoPacketTemplate> prior;
 
-  // Construct the linked list.  This code implements a push-front so that retVal
-  // always refers to the first element of the linked list.
-  SatCounter* retVal = new SatCounter(*q);
-  while (++q != m_autoFilters.end()) {
-    SatCounter* next = new SatCounter(*q);
-    retVal->blink = next;
-    next->flink = retVal;
-    retVal = next;
-  }
-  return retVal;
+  std::lock_guard<std::mutex> lk(m_lock);
+  if (m_packetTemplate && m_packetTemplate->GetVersion() == m_filterVersion)
+    return m_packetTemplate;
+
+  // Counters are linked with the most recently added AutoFilter first
+  std::vector<AutoFilterDescriptor> filters(m_autoFilters.rbegin(), m_autoFilters.rend());
+  prior = std::make_shared<AutoPacketTemplate>(m_filterVersion, filters);
+  prior.swap(m_packetTemplate);
+  return m_packetTemplate;
 }
 
 bool AutoPacketFactory::OnStart(void) {
@@ -116,15 +336,22 @@ bool AutoPacketFactory::OnStart(void) {
 void AutoPacketFactory::OnStop(bool graceful) {
   // Queue of local variables to be destroyed when leaving scope
   t_autoFilterSet autoFilters;
+  std::shared_ptr<const AutoPacketTemplate> packetTemplate;
 
   // Reset next packet, it will never be issued
   m_nextPacket.reset();
 
+  // Pooled packets hold references to our AutoFilters, which may in turn hold references to us.
+  // Release the cache and ensure packets still outstanding are destroyed when they are returned.
+  m_packetPool.SetMaximumPooledEntities(0);
+
   // Lock destruction precedes local variables
   std::lock_guard<std::mutex>{m_lock},
 
   // Same story with the AutoFilters
-  autoFilters.swap(m_autoFilters);
+  autoFilters.swap(m_autoFilters),
+  packetTemplate.swap(m_packetTemplate),
+  m_filterVersion++;
 
   // Now we can lock, update state, and notify any listeners
   m_stateCondition.notify_all();
@@ -158,14 +385,21 @@ void AutoPacketFactory::Clear(void) {
 
 const AutoFilterDescriptor& AutoPacketFactory::AddSubscriber(const AutoFilterDescriptor& rhs) {
   std::lock_guard<std::mutex> lk(m_lock);
-  m_autoFilters.insert(rhs);
+  if (m_autoFilters.insert(rhs).second)
+    m_filterVersion++;
   return rhs;
 }
 
 void AutoPacketFactory::RemoveSubscriber(const AutoFilterDescriptor& autoFilter) {
+  // The stale template may hold the last reference to the filter, release it outside of the lock
+  std::shared_ptr<const AutoPacketTemplate> packetTemplate;
+
   // Trivial removal from the autofilter set:
   std::lock_guard<std::mutex> lk(m_lock);
-  m_autoFilters.erase(autoFilter);
+  if (m_autoFilters.erase(autoFilter)) {
+    m_filterVersion++;
+    packetTemplate.swap(m_packetTemplate);
+  }
 }
 
 void AutoPacketFactory::operator-=(const AutoFilterDescriptor& desc) {
@@ -181,32 +415,55 @@ AutoFilterDescriptor AutoPacketFactory::GetTypeDescriptorUnsafe(auto_id nodeType
   return AutoFilterDescriptor();
 }
 
+void AutoPacketFactory::PublishDecoration(uint64_t sequence, auto_id id, const AnySharedPointer& value) {
+  m_history.Publish(sequence, id, value);
+}
+
 size_t AutoPacketFactory::GetOutstandingPacketCount(void) const {
   // Next packet is stored internally, don't count that packet
   return m_outstandingInternal.use_count() - 1;
 }
 
 void AutoPacketFactory::RecordPacketDuration(std::chrono::nanoseconds duration) {
-  std::unique_lock<std::mutex> lk(m_lock);
-  m_packetDurationSum += duration.count();
-  m_packetDurationSqSum += duration.count() * duration.count();
+  m_packetLifetimes[std::hash<std::thread::id>()(std::this_thread::get_id()) % sc_nLifetimeShards].Record(duration);
 }
 
-double AutoPacketFactory::GetMeanPacketLifetime(void) {
-  return m_packetDurationSum / m_packetCount;
+long long AutoPacketFactory::GetTotalPacketCount(void) const {
+  long long retVal = 0;
+  for (size_t i = 0; i < sc_nLifetimeShards; i++)
+    retVal += m_packetLifetimes[i].GetCount();
+  return retVal;
 }
 
-double AutoPacketFactory::GetPacketLifetimeStandardDeviation(void) {
-  double mean = m_packetDurationSum / m_packetCount;
-  double variance = m_packetDurationSqSum / m_packetCount - mean * mean;
-  return std::sqrt(variance >= 0.0 ? variance : 0.0 );
+LatencyHistogram AutoPacketFactory::GetPacketLifetimes(void) const {
+  LatencyHistogram retVal;
+  for (size_t i = 0; i < sc_nLifetimeShards; i++)
+    retVal.Merge(m_packetLifetimes[i]);
+  return retVal;
+}
+
+double AutoPacketFactory::GetMeanPacketLifetime(void) const {
+  return static_cast<double>(GetPacketLifetimes().GetMean().count());
+}
+
+double AutoPacketFactory::GetPacketLifetimeStandardDeviation(void) const {
+  return static_cast<double>(GetPacketLifetimes().GetStandardDeviation().count());
+}
+
+std::chrono::nanoseconds AutoPacketFactory::GetPacketLifetimePercentile(double percentile) const {
+  return GetPacketLifetimes().GetPercentile(percentile);
+}
+
+std::chrono::nanoseconds AutoPacketFactory::GetMaxPacketLifetime(void) const {
+  std::chrono::nanoseconds retVal(0);
+  for (size_t i = 0; i < sc_nLifetimeShards; i++)
+    retVal = std::max(retVal, m_packetLifetimes[i].GetMax());
+  return retVal;
 }
 
 void AutoPacketFactory::ResetPacketStatistics(void) {
-  std::unique_lock<std::mutex> lk(m_lock);
-  m_packetCount = 0;
-  m_packetDurationSum = 0.0;
-  m_packetDurationSqSum = 0.0;
+  for (size_t i = 0; i < sc_nLifetimeShards; i++)
+    m_packetLifetimes[i].Reset();
 }
 
 template struct autowiring ::SlotInformationStump<AutoPacketFactory, false>;
@@ -2,15 +2,26 @@
 #pragma once
 #include "AutoPacket.h"
 #include "AutoFilterDescriptor.h"
+#include "AutoFilterProfiler.h"
 #include "ContextMember.h"
 #include "CoreRunnable.h"
+#include "DecorationHistory.h"
+#include "FlightRecorder.h"
+#include "LatencyHistogram.h"
+#include "ObjectPool.h"
 #include "TypeRegistry.h"
 #include CHRONO_HEADER
 #include TYPE_TRAITS_HEADER
+#include <deque>
 #include <set>
 
 class AutoPacketInternal;
 
+namespace autowiring {
+  class AutoPacketTemplate;
+  class ThreadPool;
+}
+
 /// <summary>
 /// A configurable factory class for pipeline packets with a built-in object pool
 /// </summary>
@@ -26,6 +37,46 @@ public:
   AutoPacketFactory(const AutoPacketFactory& rhs) = delete;
   ~AutoPacketFactory(void);
 
+  /// <summary>
+  /// Actions NewPacket may take when the cap on outstanding packets has been reached
+  /// </summary>
+  enum class CapPolicy {
+    // Wait for an outstanding packet to be released, up to the cap timeout
+    Block,
+
+    // Throw an autowiring_error immediately
+    Fail,
+
+    // Abandon the oldest outstanding packet and issue a new one in its place
+    RecycleOldest
+  };
+
+  /// <summary>
+  /// The number of times each cap policy took effect
+  /// </summary>
+  struct CapStatistics {
+    // Calls to NewPacket which had to wait for a packet to be released, and those which gave up waiting
+    uint64_t nBlocked = 0;
+    uint64_t nTimedOut = 0;
+
+    // Calls to NewPacket which failed immediately
+    uint64_t nFailed = 0;
+
+    // Packets abandoned to make room for newer ones
+    uint64_t nRecycled = 0;
+  };
+
+  /// <summary>
+  /// The amount of work skipped because packet deadlines had passed
+  /// </summary>
+  struct ShedStatistics {
+    // AutoFilters which were not called because their packet's deadline had passed
+    uint64_t nFilters = 0;
+
+    // Packets on which at least one AutoFilter was not called
+    uint64_t nPackets = 0;
+  };
+
 private:
   // Lock for this type
   mutable std::mutex m_lock;
@@ -46,10 +97,68 @@ private:
   typedef std::set<autowiring::AutoFilterDescriptor> t_autoFilterSet;
   t_autoFilterSet m_autoFilters;
 
-  // Accumulators used to compute statistics about AutoPacket lifespan.
+  // Incremented whenever m_autoFilters is changed.  Pooled packets use this to decide whether the
+  // satisfaction graph they were built with may be reused.
+  size_t m_filterVersion = 1;
+
+  // The satisfaction graph compiled from m_autoFilters, built on demand when the filter set changes
+  std::shared_ptr<const autowiring::AutoPacketTemplate> m_packetTemplate;
+
+  // Packet recycling, used when packet pooling is enabled
+  std::atomic<bool> m_poolPackets{false};
+  ObjectPool<AutoPacketInternal> m_packetPool;
+
+  // Size of the chunks in each packet's decoration arena, or zero if packets allocate decorations from the heap
+  std::atomic<size_t> m_arenaChunkSize{0};
+
+  // Pool on which independent AutoFilters are run concurrently, if parallel execution is enabled
+  std::shared_ptr<autowiring::ThreadPool> m_threadPool;
+
+  // The number of issued packets which have not yet been finalized or abandoned
+  std::atomic<size_t> m_nInFlight{0};
+
+  // Cap on m_nInFlight and the action taken when it is reached, guarded by m_lock.  A cap of zero
+  // means that there is no cap.
+  size_t m_packetCap = 0;
+  CapPolicy m_capPolicy = CapPolicy::Block;
+  std::chrono::nanoseconds m_capTimeout = std::chrono::nanoseconds::max();
+  CapStatistics m_capStatistics;
+
+  // The deadline given to each packet when it is issued, measured from issuance, or zero for none
+  std::atomic<int64_t> m_packetDeadline{0};
+
+  // Work skipped because packet deadlines had passed
+  std::atomic<uint64_t> m_nShedFilters{0};
+  std::atomic<uint64_t> m_nShedPackets{0};
+
+  // The number of threads waiting in NewPacket for a packet to be released.  Packets only take the
+  // lock to notify m_stateCondition when this is nonzero.
+  std::atomic<size_t> m_nCapWaiters{0};
+
+  // Issued packets in order of issuance, kept only under the RecycleOldest policy
+  std::deque<std::weak_ptr<AutoPacketInternal>> m_inFlightPackets;
+
+  // Per-AutoFilter statistics, created the first time profiling is enabled and retained thereafter
+  bool m_profileFilters = false;
+  std::shared_ptr<autowiring::AutoFilterProfiler> m_filterProfiler;
+
+  // The recorder to which packets log their events, if any
+  std::shared_ptr<autowiring::FlightRecorder> m_flightRecorder;
+
+  // Pools from which decorations are constructed, keyed by decoration type, or nullptr if there are
+  // none.  The map is replaced rather than modified, because packets hold on to the map they were issued with.
+  std::shared_ptr<const autowiring::DecorationPoolMap> m_decorationPools;
+
+  // The number of packets issued by this factory.  This is also the sequence number of the next packet.
   long long m_packetCount = 0;
-  double m_packetDurationSum = 0.0;
-  double m_packetDurationSqSum = 0.0;
+
+  // Recent decorations of every type requested by an auto_prev argument
+  autowiring::DecorationHistory m_history;
+
+  // Histograms of AutoPacket lifespan.  Each thread records to the histogram chosen by its identity, so
+  // that packets finalized on different threads rarely touch the same cache lines.
+  static const size_t sc_nLifetimeShards = 8;
+  std::unique_ptr<autowiring::LatencyHistogram[]> m_packetLifetimes;
 
   // Returns the internal outstanding count, for use with AutoPacket
   std::shared_ptr<void> GetInternalOutstanding(void);
@@ -72,11 +181,19 @@ public:
   /// </returns>
   std::vector<autowiring::AutoFilterDescriptor> GetAutoFilters(void) const;
 
+  /// <returns>
+  /// A version number for the current set of AutoFilters, which changes every time a filter is added or removed
+  /// </returns>
+  size_t GetFilterVersion(void) const;
+
   /// <summary>
-  /// Creates a linked list of saturation counters
+  /// Obtains the packet template for the current set of AutoFilters
   /// </summary>
-  /// <returns>The first element in the list, or nullptr if the list is empty</returns>
-  autowiring::SatCounter* CreateSatCounterList(void) const;
+  /// <remarks>
+  /// The template is compiled the first time it is requested after the set of AutoFilters has changed.
+  /// This method throws an autowiring_error if the AutoFilters do not form a valid graph.
+  /// </remarks>
+  std::shared_ptr<const autowiring::AutoPacketTemplate> GetPacketTemplate(void);
 
   // CoreRunnable overrides:
   bool OnStart(void) override;
@@ -186,6 +303,237 @@ public:
 
   std::shared_ptr<AutoPacketInternal> ConstructPacket(void);
 
+  /// <summary>
+  /// Enables or disables the recycling of packets issued by this factory
+  /// </summary>
+  /// <remarks>
+  /// When pooling is enabled, packets are returned to an internal pool when their last reference is
+  /// released, instead of being destroyed.  A recycled packet keeps its satisfaction graph and the
+  /// storage for its decorations, so reissuing it avoids most of the allocations that are otherwise
+  /// needed to set up a new packet.  The graph is rebuilt if AutoFilters are added to or removed from
+  /// the factory, or if recipients were added to the packet directly.
+  ///
+  /// The change applies to packets constructed after this call.  Pooling is disabled by default.
+  /// </remarks>
+  void SetPacketPooling(bool enabled);
+
+  /// <returns>True if packet pooling is enabled on this factory</returns>
+  bool IsPacketPoolingEnabled(void) const;
+
+  /// <returns>The number of packets currently held in the pool, ready to be reissued</returns>
+  size_t GetPooledPacketCount(void) const { return m_packetPool.GetCached(); }
+
+  /// <summary>
+  /// Enables or disables per-packet arenas for decorations
+  /// </summary>
+  /// <param name="chunkSize">The size of each block of arena memory in bytes, or zero to disable arenas</param>
+  /// <remarks>
+  /// When enabled, decorations created by a packet are constructed in memory carved from blocks that
+  /// belong to the packet, instead of being allocated from the heap one at a time.  The blocks are
+  /// released, or rewound for reuse if packet pooling is enabled, once the packet and all of its
+  /// decorations have been released.  A filter may retain a shared pointer to a decoration beyond the
+  /// lifetime of the packet, in which case the block holding the decoration outlives the packet until
+  /// the decoration is released.  Decorations larger than a quarter of a block are allocated from the
+  /// heap.
+  ///
+  /// The change applies to packets issued after this call.  Arenas are disabled by default.
+  /// </remarks>
+  void SetDecorationArena(size_t chunkSize) { m_arenaChunkSize = chunkSize; }
+
+  /// <returns>The size of each block of decoration arena memory, or zero if arenas are disabled</returns>
+  size_t GetDecorationArenaChunkSize(void) const { return m_arenaChunkSize; }
+
+  /// <summary>
+  /// Sets the thread pool used to run independent AutoFilters concurrently
+  /// </summary>
+  /// <param name="threadPool">The pool to be used, or nullptr to disable parallel execution</param>
+  /// <remarks>
+  /// By default, every AutoFilter is run on the thread whose decoration satisfied it.  When a pool is
+  /// set, AutoFilters that are satisfied at the same time are run concurrently on the pool and on the
+  /// satisfying thread.  AutoFilters of a higher altitude complete before those of a lower altitude
+  /// are started, and rvalue modifiers complete before the decoration they modify is given to anyone
+  /// else.  The decorating call returns once all AutoFilters it satisfied have returned.
+  ///
+  /// If an AutoFilter throws, no AutoFilter which has not yet started is called, just as when the
+  /// AutoFilters are run one at a time.  The exception is rethrown on the decorating thread as soon as
+  /// the AutoFilters already running concurrently have returned; they cannot be interrupted, and they
+  /// may refer to the packet.
+  ///
+  /// AutoFilters that run concurrently must not share unsynchronized state.  The pool must have been
+  /// started for work to be distributed to it; otherwise, the satisfying thread runs every AutoFilter.
+  /// The change applies to packets issued after this call.
+  /// </remarks>
+  void SetFilterThreadPool(std::shared_ptr<autowiring::ThreadPool> threadPool);
+
+  /// <returns>The thread pool used to run independent AutoFilters concurrently, or nullptr if there is none</returns>
+  std::shared_ptr<autowiring::ThreadPool> GetFilterThreadPool(void) const;
+
+  /// <summary>
+  /// Enables or disables the collection of statistics about each AutoFilter
+  /// </summary>
+  /// <remarks>
+  /// When enabled, packets record the time taken by each call to an AutoFilter, and the number of
+  /// packets on which each AutoFilter could not be called.  Statistics are kept per thread and only
+  /// combined when requested, but timing each call is not free, so profiling is disabled by default.
+  ///
+  /// The change applies to packets issued after this call.  Statistics already collected are retained
+  /// when profiling is disabled.
+  /// </remarks>
+  void SetFilterProfiling(bool enabled);
+
+  /// <returns>True if AutoFilter statistics are being collected</returns>
+  bool IsFilterProfilingEnabled(void) const;
+
+  /// <returns>The profiler to which packets record AutoFilter statistics, or nullptr if profiling is disabled</returns>
+  std::shared_ptr<autowiring::AutoFilterProfiler> GetFilterProfiler(void) const;
+
+  /// <returns>
+  /// Statistics for each AutoFilter that has been called or skipped since profiling was first enabled or
+  /// the statistics were last reset
+  /// </returns>
+  std::vector<autowiring::AutoFilterProfile> GetFilterProfiles(void) const;
+
+  /// <summary>
+  /// Discards all AutoFilter statistics collected so far
+  /// </summary>
+  void ResetFilterProfiles(void);
+
+  /// <summary>
+  /// Attaches a flight recorder to which packets log their events, or detaches it if nullptr is passed
+  /// </summary>
+  /// <remarks>
+  /// The change applies to packets issued after this call.  A single recorder may be shared by several
+  /// factories, in which case packets are distinguished only by sequence number.
+  /// </remarks>
+  void SetFlightRecorder(std::shared_ptr<autowiring::FlightRecorder> recorder);
+
+  /// <returns>The flight recorder to which packets log their events, or nullptr if there is none</returns>
+  std::shared_ptr<autowiring::FlightRecorder> GetFlightRecorder(void) const;
+
+  /// <summary>
+  /// Registers, replaces, or removes the pool from which decorations of the specified type are constructed
+  /// </summary>
+  /// <param name="id">The decoration type</param>
+  /// <param name="pool">The pool to be used, or nullptr to remove the pool for this type</param>
+  void SetDecorationPool(auto_id id, std::shared_ptr<autowiring::DecorationPoolBase> pool);
+
+  /// <summary>
+  /// Constructs decorations of type T from the specified pool, rather than allocating each one
+  /// </summary>
+  /// <remarks>
+  /// This is intended for large decorations, such as image buffers, which would otherwise be
+  /// allocated anew for every packet.  T& outputs, auto_out&lt;T&gt; assignments, and decorations
+  /// constructed by Decorate or Emplace from a single T draw their object from the pool.  An object
+  /// returns to the pool once its packet and every filter holding it have released it.  See
+  /// autowiring::DecorationPool for the cases in which the pool is not used.
+  ///
+  /// The change applies to packets issued after this call.
+  /// </remarks>
+  template<class T>
+  void SetDecorationPool(ObjectPool<T>&& pool) {
+    SetDecorationPool(auto_id_t<T>{}, std::make_shared<autowiring::DecorationPool<T>>(std::move(pool)));
+  }
+
+  /// <summary>
+  /// Constructs decorations of type T from a default pool, which has no limit
+  /// </summary>
+  template<class T>
+  void SetDecorationPool(void) {
+    SetDecorationPool(ObjectPool<T>{});
+  }
+
+  /// <summary>
+  /// Stops constructing decorations of type T from a pool
+  /// </summary>
+  /// <remarks>
+  /// Objects issued by the pool to packets already outstanding are freed once they are released.
+  /// </remarks>
+  template<class T>
+  void ClearDecorationPool(void) {
+    SetDecorationPool(auto_id_t<T>{}, nullptr);
+  }
+
+  /// <returns>The pools from which decorations are constructed, or nullptr if there are none</returns>
+  std::shared_ptr<const autowiring::DecorationPoolMap> GetDecorationPools(void) const;
+
+  /// <returns>
+  /// The number of decorations of type T taken from the pool registered for T, and the number which
+  /// were not, or zero for both if there is no such pool
+  /// </returns>
+  template<class T>
+  autowiring::DecorationPoolStatistics GetDecorationPoolStatistics(void) const {
+    auto pools = GetDecorationPools();
+    if (pools) {
+      auto q = pools->find(auto_id_t<T>{});
+      if (q != pools->end())
+        return q->second->GetStatistics();
+    }
+    return autowiring::DecorationPoolStatistics{0, 0};
+  }
+
+  /// <summary>
+  /// Limits the number of packets that may be outstanding at once
+  /// </summary>
+  /// <param name="cap">The most packets that may be outstanding, or zero for no limit</param>
+  /// <param name="policy">The action NewPacket takes when the cap has been reached</param>
+  /// <param name="timeout">The longest NewPacket will wait under the Block policy before throwing</param>
+  /// <remarks>
+  /// A packet is outstanding from the time it is issued by NewPacket until it is released or
+  /// abandoned.  Packets constructed but not yet issued, such as those obtained from Successor, do not
+  /// count against the cap.  Under the RecycleOldest policy, the oldest outstanding packet is abandoned:
+  /// no further AutoFilters are called on it, and it stops counting against the cap.  If none of the
+  /// outstanding packets can be abandoned, for instance because they were issued before the policy was
+  /// selected, NewPacket waits for one to be released as it would under the Block policy.
+  ///
+  /// The cap is disabled by default.
+  /// </remarks>
+  void SetOutstandingPacketCap(size_t cap, CapPolicy policy = CapPolicy::Block, std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max());
+
+  /// <returns>The most packets that may be outstanding at once, or zero if there is no limit</returns>
+  size_t GetOutstandingPacketCap(void) const;
+
+  /// <returns>The number of packets that count against the cap on outstanding packets</returns>
+  size_t GetInFlightPacketCount(void) const { return m_nInFlight; }
+
+  /// <returns>The number of times each cap policy has taken effect</returns>
+  CapStatistics GetCapStatistics(void) const;
+
+  /// <summary>
+  /// Called when an issued packet is finalized or abandoned, to make room for another packet
+  /// </summary>
+  void ReleaseInFlightPacket(void);
+
+  /// <summary>
+  /// Gives every packet issued after this call a deadline of the specified time after its issuance
+  /// </summary>
+  /// <param name="budget">The time each packet is given, or zero for no deadline</param>
+  /// <remarks>
+  /// See AutoPacket::SetDeadline.  A packet's deadline may still be changed after it is issued.
+  /// </remarks>
+  void SetPacketDeadline(std::chrono::nanoseconds budget);
+
+  /// <returns>The deadline given to each packet as measured from its issuance, or zero if there is none</returns>
+  std::chrono::nanoseconds GetPacketDeadline(void) const { return std::chrono::nanoseconds(m_packetDeadline); }
+
+  /// <returns>The amount of work skipped because packet deadlines had passed</returns>
+  ShedStatistics GetShedStatistics(void) const;
+
+  /// <summary>
+  /// Called by a packet when an AutoFilter is skipped because the packet's deadline has passed
+  /// </summary>
+  /// <param name="firstOnPacket">True if this is the first AutoFilter skipped on the packet</param>
+  void RecordShedFilter(bool firstOnPacket);
+
+  /// <summary>
+  /// Called by an issued packet when a decoration that later packets may request is complete
+  /// </summary>
+  /// <param name="sequence">The sequence number of the packet</param>
+  /// <param name="value">The decoration, or nullptr if the packet has none</param>
+  void PublishDecoration(uint64_t sequence, auto_id id, const AnySharedPointer& value);
+
+  /// <returns>The number of prior decorations of the specified type retained for auto_prev arguments</returns>
+  size_t GetDecorationHistoryDepth(auto_id id) { return m_history.GetDepth(id); }
+
   /// <returns>the number of outstanding AutoPackets</returns>
   size_t GetOutstandingPacketCount(void) const;
 
@@ -196,36 +544,61 @@ public:
   /// <param name="duration">
   /// The total lifetime of the AutoPacket that is being Finalized
   /// </param>
+  /// <remarks>
+  /// This method does not lock, and may be called concurrently from any number of threads
+  /// </remarks>
   void RecordPacketDuration(std::chrono::nanoseconds duration);
 
   /// <summary>
   /// Returns the number of packets which have recorded duration statistics
   /// since the most recent statistics reset.
   /// </summary>
-  long long GetTotalPacketCount(void) { return m_packetCount; }
+  long long GetTotalPacketCount(void) const;
+
+  /// <returns>
+  /// A histogram of the lifespans of all AutoPackets since the last statistics reset
+  /// </returns>
+  /// <remarks>
+  /// The returned histogram is a merged copy of those kept by each recording thread.  Packets being
+  /// finalized while the copy is made might not be included.
+  /// </remarks>
+  autowiring::LatencyHistogram GetPacketLifetimes(void) const;
 
   /// <summary>
   /// Returns the mean lifespan of AutoPackets in nanoseconds since the last statistics reset.
   /// </summary>
-  /// <remarks>
-  /// If the factory is left to run for an extended period of time without a reset
-  /// the mean will decrease erroneously due to saturation of the accumulator.
-  /// </remarks>
-  double GetMeanPacketLifetime(void);
+  double GetMeanPacketLifetime(void) const;
 
   /// <summary>
   /// Returns the standard deviation of the lifespans of AutoPackets in nanoseconds since
   /// most recent statistics reset.
   /// </summary>
   /// <remarks>
-  /// If the factory is left to run for an extended period of time without a reset
-  /// the standard deviation will behave erraticly due to saturation of the accumulators.
+  /// Each lifespan is only known to within the precision of the histogram that holds it, so the
+  /// standard deviation is an estimate.
   /// </remarks>
-  double GetPacketLifetimeStandardDeviation(void);
+  double GetPacketLifetimeStandardDeviation(void) const;
+
+  /// <returns>
+  /// The lifespan which the specified percentage of AutoPackets did not exceed since the last statistics reset
+  /// </returns>
+  /// <param name="percentile">The percentage of interest, in the range [0, 100]</param>
+  std::chrono::nanoseconds GetPacketLifetimePercentile(double percentile) const;
+
+  /// <returns>The median, 99th and 99.9th percentile AutoPacket lifespans</returns>
+  std::chrono::nanoseconds GetMedianPacketLifetime(void) const { return GetPacketLifetimePercentile(50.0); }
+  std::chrono::nanoseconds GetP99PacketLifetime(void) const { return GetPacketLifetimePercentile(99.0); }
+  std::chrono::nanoseconds GetP999PacketLifetime(void) const { return GetPacketLifetimePercentile(99.9); }
+
+  /// <returns>The longest AutoPacket lifespan since the last statistics reset</returns>
+  std::chrono::nanoseconds GetMaxPacketLifetime(void) const;
 
   /// <summary>
   /// Resets the statistics accumulators stored by the AutoPacketFactory.
   /// </summary>
+  /// <remarks>
+  /// This method does not lock, packets may continue to be issued and finalized while it runs
+  /// </remarks>
   void ResetPacketStatistics(void);
 };
 
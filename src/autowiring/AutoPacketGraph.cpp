@@ -56,11 +56,11 @@ void AutoPacketGraph::LoadEdges() {
 }
 
 void AutoPacketGraph::RecordDelivery(auto_id id, const AutoFilterDescriptor& descriptor, DeliveryEdge::ArgType arg_type) {
-  DeliveryEdge edge { id, descriptor, arg_type };
-
-  auto itr = m_deliveryGraph.find(edge);
-  assert(itr != m_deliveryGraph.end());
-  itr->second++;
+  // Edges are loaded whenever an object is added, only an edge to a filter that is not a context
+  // member, such as a lambda added to a single packet, can be missing
+  auto itr = m_deliveryGraph.find(DeliveryEdge{ id, descriptor, arg_type });
+  if (itr != m_deliveryGraph.end())
+    itr->second++;
 }
 
 bool AutoPacketGraph::OnStart(void) {
@@ -70,9 +70,9 @@ bool AutoPacketGraph::OnStart(void) {
 
 void AutoPacketGraph::AutoFilter(AutoPacket& packet) {
   packet.AddTeardownListener([this, &packet] () {
-    for (auto& cur : packet.GetDecorations()) {
-      auto& decoration = cur.second;
-      auto type = cur.first.id;
+    std::lock_guard<std::mutex> lk(m_lock);
+    packet.ForEachDecoration([this] (const DecorationKey& key, const DecorationDisposition& decoration) {
+      auto type = key.id;
 
       for (auto& modifier : decoration.m_modifiers)
         if (modifier.satCounter && !modifier.satCounter->remaining)
@@ -84,14 +84,13 @@ void AutoPacketGraph::AutoFilter(AutoPacket& packet) {
 
       for (auto& subscriber : decoration.m_subscribers) {
         // Skip the AutoPacketGraph
-        auto_id descType = m_factory->GetContext()->GetAutoTypeId(subscriber.satCounter->GetAutoFilter());
-        if (descType == auto_id_t<AutoPacketGraph>{})
+        if (subscriber.satCounter->GetAutoFilter().ptr() == this)
           continue;
 
         if (!subscriber.satCounter->remaining)
           RecordDelivery(type, *subscriber.satCounter, DeliveryEdge::ArgType::Input);
       }
-    }
+    });
   });
 }
 
@@ -84,6 +84,9 @@ protected:
   /// <summary>
   /// Record the delivery of a packet and increment the number of times the packet has been delivered
   /// </summary>
+  /// <remarks>
+  /// The caller must hold m_lock
+  /// </remarks>
   void RecordDelivery(auto_id id, const autowiring::AutoFilterDescriptor& descriptor, DeliveryEdge::ArgType arg_type);
 
   void NewObject(CoreContext&, const autowiring::CoreObjectDescriptor&);
@@ -1,8 +1,9 @@
 // Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
 #include "stdafx.h"
-#include "AutoCurrentPacketPusher.h"
 #include "AutoPacketInternal.hpp"
 #include "AutoPacketFactory.h"
+#include "AutoPacketTemplate.h"
+#include "FlightRecorder.h"
 #include "SatCounter.h"
 #include <algorithm>
 
@@ -14,43 +15,148 @@ AutoPacketInternal::AutoPacketInternal(AutoPacketFactory& factory, std::shared_p
 
 AutoPacketInternal::~AutoPacketInternal(void) {}
 
-void AutoPacketInternal::Initialize(bool isFirstPacket) {
+void AutoPacketInternal::Initialize(uint64_t sequence, const std::shared_ptr<const AutoPacketTemplate>& packetTemplate) {
+  m_sequence = sequence;
+
   // Mark init time of packet
   this->m_initTime = std::chrono::high_resolution_clock::now();
 
-  // Traverse all descendant contexts, adding their packet subscriber vectors one at a time:
-  m_firstCounter = m_parentFactory->CreateSatCounterList();
+  size_t filterVersion = packetTemplate->GetVersion();
+  m_threadPool = m_parentFactory->GetFilterThreadPool();
+  m_filterProfiler = m_parentFactory->GetFilterProfiler();
+  m_flightRecorder = m_parentFactory->GetFlightRecorder();
+  m_decorationPools = m_parentFactory->GetDecorationPools();
+  auto budget = m_parentFactory->GetPacketDeadline();
+  if (budget != std::chrono::nanoseconds::zero())
+    SetDeadline(budget);
+  if (m_flightRecorder)
+    m_flightRecorder->Record(FlightEvent::Type::PacketIssued, sequence);
+
+  // A retained arena is only reused if its chunk size is still current
+  size_t arenaChunkSize = m_parentFactory->GetDecorationArenaChunkSize();
+  if (!arenaChunkSize)
+    m_arena.reset();
+  else if (!m_arena || m_arena->GetChunkSize() != arenaChunkSize)
+    m_arena.reset(new DecorationArena(arenaChunkSize));
+
+  // Copy the counters before taking the lock, unless they can be reused
+  std::unique_ptr<SatCounter[]> counters;
+  if (m_filterVersion != filterVersion)
+    counters = packetTemplate->CloneCounters();
 
   // Find all subscribers with no required or optional arguments:
   std::vector<SatCounter*> callCounters;
 
   {
     std::lock_guard<std::mutex> lk(m_lock);
+    m_initialized = true;
+
+    if (m_filterVersion != filterVersion) {
+      // Any stale graph from a prior issuance must be discarded first
+      ReleaseSatCountersUnsafe();
+      m_templateCounters = std::move(counters);
+      m_nTemplateCounters = packetTemplate->GetCounterCount();
+      m_firstCounter = m_templateCounters.get();
+      m_filterVersion = filterVersion;
+      m_packetTemplate = packetTemplate;
+      packetTemplate->Wire(m_slots, m_firstCounter, m_templateBindings);
+
+      // Decorations attached before issuance move into the slots assigned to them
+      for (auto q = m_decoration_map.begin(); q != m_decoration_map.end();) {
+        int slot = packetTemplate->FindSlot(q->first);
+        if (slot < 0) {
+          ++q;
+          continue;
+        }
+
+        DecorationDisposition& disposition = m_slots[slot];
+        disposition.m_nProducersRun = q->second.m_nProducersRun;
+        disposition.m_decorations = std::move(q->second.m_decorations);
+        disposition.m_pImmediate = q->second.m_pImmediate;
+        disposition.m_state = q->second.m_state;
+        q = m_decoration_map.erase(q);
+      }
+    }
+
     for (auto* satCounter = m_firstCounter; satCounter; satCounter = satCounter->flink) {
       // Prime the satisfaction graph for element:
-      AddSatCounterUnsafe(*satCounter);
+      satCounter->Reset();
+      PrimeSatCounterUnsafe(*satCounter);
       if (!satCounter->remaining)
         callCounters.push_back(satCounter);
     }
   }
 
-  // Mark timeshifted decorations as unsatisfiable on the first packet
-  if (isFirstPacket)
-    for (auto& dec : m_decoration_map) {
-      auto& key = dec.first;
-      if (key.tshift) {
-        MarkUnsatisfiable(key);
-        MarkSuccessorsUnsatisfiable(key);
-      }
-    }
+  // Decorations completed before issuance could not be published until now
+  PublishHistory(false);
 
   // Call all subscribers with no required or optional arguments:
   // NOTE: This may result in decorations that cause other subscribers to be called.
+  CallSatCounters(callCounters);
+}
+
+void AutoPacketInternal::Abandon(void) {
+  m_abandoned = true;
+  if (m_inFlight.exchange(false))
+    m_parentFactory->ReleaseInFlightPacket();
+}
+
+void AutoPacketInternal::Shed(const AutoFilterArgument* args) {
+  m_parentFactory->RecordShedFilter(!m_shed.exchange(true));
+
+  for (; *args; args++)
+    if (args->is_output)
+      SkipProducer(DecorationKey(args->id, 0));
+}
+
+void AutoPacketInternal::Reissue(AutoPacketFactory& factory, std::shared_ptr<void>&& outstanding) {
+  m_parentFactory = std::static_pointer_cast<AutoPacketFactory>(factory.shared_from_this());
+  m_outstanding = std::move(outstanding);
+}
+
+void AutoPacketInternal::Recycle(void) {
+  Finalize();
+
+  // Obtained outside of our lock, the factory lock must never be acquired while holding ours
+  size_t filterVersion = m_parentFactory->GetFilterVersion();
+
   {
-    autowiring::AutoCurrentPacketPusher pkt(*this);
-    for (SatCounter* call : callCounters)
-      call->GetCall()(call->GetAutoFilter().ptr(), *this);
+    std::lock_guard<std::mutex> lk(m_lock);
+    m_successor.reset();
+    m_initialized = false;
+    m_abandoned = false;
+    m_deadline = 0;
+    m_shed = false;
+
+    if (m_filterVersion && m_filterVersion == filterVersion)
+      // Graph may be reused, only the decorations need to go
+      for (auto& disposition : m_slots)
+        disposition.Reset();
+    else
+      ReleaseSatCountersUnsafe();
+
+    // Everything outside of the slots was specific to the prior issuance
+    m_decoration_map.clear();
   }
+
+  // All decorations are gone, arena space not still held by a filter may be reused
+  if (m_arena)
+    m_arena->Reset();
+
+  // Factory reference must be released last, this may be the final reference to it
+  m_threadPool.reset();
+  m_filterProfiler.reset();
+  m_flightRecorder.reset();
+  m_decorationPools.reset();
+  m_outstanding.reset();
+  m_parentFactory.reset();
+}
+
+void AutoPacketInternal::DecoratePrior(const DecorationKey& key, const AnySharedPointer& value) {
+  if (value)
+    DecorateNoPriors(value, key);
+  else
+    MarkUnsatisfiable(key);
 }
 
 std::shared_ptr<AutoPacketInternal> AutoPacketInternal::SuccessorInternal(void) {
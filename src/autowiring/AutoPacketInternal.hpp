@@ -21,10 +21,61 @@ public:
   /// It is not called when the Packet is created since that could result in
   /// spurious calls when no packet is issued.
   /// </remarks>
-  void Initialize(bool isFirstPacket);
+  /// <param name="sequence">The position of this packet in the order of issuance by its factory</param>
+  /// <param name="packetTemplate">The template from which this packet is to be wired</param>
+  void Initialize(uint64_t sequence, const std::shared_ptr<const autowiring::AutoPacketTemplate>& packetTemplate);
 
   /// <summary>
-  ///
+  /// Attaches a pooled packet to the specified factory prior to its issuance
+  /// </summary>
+  /// <remarks>
+  /// Called by the packet pool of the factory whenever this packet is obtained from the pool
+  /// </remarks>
+  void Reissue(AutoPacketFactory& factory, std::shared_ptr<void>&& outstanding);
+
+  /// <summary>
+  /// Finalizes this packet and returns it to a dormant state, ready to be reissued
+  /// </summary>
+  /// <remarks>
+  /// The satisfaction graph of this packet is retained if the filter set of the factory has not
+  /// changed since it was built, and all decorations are released.  The references held to the
+  /// factory and to its outstanding counter are also released.
+  /// </remarks>
+  void Recycle(void);
+
+  /// <summary>
+  /// Stops any more AutoFilters from being called on this packet, and releases its place under the
+  /// factory's cap on outstanding packets
+  /// </summary>
+  void Abandon(void);
+
+  /// <summary>
+  /// Counts this packet against the factory's cap on outstanding packets
+  /// </summary>
+  /// <remarks>
+  /// Called by the factory under its lock as the packet is issued, so that the packet is counted before
+  /// anyone else can abandon it
+  /// </remarks>
+  void MarkInFlight(void) { m_inFlight = true; }
+
+  /// <summary>
+  /// Skips the specified AutoFilter because this packet's deadline has passed
+  /// </summary>
+  /// <remarks>
+  /// Each output of the filter is treated as though the filter had run without producing it
+  /// </remarks>
+  void Shed(const autowiring::AutoFilterArgument* args);
+
+  /// <summary>
+  /// Attaches a decoration published by a prior packet, or marks it unsatisfiable if the value is null
+  /// </summary>
+  /// <remarks>
+  /// Called by the decoration history of the factory
+  /// </remarks>
+  void DecoratePrior(const autowiring::DecorationKey& key, const AnySharedPointer& value);
+
+  /// <summary>
+  /// Identical to Successor, but returns the internal packet type
   /// </summary>
   std::shared_ptr<AutoPacketInternal> SuccessorInternal(void);
 };
@@ -0,0 +1,238 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#include "stdafx.h"
+#include "AutoPacketTemplate.h"
+#include "autowiring_error.h"
+#include "demangle.h"
+#include "SatCounter.h"
+#include <sstream>
+
+using namespace autowiring;
+
+AutoPacketTemplate::AutoPacketTemplate(size_t version, const std::vector<AutoFilterDescriptor>& filters) :
+  m_version(version),
+  m_nCounters(filters.size())
+{
+  if (!m_nCounters)
+    return;
+
+  m_counters.reset(new SatCounter[m_nCounters]);
+  for (size_t i = 0; i < m_nCounters; i++) {
+    m_counters[i] = SatCounter(filters[i]);
+    if (i) {
+      m_counters[i].blink = &m_counters[i - 1];
+      m_counters[i - 1].flink = &m_counters[i];
+    }
+  }
+
+  AutoPacket::t_decorationMap decorations;
+  t_dispositionAccessor accessor = [&decorations](const DecorationKey& key) -> DecorationDisposition& {
+    return decorations[key];
+  };
+  for (size_t i = 0; i < m_nCounters; i++)
+    AddSatCounter(accessor, m_counters[i]);
+
+  // Validate the graph as a whole, permanently visited counters need not be revisited
+  std::unordered_set<SatCounter*> tempVisited;
+  std::unordered_set<SatCounter*> permVisited;
+  for (size_t i = 0; i < m_nCounters; i++)
+    DetectCycle(accessor, m_counters[i], tempVisited, permVisited);
+
+  // Find the number of time shifts present for each type.  AddSatCounter guarantees that all time
+  // shifts below the largest one named for a type are also present.
+  std::unordered_map<auto_id, int> counts;
+  for (const auto& entry : decorations) {
+    int& count = counts[entry.first.id];
+    if (count <= entry.first.tshift)
+      count = entry.first.tshift + 1;
+  }
+
+  // Lay out slots, consecutive for each type:
+  m_keys.reserve(decorations.size());
+  m_dispositions.reserve(decorations.size());
+  for (const auto& count : counts) {
+    const int index = count.first.block->index;
+    if (m_slotIndex.size() <= static_cast<size_t>(index))
+      m_slotIndex.resize(index + 1);
+    m_slotIndex[index].first = static_cast<int>(m_keys.size());
+    m_slotIndex[index].count = count.second;
+    if (count.second > 1)
+      m_timeShifted.push_back(count);
+
+    for (int tshift = 0; tshift < count.second; tshift++) {
+      DecorationKey key(count.first, tshift);
+      m_keys.push_back(key);
+      m_dispositions.push_back(std::move(decorations[key]));
+    }
+  }
+
+  // Inputs are bound to their slots now, so that packets need not find them on every call
+  for (size_t i = 0; i < m_nCounters; i++) {
+    const AutoFilterArgument* args = m_counters[i].GetAutoFilterArguments();
+    for (size_t j = 0; j < m_counters[i].GetArity(); j++)
+      m_argumentSlots.push_back(args[j].is_input ? FindSlot(DecorationKey(args[j].id, args[j].tshift)) : -1);
+  }
+}
+
+AutoPacketTemplate::~AutoPacketTemplate(void) {}
+
+std::unique_ptr<SatCounter[]> AutoPacketTemplate::CloneCounters(void) const {
+  if (!m_nCounters)
+    return nullptr;
+
+  // The AutoFilters are held by our own counters, and packets hold this template for as long as they
+  // use the clones, so clones need not hold the AutoFilters themselves
+  std::unique_ptr<SatCounter[]> retVal(new SatCounter[m_nCounters]);
+  SatCounter* base = retVal.get();
+  for (size_t i = 0; i < m_nCounters; i++) {
+    retVal[i].AssignUnowned(m_counters[i]);
+    retVal[i].flink = i + 1 < m_nCounters ? base + i + 1 : nullptr;
+    retVal[i].blink = i ? base + i - 1 : nullptr;
+  }
+  return retVal;
+}
+
+void AutoPacketTemplate::Wire(std::vector<DecorationDisposition>& slots, SatCounter* counters, std::unique_ptr<const DecorationDisposition*[]>& bindings) const {
+  // Counters were cloned from our own block, so each pointer may be rebased by its offset
+  auto rebase = [this, counters](SatCounter* satCounter) {
+    return counters + (satCounter - m_counters.get());
+  };
+
+  // Each slot is assigned and rebased in a single pass, rather than copying all of the dispositions and
+  // then visiting them again
+  slots.resize(m_dispositions.size());
+  for (size_t i = 0; i < slots.size(); i++) {
+    const DecorationDisposition& src = m_dispositions[i];
+    DecorationDisposition& dest = slots[i];
+    dest.m_nProducersRun = src.m_nProducersRun;
+    dest.m_decorations = src.m_decorations;
+    dest.m_pImmediate = src.m_pImmediate;
+    dest.m_state = src.m_state;
+
+    dest.m_publishers.resize(src.m_publishers.size());
+    for (size_t j = 0; j < src.m_publishers.size(); j++)
+      dest.m_publishers[j] = rebase(src.m_publishers[j]);
+
+    dest.m_subscribers.resize(src.m_subscribers.size());
+    for (size_t j = 0; j < src.m_subscribers.size(); j++) {
+      dest.m_subscribers[j] = src.m_subscribers[j];
+      dest.m_subscribers[j].satCounter = rebase(src.m_subscribers[j].satCounter);
+    }
+
+    dest.m_modifiers.resize(src.m_modifiers.size());
+    for (size_t j = 0; j < src.m_modifiers.size(); j++) {
+      dest.m_modifiers[j] = src.m_modifiers[j];
+      dest.m_modifiers[j].satCounter = rebase(src.m_modifiers[j].satCounter);
+    }
+  }
+
+  bindings.reset(m_argumentSlots.empty() ? nullptr : new const DecorationDisposition*[m_argumentSlots.size()]);
+  for (size_t i = 0; i < m_argumentSlots.size(); i++)
+    bindings[i] = m_argumentSlots[i] < 0 ? nullptr : &slots[m_argumentSlots[i]];
+
+  const DecorationDisposition* const* binding = bindings.get();
+  for (size_t i = 0; i < m_nCounters; i++) {
+    counters[i].dispositions = binding;
+    binding += counters[i].GetArity();
+  }
+}
+
+void AutoPacketTemplate::AddSatCounter(const t_dispositionAccessor& dispositions, SatCounter& satCounter) {
+  for(auto pCur = satCounter.GetAutoFilterArguments(); *pCur; pCur++) {
+    // Make sure decorations exist for timeshifts less that key's timeshift
+    DecorationKey key(pCur->id, pCur->tshift);
+    for (int tshift = 0; tshift < key.tshift; ++tshift)
+      dispositions(DecorationKey(key.id, tshift));
+    DecorationDisposition& entry = dispositions(key);
+
+    // Decide what to do with this entry:
+    if (pCur->is_input && entry.m_publishers.size() > 1 && !pCur->is_multi) {
+      std::stringstream ss;
+      ss << "Cannot add listener for multi-broadcast type " << demangle(pCur->id);
+      throw autowiring_error(ss.str());
+    }
+
+    if (pCur->is_rvalue) {
+      // Throw exception when there is already a modifier with the same altitude,
+      // otherwise insert it to the right position so that the modifiers vector is sorted by altitude
+      auto it = entry.m_modifiers.begin();
+      while (it != entry.m_modifiers.end()) {
+        if (it->altitude == satCounter.GetAltitude()) {
+          std::stringstream ss;
+          ss << "Added multiple rvalue decorations with same altitudes for type " << demangle(pCur->id);
+          throw autowiring_error(ss.str());
+        }
+
+        if (it->altitude < satCounter.GetAltitude())
+          break;
+        it++;
+      }
+      entry.m_modifiers.emplace(it, pCur->is_shared, satCounter.GetAltitude(), &satCounter);
+    } else {
+      if (pCur->is_input) {
+        entry.AddSubscriber({
+          pCur->is_shared,
+          pCur->is_multi ?
+          DecorationDisposition::Subscriber::Type::Multi :
+          pCur->is_shared ?
+          DecorationDisposition::Subscriber::Type::Optional :
+          DecorationDisposition::Subscriber::Type::Normal,
+          satCounter.GetAltitude(),
+          &satCounter
+        });
+      }
+
+      if (pCur->is_output) {
+        if (!entry.m_publishers.empty()) {
+          for (const auto& subscriber : entry.m_subscribers) {
+            for (auto pOther = subscriber.satCounter->GetAutoFilterArguments(); *pOther; pOther++) {
+              if (pOther->id == pCur->id && !pOther->is_multi) {
+                std::stringstream ss;
+                ss << "Added identical data broadcasts of type " << demangle(pCur->id) << " with existing subscriber.";
+                throw autowiring_error(ss.str());
+              }
+            }
+          }
+
+          if (!entry.m_modifiers.empty()) {
+            std::stringstream ss;
+            ss << "Added identical data broadcasts of type " << demangle(pCur->id) << " with existing modifier.";
+            throw autowiring_error(ss.str());
+          }
+        }
+        entry.m_publishers.push_back(&satCounter);
+      }
+    }
+  }
+}
+
+void AutoPacketTemplate::DetectCycle(const t_dispositionAccessor& dispositions, SatCounter& satCounter, std::unordered_set<SatCounter*>& tempVisited, std::unordered_set<SatCounter*>& permVisited) {
+  if (tempVisited.count(&satCounter)) {
+    std::stringstream ss;
+    ss << "Detected cycle in the auto filter graph involving type " << demangle(satCounter.GetType());
+    throw autowiring_error(ss.str());
+  }
+
+  if (permVisited.count(&satCounter))
+    return;
+
+  std::unordered_set<SatCounter*> nextCounters;
+  for(auto pCur = satCounter.GetAutoFilterArguments(); *pCur; pCur++) {
+    if (!pCur->is_output) continue;
+
+    DecorationKey key(pCur->id, pCur->tshift);
+    DecorationDisposition& entry = dispositions(key);
+    for (auto& subscriber : entry.m_subscribers) {
+      auto ptr = subscriber.satCounter;
+      nextCounters.insert(ptr);
+    }
+  }
+  if (nextCounters.empty())
+    return;
+
+  tempVisited.insert(&satCounter);
+  for (auto pCounter : nextCounters) {
+    DetectCycle(dispositions, *pCounter, tempVisited, permVisited);
+  }
+  permVisited.insert(&satCounter);
+  tempVisited.erase(&satCounter);
+}
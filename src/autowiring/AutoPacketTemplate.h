@@ -0,0 +1,143 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#pragma once
+#include "AutoPacket.h"
+#include "AutoFilterDescriptor.h"
+#include <unordered_set>
+#include FUNCTIONAL_HEADER
+#include MEMORY_HEADER
+#include <vector>
+
+namespace autowiring {
+
+struct SatCounter;
+
+/// <summary>
+/// An immutable, precompiled satisfaction graph for the AutoFilters registered on a packet factory
+/// </summary>
+/// <remarks>
+/// The factory compiles a template once each time its set of AutoFilters changes.  All of the graph
+/// validation work, such as altitude ordering, broadcast checks, and cycle detection, is performed
+/// when the template is compiled.  Packets are then wired by copying the counters and dispositions
+/// held here, which does not require any further validation.
+///
+/// Each decoration named by the graph is assigned a fixed slot.  All time shifts of a type occupy
+/// consecutive slots, and the first slot of each type is found by indexing a table with the dense
+/// auto_id_block::index of that type, so no hashing is required to find a disposition.
+/// </remarks>
+class AutoPacketTemplate
+{
+public:
+  /// <summary>
+  /// Compiles a template from the specified AutoFilters
+  /// </summary>
+  /// <param name="version">The filter set version of the factory at the time of compilation</param>
+  /// <param name="filters">The AutoFilters, in the order they are to be linked</param>
+  /// <remarks>
+  /// This constructor throws an autowiring_error if the AutoFilters do not form a valid graph
+  /// </remarks>
+  AutoPacketTemplate(size_t version, const std::vector<AutoFilterDescriptor>& filters);
+  ~AutoPacketTemplate(void);
+
+  // Used to obtain, and create if necessary, the disposition for a key during wiring
+  typedef std::function<DecorationDisposition&(const DecorationKey&)> t_dispositionAccessor;
+
+private:
+  // The filter set version this template was compiled from
+  const size_t m_version;
+
+  // Saturation counters, stored contiguously and linked in order
+  size_t m_nCounters;
+  std::unique_ptr<SatCounter[]> m_counters;
+
+  // The keys and wired dispositions of all decorations named by the counters, in slot order
+  std::vector<DecorationKey> m_keys;
+  std::vector<DecorationDisposition> m_dispositions;
+
+  // Slots assigned to each type, indexed by auto_id_block::index
+  struct SlotRange {
+    // The slot of the decoration with a time shift of zero, or -1 if the type has no slots.  Zero is a
+    // valid slot, so it cannot double as the mark of an unassigned range.
+    int first = -1;
+
+    // The number of consecutive time shifts held by this type
+    int count = 0;
+  };
+  std::vector<SlotRange> m_slotIndex;
+
+  // Types named with a nonzero time shift, each paired with the number of consecutive time shifts it holds
+  std::vector<std::pair<auto_id, int>> m_timeShifted;
+
+  // The slot of each argument of each counter, in counter and then argument order, or -1 for
+  // arguments which are not inputs
+  std::vector<int> m_argumentSlots;
+
+public:
+  // Accessor methods:
+  size_t GetVersion(void) const { return m_version; }
+  size_t GetCounterCount(void) const { return m_nCounters; }
+  size_t GetSlotCount(void) const { return m_keys.size(); }
+  const DecorationKey& GetKey(size_t slot) const { return m_keys[slot]; }
+  const std::vector<std::pair<auto_id, int>>& GetTimeShiftedTypes(void) const { return m_timeShifted; }
+
+  /// <returns>The number of consecutive time shifts held by the specified type, or zero if the type has no slots</returns>
+  int GetShiftCount(auto_id id) const {
+    const int index = id.block->index;
+    if (index <= 0 || static_cast<size_t>(index) >= m_slotIndex.size())
+      return 0;
+
+    const SlotRange& range = m_slotIndex[index];
+    if (range.first < 0 || m_keys[range.first].id != id)
+      return 0;
+    return range.count;
+  }
+
+  /// <returns>The slot assigned to the specified key, or -1 if the key has no slot</returns>
+  int FindSlot(const DecorationKey& key) const {
+    const int index = key.id.block->index;
+    if (index <= 0 || static_cast<size_t>(index) >= m_slotIndex.size())
+      return -1;
+
+    const SlotRange& range = m_slotIndex[index];
+    if (range.first < 0 || key.tshift < 0 || range.count <= key.tshift || m_keys[range.first].id != key.id)
+      return -1;
+    return range.first + key.tshift;
+  }
+
+  /// <summary>
+  /// Copies the saturation counters of this template into a newly allocated block
+  /// </summary>
+  /// <returns>The copied counters, or nullptr if this template has no counters</returns>
+  /// <remarks>
+  /// The copies do not own their AutoFilters, so copying costs no reference count traffic.  Each
+  /// AutoFilter is kept alive by this template, which must outlive the copies.
+  /// </remarks>
+  std::unique_ptr<SatCounter[]> CloneCounters(void) const;
+
+  /// <summary>
+  /// Initializes the specified slots with dispositions wired to a block of counters obtained from CloneCounters
+  /// </summary>
+  /// <param name="bindings">Receives the input dispositions of every counter, which the counters refer to</param>
+  /// <remarks>
+  /// Any prior content of the slots is replaced.  Slots are rebuilt in place, so the storage of any
+  /// slots already present is reused.  Each counter is bound to the slots of its inputs, so that its
+  /// AutoFilter may be called without looking up its arguments.  The bindings are valid for as long as
+  /// the slots are neither reassigned nor resized.
+  /// </remarks>
+  void Wire(std::vector<DecorationDisposition>& slots, SatCounter* counters, std::unique_ptr<const DecorationDisposition*[]>& bindings) const;
+
+  /// <summary>
+  /// Adds all AutoFilter argument information for a counter to the dispositions it names
+  /// </summary>
+  /// <remarks>
+  /// This method validates the new argument information against what is already present, and will
+  /// throw an autowiring_error if the counter cannot be added.  It does not check for cycles.
+  /// </remarks>
+  static void AddSatCounter(const t_dispositionAccessor& dispositions, SatCounter& satCounter);
+
+  /// <summary>
+  /// Detects a cycle in the AutoFilter graph reachable from the specified counter using DFS
+  /// </summary>
+  static void DetectCycle(const t_dispositionAccessor& dispositions, SatCounter& satCounter, std::unordered_set<SatCounter*>& tempVisited, std::unordered_set<SatCounter*>& permVisited);
+};
+
+}
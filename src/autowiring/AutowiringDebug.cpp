@@ -2,6 +2,7 @@
 #include "stdafx.h"
 #include "AutowiringDebug.h"
 #include "Autowired.h"
+#include "AutoFilterCriticalPath.h"
 #include "AutoPacketFactory.h"
 #include "demangle.h"
 #include <algorithm>
@@ -304,9 +305,87 @@ void autowiring::dbg::WriteAutoFilterGraph(std::ostream& os, CoreContext& ctxt)
   }
 }
 
+void autowiring::dbg::WriteAutoFilterProfile(std::ostream& os) {
+  WriteAutoFilterProfile(os, *AutoCurrentContext());
+}
+
+std::string autowiring::dbg::AutoFilterProfileStr(void) {
+  std::stringstream ss;
+  WriteAutoFilterProfile(ss);
+  return ss.str();
+}
+
+void autowiring::dbg::WriteAutoFilterProfile(std::ostream& os, CoreContext& ctxt) {
+  AutowiredFast<AutoPacketFactory> factory(&ctxt);
+  if (!factory)
+    return;
+
+  // Durations are reported in microseconds
+  auto us = [] (std::chrono::nanoseconds duration) {
+    return duration.count() / 1000.0;
+  };
+
+  os << std::left << std::setw(40) << "AutoFilter" << std::right
+     << std::setw(12) << "calls"
+     << std::setw(12) << "skipped"
+     << std::setw(12) << "mean(us)"
+     << std::setw(12) << "p50(us)"
+     << std::setw(12) << "p99(us)"
+     << std::setw(12) << "max(us)" << std::endl;
+
+  for (const auto& profile : factory->GetFilterProfiles())
+    os << std::left << std::setw(40) << DemangleWithAutoID(profile.descriptor.GetType()) << std::right
+       << std::setw(12) << profile.GetCallCount()
+       << std::setw(12) << profile.nSkipped
+       << std::setw(12) << us(profile.latency.GetMean())
+       << std::setw(12) << us(profile.latency.GetPercentile(50))
+       << std::setw(12) << us(profile.latency.GetPercentile(99))
+       << std::setw(12) << us(profile.latency.GetMax()) << std::endl;
+}
+
+void autowiring::dbg::WriteCriticalPath(std::ostream& os) {
+  WriteCriticalPath(os, *AutoCurrentContext());
+}
+
+std::string autowiring::dbg::CriticalPathStr(void) {
+  std::stringstream ss;
+  WriteCriticalPath(ss);
+  return ss.str();
+}
+
+void autowiring::dbg::WriteCriticalPath(std::ostream& os, CoreContext& ctxt) {
+  AutowiredFast<AutoPacketFactory> factory(&ctxt);
+
+  // If no factory, this is an empty network
+  if (!factory) {
+    AutoFilterCriticalPath({}, {}).Write(os);
+    return;
+  }
+
+  AutoFilterCriticalPath(factory->GetAutoFilters(), factory->GetFilterProfiles()).Write(os);
+}
+
+void autowiring::dbg::WriteCriticalPathGraph(std::ostream& os) {
+  WriteCriticalPathGraph(os, *AutoCurrentContext());
+}
+
+void autowiring::dbg::WriteCriticalPathGraph(std::ostream& os, CoreContext& ctxt) {
+  AutowiredFast<AutoPacketFactory> factory(&ctxt);
+
+  // If no factory, this is an empty network
+  if (!factory) {
+    AutoFilterCriticalPath({}, {}).WriteGV(os);
+    return;
+  }
+
+  AutoFilterCriticalPath(factory->GetAutoFilters(), factory->GetFilterProfiles()).WriteGV(os);
+}
+
 void autowiring::dbg::DebugInit(void) {
   static const void* p [] = {
-    (void*) AutoFilterGraphStr
+    (void*) AutoFilterGraphStr,
+    (void*) AutoFilterProfileStr,
+    (void*) CriticalPathStr
   };
   (void)p;
 }
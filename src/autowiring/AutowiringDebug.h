@@ -66,6 +66,41 @@ namespace autowiring {
     void WriteAutoFilterGraph(std::ostream& os, const std::shared_ptr<CoreContext>& ctxt);
     void WriteAutoFilterGraph(std::ostream& os, CoreContext& ctxt);
 
+    /// <summary>
+    /// Write a table of the statistics collected for each AutoFilter
+    /// </summary>
+    /// <param name="ctxt">Context whose AutoPacketFactory is to be examined. Defaults to AutoCurrentContext</param>
+    /// <param name="os">output stream to write the table</param>
+    /// <returns> string representation of the table, or outputs to 'os' </returns>
+    /// <remarks>
+    /// Statistics are only collected once AutoPacketFactory::SetFilterProfiling has been called
+    /// </remarks>
+    std::string AutoFilterProfileStr(void);
+    void WriteAutoFilterProfile(std::ostream& os);
+    void WriteAutoFilterProfile(std::ostream& os, CoreContext& ctxt);
+
+    /// <summary>
+    /// Write the critical path through the AutoFilter network and the slack of each AutoFilter
+    /// </summary>
+    /// <param name="ctxt">Context whose AutoPacketFactory is to be examined. Defaults to AutoCurrentContext</param>
+    /// <param name="os">output stream to write the report</param>
+    /// <returns> string representation of the report, or outputs to 'os' </returns>
+    /// <remarks>
+    /// AutoFilters are weighted by their mean latency, and so this report is only meaningful once
+    /// AutoPacketFactory::SetFilterProfiling has been called and packets have been processed
+    /// </remarks>
+    std::string CriticalPathStr(void);
+    void WriteCriticalPath(std::ostream& os);
+    void WriteCriticalPath(std::ostream& os, CoreContext& ctxt);
+
+    /// <summary>
+    /// Write a DOT file representing the AutoFilter network annotated with latency and slack
+    /// </summary>
+    /// <param name="ctxt">Context whose AutoPacketFactory is to be examined. Defaults to AutoCurrentContext</param>
+    /// <param name="os">output stream to write DOT file</param>
+    void WriteCriticalPathGraph(std::ostream& os);
+    void WriteCriticalPathGraph(std::ostream& os, CoreContext& ctxt);
+
     /// <summary>
     /// Initializes the Autowiring debug library
     /// </summary>
@@ -0,0 +1,149 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#pragma once
+#include "auto_out.h"
+#include "CoreThread.h"
+#include "CurrentContextPusher.h"
+#include "Deferred.h"
+#include "dispatch_aborted_exception.h"
+#include <atomic>
+#include CHRONO_HEADER
+#include <vector>
+
+namespace autowiring {
+
+/// <summary>
+/// Base class for AutoFilters which process the inputs of many packets in a single call
+/// </summary>
+/// <param name="In">The decoration consumed from each packet</param>
+/// <param name="Out">The decoration produced on each packet</param>
+/// <remarks>
+/// The AutoFilter of this class is deferred, and so is run on this thread at the Dispatch altitude.  It
+/// holds each packet's input together with an auto_out for its output, which keeps the packet alive.
+/// Once the batch size is reached, or the first packet in the batch has waited for the timeout, the
+/// held inputs are passed to BatchFilter in a single call.  The i-th output of that call decorates the
+/// i-th packet.  Packets for which no output was produced, including those held when BatchFilter
+/// throws, have their output marked unsatisfiable.
+///
+/// Packets still held when the thread stops are processed in one last batch if the stop is graceful,
+/// and have their outputs marked unsatisfiable otherwise.
+/// </remarks>
+template<class In, class Out>
+class BatchedAutoFilter:
+  public CoreThread
+{
+public:
+  /// <param name="batchSize">The number of packets processed by each call to BatchFilter</param>
+  /// <param name="timeout">The longest time a packet is held while waiting for a batch to fill</param>
+  BatchedAutoFilter(size_t batchSize, std::chrono::nanoseconds timeout, const char* pName = nullptr) :
+    CoreThread(pName),
+    m_batchSize(batchSize ? batchSize : 1),
+    m_timeout(std::chrono::duration_cast<std::chrono::microseconds>(timeout))
+  {
+    m_inputs.reserve(m_batchSize);
+    m_outputs.reserve(m_batchSize);
+  }
+
+private:
+  const size_t m_batchSize;
+  const std::chrono::microseconds m_timeout;
+
+  // The batch being accumulated.  This is only touched from this thread, so no lock is needed.
+  std::vector<const In*> m_inputs;
+  std::vector<auto_out<Out>> m_outputs;
+
+  // The number of batches dispatched so far, used to recognize timeouts for batches already dispatched.
+  // Only written from this thread, but may be read from any.
+  std::atomic<size_t> m_nBatches{0};
+
+protected:
+  /// <summary>
+  /// Processes one batch of inputs
+  /// </summary>
+  /// <param name="inputs">The input from each packet in the batch, in the order the packets arrived</param>
+  /// <param name="outputs">Initially empty, receives the output for each packet in the same order</param>
+  virtual void BatchFilter(const std::vector<const In*>& inputs, std::vector<Out>& outputs) = 0;
+
+  /// <summary>
+  /// Runs down queued AutoFilter calls and releases every held packet before the thread exits
+  /// </summary>
+  void DoRunLoopCleanup(std::shared_ptr<CoreContext>&& ctxt, std::shared_ptr<CoreObject>&& refTracker) override {
+    try {
+      // Aborted if the stop is not graceful, in which case nothing more is processed
+      CurrentContextPusher pshr(ctxt);
+      DispatchAllEvents();
+      Flush();
+    }
+    catch (dispatch_aborted_exception&) {}
+    catch (...) {
+      // BatchFilter threw during rundown, the context's exception filters get to see it just as they
+      // would have in the run loop
+      try {
+        if (ctxt)
+          ctxt->FilterException();
+      }
+      catch (...) {
+        // Unhandled, but the held packets must still be released
+      }
+    }
+
+    // Held packets must be released here, they hold a reference to this filter
+    m_inputs.clear();
+    m_outputs.clear();
+    CoreThread::DoRunLoopCleanup(std::move(ctxt), std::move(refTracker));
+  }
+
+public:
+  // Accessor methods:
+  size_t GetBatchSize(void) const { return m_batchSize; }
+  size_t GetBatchCount(void) const { return m_nBatches; }
+
+  /// <summary>
+  /// Adds the packet to the current batch, dispatching the batch if it is full
+  /// </summary>
+  Deferred AutoFilter(const In& in, auto_out<Out> out) {
+    m_inputs.push_back(&in);
+    m_outputs.push_back(std::move(out));
+
+    if (m_inputs.size() >= m_batchSize)
+      Flush();
+    else if (m_inputs.size() == 1) {
+      // First packet in this batch, it must not wait longer than the timeout
+      const size_t batch = m_nBatches;
+      *this += m_timeout, [this, batch] {
+        if (batch == m_nBatches)
+          Flush();
+      };
+    }
+    return Deferred(this);
+  }
+
+  /// <summary>
+  /// Dispatches the current batch immediately, regardless of its size
+  /// </summary>
+  /// <remarks>
+  /// This method must only be called from this thread
+  /// </remarks>
+  void Flush(void) {
+    if (m_inputs.empty())
+      return;
+    m_nBatches++;
+
+    // Swapped out first, so the batch is released even if BatchFilter throws
+    std::vector<const In*> inputs;
+    std::vector<auto_out<Out>> outputs;
+    inputs.swap(m_inputs);
+    outputs.swap(m_outputs);
+    m_inputs.reserve(m_batchSize);
+    m_outputs.reserve(m_batchSize);
+
+    std::vector<Out> results;
+    results.reserve(inputs.size());
+    BatchFilter(inputs, results);
+
+    // Scatter, auto_out decorates its packet when it is released
+    for (size_t i = 0; i < results.size() && i < outputs.size(); i++)
+      *outputs[i] = std::move(results[i]);
+  }
+};
+
+}
@@ -5,6 +5,6 @@
 
 using namespace autowiring;
 
-CESetup<>::CESetup(AutoPacket& packet) :
+CESetup<>::CESetup(AutoPacket& packet, const DecorationDisposition* const*, index_tuple<>) :
   pshr(packet.GetContext())
 {}
@@ -13,8 +13,96 @@ class Deferred;
 
 namespace autowiring {
 
-// The type of the call centralizer
-typedef void(*t_extractedCall)(const void* obj, AutoPacket&);
+// The type of the call centralizer.  The dispositions are those bound to each argument when the
+// caller's counter was wired, or nullptr if the arguments must be looked up on the packet.
+typedef void(*t_extractedCall)(const void* obj, AutoPacket&, const DecorationDisposition* const* dispositions);
+
+/// <summary>
+/// Stands in for a packet while an input is extracted from the disposition it was bound to
+/// </summary>
+/// <remarks>
+/// The auto_arg specializations for inputs obtain their values through a handful of packet methods.
+/// This type provides the same methods, but reads the bound disposition directly rather than looking
+/// it up under the packet lock.  The inputs of a satisfied AutoFilter do not change until the packet
+/// is released, so the lock is not needed.  Time shifts are ignored, the disposition already has one.
+/// </remarks>
+class BoundArgument {
+public:
+  BoundArgument(AutoPacket& packet, const DecorationDisposition& disposition) :
+    m_packet(packet),
+    m_disposition(disposition)
+  {}
+
+private:
+  AutoPacket& m_packet;
+  const DecorationDisposition& m_disposition;
+
+  /// <returns>The bound disposition if it is complete, otherwise nullptr</returns>
+  const DecorationDisposition* GetComplete(void) const {
+    return m_disposition.m_state == DispositionState::Complete ? &m_disposition : nullptr;
+  }
+
+public:
+  template<class T>
+  const T& Get(int tshift = 0) const {
+    const T* retVal;
+    if (!Get(retVal, tshift) || !retVal)
+      // Packet raises the exception
+      return m_packet.Get<T>(tshift);
+    return *retVal;
+  }
+
+  template<class T>
+  bool Get(const T*& out, int tshift = 0) const {
+    return AutoPacket::Extract(GetComplete(), DecorationKey(auto_id_t<T>{}, tshift), out);
+  }
+
+  template<class T>
+  const std::shared_ptr<const T>* GetShared(int tshift = 0) const {
+    const std::shared_ptr<const T>* retVal;
+    AutoPacket::Extract(GetComplete(), DecorationKey(auto_id_t<T>{}, tshift), retVal);
+    return retVal;
+  }
+
+  template<class T>
+  T&& GetRvalue(int tshift = 0) const {
+    const T* retVal;
+    if (!Get(retVal, tshift) || !retVal)
+      return m_packet.GetRvalue<T>(tshift);
+    return std::move(const_cast<T&>(*retVal));
+  }
+
+  template<class T>
+  std::shared_ptr<T>&& GetRvalueShared(int tshift = 0) const {
+    // Might have to attach a shared pointer, which can only be done under the lock
+    return m_packet.GetRvalueShared<T>(tshift);
+  }
+
+  template<class T>
+  DecorationView<T> GetAllView(int = 0) const {
+    return AutoPacket::ExtractAll<T>(&m_disposition);
+  }
+};
+
+/// <summary>
+/// Obtains an input argument, from its bound disposition if it has one
+/// </summary>
+template<class Arg>
+auto ExtractArgument(AutoPacket& packet, const DecorationDisposition* disposition, std::true_type) -> decltype(auto_arg<Arg>::arg(packet)) {
+  if (!disposition)
+    return auto_arg<Arg>::arg(packet);
+
+  BoundArgument bound(packet, *disposition);
+  return auto_arg<Arg>::arg(bound);
+}
+
+/// <summary>
+/// Obtains an argument which is not an input, these are never bound
+/// </summary>
+template<class Arg>
+auto ExtractArgument(AutoPacket& packet, const DecorationDisposition*, std::false_type) -> decltype(auto_arg<Arg>::arg(packet)) {
+  return auto_arg<Arg>::arg(packet);
+}
 
 /// <summary>
 /// An argument pack that holds all of the inputs and outputs to an AutoFilter during its invocation
@@ -22,10 +110,17 @@ typedef void(*t_extractedCall)(const void* obj, AutoPacket&);
 /// <param name="shared_outputs">Holds true if output types should be declared as shared pointers, false otherwise</param>
 template<class... Args>
 struct CESetup {
-  CESetup(AutoPacket& packet) :
+  template<int... N>
+  CESetup(AutoPacket& packet, const DecorationDisposition* const* dispositions, index_tuple<N...>) :
     packet(packet),
     pshr(packet.GetContext()),
-    args(auto_arg<Args>::arg(packet)...)
+    args(
+      ExtractArgument<Args>(
+        packet,
+        dispositions ? dispositions[N] : nullptr,
+        std::integral_constant<bool, auto_arg<Args>::is_input>{}
+      )...
+    )
   {}
 
   AutoPacket& packet;
@@ -49,7 +144,7 @@ struct CESetup {
 template<>
 struct CESetup<>
 {
-  CESetup(AutoPacket& packet);
+  CESetup(AutoPacket& packet, const DecorationDisposition* const* dispositions, index_tuple<>);
 
   CurrentContextPusher pshr;
 
@@ -78,9 +173,10 @@ struct CE<RetType (*)(Args...), index_tuple<N...>>:
   /// </summary>
   /// <param name="obj">A shared pointer to the object to be called</param>
   /// <param name="packet">The AutoPacket to be used to satisfy the input arguments for the extractor</param>
-  static void Call(const void* pfn, AutoPacket& packet) {
+  /// <param name="dispositions">The dispositions bound to each argument, or nullptr if there are none</param>
+  static void Call(const void* pfn, AutoPacket& packet, const DecorationDisposition* const* dispositions) {
     // Setup, handoff, commit
-    t_ceSetup extractor(packet);
+    t_ceSetup extractor(packet, dispositions, index_tuple<N...>{});
     ((t_pfn)pfn)(
       static_cast<typename auto_arg<Args>::arg_type>(autowiring::get<N>(extractor.args))...
     );
@@ -102,9 +198,9 @@ struct CE<void (T::*)(Args...), index_tuple<N...>> :
   /// Binder struct, lets us refer to an instance of Call by type
   /// </summary>
   template<void(T::*memFn)(Args...)>
-  static void Call(const void* pObj, AutoPacket& packet) {
+  static void Call(const void* pObj, AutoPacket& packet, const DecorationDisposition* const* dispositions) {
     // Extract, call, commit
-    t_ceSetup extractor(packet);
+    t_ceSetup extractor(packet, dispositions, index_tuple<N...>{});
     (((T*) pObj)->*memFn)(
       static_cast<typename auto_arg<Args>::arg_type>(autowiring::get<N>(extractor.args))...
     );
@@ -123,9 +219,9 @@ struct CE<void (T::*)(Args...) const, index_tuple<N...>> :
   static const bool deferred = false;
 
   template<void(T::*memFn)(Args...) const>
-  static void Call(const void* pObj, AutoPacket& packet) {
+  static void Call(const void* pObj, AutoPacket& packet, const DecorationDisposition* const* dispositions) {
     // Extract, call, commit
-    t_ceSetup extractor(packet);
+    t_ceSetup extractor(packet, dispositions, index_tuple<N...>{});
     (((const T*) pObj)->*memFn)(
       static_cast<typename auto_arg<Args>::arg_type>(autowiring::get<N>(extractor.args))...
     );
@@ -144,17 +240,20 @@ struct CE<Deferred(T::*)(Args...), index_tuple<N...>> :
   static const bool deferred = true;
 
   template<Deferred(T::*memFn)(Args...)>
-  static void Call(const void* pObj, AutoPacket& autoPacket) {
+  static void Call(const void* pObj, AutoPacket& autoPacket, const DecorationDisposition* const* dispositions) {
     // Obtain a shared pointer of the AutoPacket in order to ensure the packet
     // is not destroyed when we pend this lambda to the destination object's
     // dispatch queue.
     auto pAutoPacket = autoPacket.shared_from_this();
 
     // Pend the call to this object's dispatch queue:
-    *(T*) pObj += [pObj, pAutoPacket] {
+    *(T*) pObj += [pObj, pAutoPacket, dispositions] {
+      // The deadline may have passed while this call was waiting in the queue
+      if (pAutoPacket->ShedIfPastDeadline(Decompose<void (T::*)(Args...)>::template Enumerate<AutoFilterArgument, AutoFilterArgumentT>::types))
+        return;
 
       // Extract, call, commit
-      t_ceSetup extractor(*pAutoPacket);
+      t_ceSetup extractor(*pAutoPacket, dispositions, index_tuple<N...>{});
       (((T*) pObj)->*memFn)(
         static_cast<typename auto_arg<Args>::arg_type>(autowiring::get<N>(extractor.args))...
       );
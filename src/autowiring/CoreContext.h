@@ -24,6 +24,7 @@
 #include "TypeUnifier.h"
 
 #include <list>
+#include <set>
 #include MEMORY_HEADER
 #include TYPE_INDEX_HEADER
 #include STL_UNORDERED_MAP
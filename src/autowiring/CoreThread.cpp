@@ -6,7 +6,10 @@
 
 CoreThread::CoreThread(const char* pName):
   BasicThread(pName)
-{}
+{
+  // We do not override OnPended, so producers need not contend with our thread for the dispatch lock
+  EnableInbox();
+}
 
 CoreThread::~CoreThread(void){}
 
@@ -28,7 +31,7 @@ void CoreThread::DoRunLoopCleanup(std::shared_ptr<CoreContext>&& ctxt, std::shar
 
 void CoreThread::Run() {
   while(!ShouldStop())
-    WaitForEvent();
+    WaitForEvents();
 }
 
 void CoreThread::OnStop(bool graceful) {
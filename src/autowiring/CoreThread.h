@@ -42,6 +42,11 @@ protected:
   /// </summary>
   virtual void DoRunLoopCleanup(std::shared_ptr<CoreContext>&& ctxt, std::shared_ptr<CoreObject>&& refTracker) override;
 
+  /// <summary>
+  /// Overridden so that the run loop can observe a stop request between the events of a batch
+  /// </summary>
+  bool ShouldInterruptBatch(void) const override { return ShouldStop(); }
+
 public:
   /// \internal
   /// <summary>
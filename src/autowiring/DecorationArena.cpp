@@ -0,0 +1,119 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#include "stdafx.h"
+#include "DecorationArena.h"
+#include <new>
+
+using namespace autowiring;
+
+struct DecorationArena::Chunk {
+  Chunk(size_t capacity) :
+    capacity(capacity)
+  {}
+
+  // One reference for the arena, and one for each allocation still held
+  std::atomic<size_t> refs{1};
+
+  // Bytes claimed so far.  This may exceed the capacity, in which case the chunk is full.
+  std::atomic<size_t> used{0};
+  const size_t capacity;
+
+  /// <returns>The first usable byte in the chunk</returns>
+  char* data(void);
+
+  void Release(void) {
+    if (!--refs) {
+      this->~Chunk();
+      ::operator delete(this);
+    }
+  }
+
+  // Space taken by the bookkeeping before each allocation
+  static const size_t sc_header = (sizeof(Chunk*) + sc_alignment - 1) / sc_alignment * sc_alignment;
+};
+
+// Space taken by the chunk bookkeeping at the front of its memory
+static const size_t sc_chunkHeader = (sizeof(DecorationArena::Chunk) + DecorationArena::sc_alignment - 1) / DecorationArena::sc_alignment * DecorationArena::sc_alignment;
+
+char* DecorationArena::Chunk::data(void) {
+  return reinterpret_cast<char*>(this) + sc_chunkHeader;
+}
+
+DecorationArena::DecorationArena(size_t chunkSize) :
+  m_chunkSize(chunkSize)
+{}
+
+DecorationArena::~DecorationArena(void) {
+  for (Chunk* chunk : m_chunks)
+    chunk->Release();
+}
+
+void DecorationArena::Grow(Chunk* expected) {
+  std::lock_guard<std::mutex> lk(m_lock);
+  if (m_current != expected)
+    // Someone else already replaced the chunk
+    return;
+
+  Chunk* chunk = new (::operator new(sc_chunkHeader + m_chunkSize)) Chunk(m_chunkSize);
+  m_chunks.push_back(chunk);
+  m_current = chunk;
+}
+
+size_t DecorationArena::GetChunkCount(void) {
+  std::lock_guard<std::mutex> lk(m_lock);
+  return m_chunks.size();
+}
+
+void* DecorationArena::Allocate(size_t nBytes) {
+  // Each allocation carries a header identifying the chunk that holds it
+  size_t nTotal = Chunk::sc_header + (nBytes + sc_alignment - 1) / sc_alignment * sc_alignment;
+
+  Chunk* chunk = nullptr;
+  char* base = nullptr;
+  if (nTotal <= m_chunkSize / 4)
+    for (;;) {
+      chunk = m_current;
+      if (chunk) {
+        size_t offset = chunk->used.fetch_add(nTotal);
+        if (offset + nTotal <= chunk->capacity) {
+          ++chunk->refs;
+          base = chunk->data() + offset;
+          break;
+        }
+      }
+      Grow(chunk);
+    }
+  else
+    // Large allocations would waste too much of a chunk, take them from the heap
+    base = static_cast<char*>(::operator new(nTotal));
+
+  *reinterpret_cast<Chunk**>(base) = chunk;
+  return base + Chunk::sc_header;
+}
+
+void DecorationArena::Deallocate(void* ptr) {
+  char* base = static_cast<char*>(ptr) - Chunk::sc_header;
+  Chunk* chunk = *reinterpret_cast<Chunk**>(base);
+  if (chunk)
+    chunk->Release();
+  else
+    ::operator delete(base);
+}
+
+void DecorationArena::Reset(void) {
+  std::lock_guard<std::mutex> lk(m_lock);
+
+  Chunk* retained = nullptr;
+  for (Chunk* chunk : m_chunks)
+    if (!retained && chunk->refs == 1) {
+      // Nothing outstanding, this chunk can be rewound
+      chunk->used = 0;
+      retained = chunk;
+    }
+    else
+      chunk->Release();
+
+  m_chunks.clear();
+  if (retained)
+    m_chunks.push_back(retained);
+  m_current = retained;
+}
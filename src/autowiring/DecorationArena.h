@@ -0,0 +1,113 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include MUTEX_HEADER
+#include <vector>
+
+namespace autowiring {
+
+/// <summary>
+/// A bump-pointer allocator for the decorations attached to a single packet
+/// </summary>
+/// <remarks>
+/// Memory is carved out of fixed-size chunks.  Each allocation is preceded by a header naming the
+/// chunk it came from, so that an allocation may be released after the arena itself is gone.  Each
+/// chunk counts the allocations still held from it, and a chunk is only returned to the heap once
+/// the arena and every allocation from it have released it.  An allocation that does not fit in a
+/// chunk comfortably is taken from the heap instead.
+///
+/// Allocation may be done from any number of threads concurrently.  Reset must only be called when
+/// no other thread is allocating.
+/// </remarks>
+class DecorationArena {
+public:
+  DecorationArena(size_t chunkSize);
+  ~DecorationArena(void);
+
+  // Alignment of every allocation made from the arena
+  static const size_t sc_alignment = alignof(std::max_align_t);
+
+  struct Chunk;
+
+private:
+  // Size of the usable part of each chunk
+  const size_t m_chunkSize;
+
+  // The chunk from which allocations are currently made
+  std::atomic<Chunk*> m_current{nullptr};
+
+  // Every chunk that holds a reference from this arena, guarded by m_lock.  Chunks are not released
+  // until the next reset, because another thread might still be allocating from them.
+  std::mutex m_lock;
+  std::vector<Chunk*> m_chunks;
+
+  /// <summary>
+  /// Creates a new chunk and makes it current, unless another thread already has
+  /// </summary>
+  void Grow(Chunk* expected);
+
+public:
+  /// <returns>The size of each chunk in bytes</returns>
+  size_t GetChunkSize(void) const { return m_chunkSize; }
+
+  /// <returns>The number of chunks held by this arena</returns>
+  size_t GetChunkCount(void);
+
+  /// <summary>
+  /// Allocates memory aligned to sc_alignment
+  /// </summary>
+  void* Allocate(size_t nBytes);
+
+  /// <summary>
+  /// Releases memory previously obtained from any arena's Allocate method
+  /// </summary>
+  static void Deallocate(void* ptr);
+
+  /// <summary>
+  /// Makes all space in the arena available for reuse
+  /// </summary>
+  /// <remarks>
+  /// Chunks which still have allocations outstanding are abandoned to those allocations, which will
+  /// free the chunk when the last of them is released.  The first chunk with no allocations
+  /// outstanding is retained and rewound, and the rest are freed.
+  /// </remarks>
+  void Reset(void);
+};
+
+/// <summary>
+/// Standard allocator adaptor for DecorationArena, for use with std::allocate_shared
+/// </summary>
+template<class T>
+class DecorationArenaAllocator {
+public:
+  typedef T value_type;
+
+  DecorationArenaAllocator(DecorationArena& arena) :
+    m_arena(&arena)
+  {}
+
+  template<class U>
+  DecorationArenaAllocator(const DecorationArenaAllocator<U>& rhs) :
+    m_arena(rhs.m_arena)
+  {}
+
+  // The arena is only needed to allocate, any copy of this allocator may deallocate after the arena is gone
+  DecorationArena* m_arena;
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(m_arena->Allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* ptr, size_t) {
+    DecorationArena::Deallocate(ptr);
+  }
+
+  template<class U>
+  bool operator==(const DecorationArenaAllocator<U>&) const { return true; }
+
+  template<class U>
+  bool operator!=(const DecorationArenaAllocator<U>&) const { return false; }
+};
+
+}
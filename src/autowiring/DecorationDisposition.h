@@ -3,8 +3,10 @@
 #include "AutowiringConfig.h"
 #include "altitude.h"
 #include "AnySharedPointer.h"
+#include <algorithm>
 #include <atomic>
-#include <set>
+#include <stdexcept>
+#include <tuple>
 #include <vector>
 
 namespace autowiring {
@@ -122,25 +124,39 @@ struct DecorationDisposition
         throw std::runtime_error("Cannot initialize Subscriber with nullptr to SatCounter.");
     }
 
+    Subscriber(const Subscriber& rhs) = default;
+
+    Subscriber& operator=(const Subscriber& rhs) = default;
+
     // True if a shared pointer will be taken, false otherwise
-    const bool is_shared;
+    bool is_shared;
 
     // The relationship between this subscriber and the provided decoration
-    const Type type;
+    Type type;
 
     // The altitude of the satisfaction counter
-    const autowiring::altitude altitude;
+    autowiring::altitude altitude;
 
     // The pointer to the satisfaction counter, it should never be nullptr
-    SatCounter* const satCounter;
+    SatCounter* satCounter;
 
     bool operator<(const Subscriber& rhs) const {
       return std::tie(altitude, satCounter) > std::tie(rhs.altitude, rhs.satCounter);
     }
   };
 
-  // Subscribers of this decoration, sorted by altitude.
-  std::set<Subscriber> m_subscribers;
+  // Subscribers of this decoration, sorted by altitude.  A sorted vector is used rather than a set
+  // so that packet templates can be copied with a single allocation per decoration.
+  std::vector<Subscriber> m_subscribers;
+
+  /// <summary>
+  /// Inserts the specified subscriber in sorted order, if it is not already present
+  /// </summary>
+  void AddSubscriber(const Subscriber& subscriber) {
+    auto q = std::lower_bound(m_subscribers.begin(), m_subscribers.end(), subscriber);
+    if (q == m_subscribers.end() || subscriber < *q)
+      m_subscribers.insert(q, subscriber);
+  }
 
   // The current state of this disposition
   DispositionState m_state = DispositionState::Unsatisfied;
@@ -181,8 +197,15 @@ struct DecorationDisposition
     return m_nProducersRun >= m_publishers.size();
   }
 
+  /// <summary>
+  /// Returns this disposition to the state it had before any decorations were attached
+  /// </summary>
+  /// <remarks>
+  /// Publishers, subscribers, and modifiers are retained, as is the capacity of the decorations
+  /// vector, so that a recycled packet does not need to rebuild its satisfaction graph.
+  /// </remarks>
   void Reset(void) {
-    // IMPORTANT: Do not reset type_info
+    m_nProducersRun = 0;
     m_decorations.clear();
     m_pImmediate = nullptr;
     m_state = DispositionState::Unsatisfied;
@@ -0,0 +1,123 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#include "stdafx.h"
+#include "DecorationHistory.h"
+#include "AutoPacketInternal.hpp"
+#include "AutoPacketTemplate.h"
+
+using namespace autowiring;
+
+DecorationHistory::DecorationHistory(void) {}
+
+DecorationHistory::~DecorationHistory(void) {}
+
+std::vector<DecorationHistory::Entry>& DecorationHistory::ReserveUnsafe(auto_id id, size_t depth) {
+  std::vector<Entry>& ring = m_rings[id];
+  if (depth <= ring.size())
+    return ring;
+
+  // Entries are indexed by sequence modulo the ring size, so they must be moved to their new places
+  std::vector<Entry> grown(depth);
+  for (Entry& entry : ring) {
+    if (entry.sequence == ~0ULL)
+      continue;
+
+    Entry& dest = grown[entry.sequence % depth];
+    if (dest.sequence == ~0ULL || dest.sequence < entry.sequence)
+      dest = std::move(entry);
+  }
+  ring = std::move(grown);
+  return ring;
+}
+
+void DecorationHistory::Deliver(std::vector<Delivery>& deliveries) {
+  for (Delivery& delivery : deliveries)
+    static_cast<AutoPacketInternal&>(*delivery.packet).DecoratePrior(delivery.key, delivery.value);
+}
+
+void DecorationHistory::Issue(uint64_t sequence, const std::shared_ptr<AutoPacket>& packet, const AutoPacketTemplate& packetTemplate) {
+  std::vector<Delivery> deliveries;
+  {
+    std::lock_guard<std::mutex> lk(m_lock);
+    for (const auto& type : packetTemplate.GetTimeShiftedTypes()) {
+      // One entry for each prior packet that may be requested
+      std::vector<Entry>& ring = ReserveUnsafe(type.first, type.second - 1);
+
+      for (int tshift = 1; tshift < type.second; tshift++) {
+        DecorationKey key(type.first, tshift);
+        if (sequence < static_cast<uint64_t>(tshift)) {
+          // Refers to a packet from before the first one, this will never be satisfied
+          deliveries.push_back(Delivery{packet, key, AnySharedPointer{}});
+          continue;
+        }
+
+        const uint64_t source = sequence - tshift;
+        const Entry& entry = ring[source % ring.size()];
+        if (entry.sequence != source)
+          // The source was issued without this type in its template, or its entry has since been reused.
+          // Either way it will never publish here.
+          deliveries.push_back(Delivery{packet, key, AnySharedPointer{}});
+        else if (entry.published)
+          deliveries.push_back(Delivery{packet, key, entry.value});
+        else
+          // Not published yet, the source will deliver it when it is
+          m_waiters[source].push_back(Waiter{type.first, tshift, packet});
+      }
+
+      // Reserve our own entry, only after the waits above have been resolved because it may be the entry
+      // of the oldest source
+      Entry& entry = ring[sequence % ring.size()];
+      entry.sequence = sequence;
+      entry.published = false;
+      entry.value.reset();
+    }
+  }
+  Deliver(deliveries);
+}
+
+void DecorationHistory::Publish(uint64_t sequence, auto_id id, const AnySharedPointer& value) {
+  std::vector<Delivery> deliveries;
+  {
+    std::lock_guard<std::mutex> lk(m_lock);
+    auto ring = m_rings.find(id);
+    if (ring == m_rings.end() || ring->second.empty())
+      // No packet has asked for prior decorations of this type
+      return;
+
+    Entry& entry = ring->second[sequence % ring->second.size()];
+    if (entry.sequence == sequence) {
+      if (entry.published)
+        // Already published
+        return;
+      entry.published = true;
+      entry.value = value;
+    }
+    // Otherwise a newer packet has reserved this entry, and no packet that is yet to be issued can need
+    // this decoration.  Packets already waiting for it are still served below.
+
+    auto q = m_waiters.find(sequence);
+    if (q == m_waiters.end())
+      return;
+
+    std::vector<Waiter>& waiters = q->second;
+    for (auto waiter = waiters.begin(); waiter != waiters.end();) {
+      if (waiter->id != id) {
+        ++waiter;
+        continue;
+      }
+
+      auto packet = waiter->packet.lock();
+      if (packet)
+        deliveries.push_back(Delivery{packet, DecorationKey(id, waiter->tshift), value});
+      waiter = waiters.erase(waiter);
+    }
+    if (waiters.empty())
+      m_waiters.erase(q);
+  }
+  Deliver(deliveries);
+}
+
+size_t DecorationHistory::GetDepth(auto_id id) {
+  std::lock_guard<std::mutex> lk(m_lock);
+  auto q = m_rings.find(id);
+  return q == m_rings.end() ? 0 : q->second.size();
+}
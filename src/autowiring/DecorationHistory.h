@@ -0,0 +1,103 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#pragma once
+#include "AnySharedPointer.h"
+#include "DecorationDisposition.h"
+#include MEMORY_HEADER
+#include MUTEX_HEADER
+#include <unordered_map>
+#include <vector>
+
+class AutoPacket;
+
+namespace autowiring {
+
+class AutoPacketTemplate;
+
+/// <summary>
+/// The recent decorations of each time-shifted type, used to satisfy auto_prev arguments
+/// </summary>
+/// <remarks>
+/// Each packet issued by a factory is given a sequence number.  For every type named by an auto_prev
+/// argument, the history keeps a ring holding the decoration of that type from each of the last few
+/// packets, as many as the largest time shift requested for the type.  A packet publishes its
+/// decoration to the ring once the decoration is complete, or when the packet is finalized.
+///
+/// A newly issued packet resolves its time-shifted decorations against the rings, and then reserves its
+/// own entry in each ring it will publish to.  A decoration that has been reserved but not published
+/// yet is delivered to the packet by whichever packet later publishes it.  If there is no reservation,
+/// the prior packet will never publish the decoration, and it is marked unsatisfiable at once.  Only
+/// the decorations themselves are retained, never the packets that held them.
+/// </remarks>
+class DecorationHistory {
+public:
+  DecorationHistory(void);
+  ~DecorationHistory(void);
+
+private:
+  struct Entry {
+    // The sequence number of the packet that reserved this entry, or ~0 if the entry is empty
+    uint64_t sequence = ~0ULL;
+
+    // True once the packet has published to this entry
+    bool published = false;
+
+    // The decoration published, or nullptr if the packet had none
+    AnySharedPointer value;
+  };
+
+  // A packet waiting for a decoration that has not yet been published
+  struct Waiter {
+    auto_id id;
+    int tshift;
+    std::weak_ptr<AutoPacket> packet;
+  };
+
+  // A decoration to be attached to a packet once the lock is released
+  struct Delivery {
+    std::shared_ptr<AutoPacket> packet;
+    DecorationKey key;
+    AnySharedPointer value;
+  };
+
+  std::mutex m_lock;
+
+  // Rings of published decorations, indexed by the sequence number modulo the ring size
+  std::unordered_map<auto_id, std::vector<Entry>> m_rings;
+
+  // Waiters indexed by the sequence number of the packet they are waiting on
+  std::unordered_map<uint64_t, std::vector<Waiter>> m_waiters;
+
+  /// <returns>The ring for the specified type, grown to at least the specified depth</returns>
+  std::vector<Entry>& ReserveUnsafe(auto_id id, size_t depth);
+
+  /// <summary>
+  /// Attaches each delivery to its packet, or marks it unsatisfiable if there is no value
+  /// </summary>
+  static void Deliver(std::vector<Delivery>& deliveries);
+
+public:
+  /// <summary>
+  /// Registers a packet that is about to be issued with the specified sequence number
+  /// </summary>
+  /// <remarks>
+  /// Time-shifted decorations already published are attached to the packet before this method returns,
+  /// as are those which the prior packet will never publish.  Packets must be registered in sequence
+  /// order, and before they are initialized.
+  /// </remarks>
+  void Issue(uint64_t sequence, const std::shared_ptr<AutoPacket>& packet, const AutoPacketTemplate& packetTemplate);
+
+  /// <summary>
+  /// Publishes the decoration of the specified type from the packet with the specified sequence number
+  /// </summary>
+  /// <param name="value">The decoration, or nullptr if the packet will not have one</param>
+  /// <remarks>
+  /// Only the first publication from a packet is retained, later ones are ignored.  Any packets waiting
+  /// for the decoration receive it before this method returns.
+  /// </remarks>
+  void Publish(uint64_t sequence, auto_id id, const AnySharedPointer& value);
+
+  /// <returns>The number of entries held in the ring for the specified type</returns>
+  size_t GetDepth(auto_id id);
+};
+
+}
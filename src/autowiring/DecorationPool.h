@@ -0,0 +1,122 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#pragma once
+#include "auto_id.h"
+#include "ObjectPool.h"
+#include <atomic>
+#include <cstddef>
+#include MEMORY_HEADER
+#include TYPE_TRAITS_HEADER
+#include <unordered_map>
+
+namespace autowiring {
+
+/// <summary>
+/// The number of decorations a pool has supplied from its cache, and the number it has not
+/// </summary>
+struct DecorationPoolStatistics {
+  // Decorations which reused an object returned by an earlier packet
+  size_t nHits;
+
+  // Decorations for which a new object was constructed, or which the pool could not supply
+  size_t nMisses;
+
+  /// <returns>The fraction of decorations supplied from the cache, or zero if none were requested</returns>
+  double GetHitRate(void) const {
+    return nHits + nMisses ? static_cast<double>(nHits) / (nHits + nMisses) : 0.0;
+  }
+};
+
+/// <summary>
+/// Type-erased base of the pools registered with a packet factory for its decoration types
+/// </summary>
+class DecorationPoolBase {
+public:
+  virtual ~DecorationPoolBase(void) {}
+
+protected:
+  std::atomic<size_t> m_nHits{0};
+  std::atomic<size_t> m_nMisses{0};
+
+public:
+  /// <returns>The number of decorations supplied by this pool from its cache and otherwise</returns>
+  DecorationPoolStatistics GetStatistics(void) const {
+    return DecorationPoolStatistics{m_nHits, m_nMisses};
+  }
+};
+
+/// <summary>
+/// An object pool from which the decorations of type T are constructed
+/// </summary>
+/// <remarks>
+/// An object is returned to the pool once the packet it decorated, and every filter which retained a
+/// shared pointer to it, have released it.  Objects are not reconstructed when they are reissued; the
+/// initializer and finalizer given to the pool should be used to restore any state that matters, and
+/// the storage the object owns, such as the buffer of a std::vector that is cleared rather than
+/// released, is then reused by the next packet.
+///
+/// The pool is used when a decoration is default constructed, such as for a T& output, or when it is
+/// constructed from another T, in which case the value is assigned to the pooled object.  Only the
+/// identity of the object is reused in the second case; whether its storage survives is up to the
+/// assignment operator of T, and the move assignment of a std::vector, for instance, adopts the buffer
+/// of the value and frees its own.  Decorations constructed from other arguments, and those requested
+/// while the outstanding limit of the pool is reached, are allocated as though no pool were registered
+/// and are counted as misses.
+/// </remarks>
+template<class T>
+class DecorationPool:
+  public DecorationPoolBase,
+  ObjectPool<T>
+{
+public:
+  DecorationPool(ObjectPool<T>&& pool) :
+    ObjectPool<T>(std::move(pool))
+  {}
+
+private:
+  /// <returns>An object from the pool, or nullptr if the outstanding limit has been reached</returns>
+  std::shared_ptr<T> ObtainElement(void) {
+    std::unique_lock<std::mutex> lk(*this->m_monitor);
+    if (this->m_limit <= this->m_outstanding) {
+      lk.unlock();
+      ++m_nMisses;
+      return nullptr;
+    }
+    ++(this->m_objs.empty() ? m_nMisses : m_nHits);
+    return this->ObtainElementUnsafe(lk);
+  }
+
+public:
+  using ObjectPool<T>::GetOutstanding;
+  using ObjectPool<T>::GetCached;
+  using ObjectPool<T>::ClearCachedEntities;
+
+  /// <returns>An object from the pool, or nullptr if the pool cannot supply one</returns>
+  std::shared_ptr<T> Obtain(void) {
+    return ObtainElement();
+  }
+
+  /// <returns>An object from the pool to which the specified value was assigned, or nullptr</returns>
+  template<class U>
+  typename std::enable_if<
+    std::is_same<typename std::decay<U>::type, T>::value &&
+    std::is_assignable<T&, U&&>::value,
+    std::shared_ptr<T>
+  >::type Obtain(U&& value) {
+    std::shared_ptr<T> retVal = ObtainElement();
+    if (retVal)
+      *retVal = std::forward<U>(value);
+    return retVal;
+  }
+
+  /// <returns>nullptr, decorations constructed from any other arguments are not pooled</returns>
+  template<class... Args>
+  std::shared_ptr<T> Obtain(Args&&...) {
+    ++m_nMisses;
+    return nullptr;
+  }
+};
+
+// The pools registered with a packet factory, keyed by decoration type
+typedef std::unordered_map<auto_id, std::shared_ptr<DecorationPoolBase>> DecorationPoolMap;
+
+}
@@ -0,0 +1,79 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#pragma once
+#include "AnySharedPointer.h"
+#include <cstddef>
+#include <iterator>
+
+namespace autowiring {
+
+/// <summary>
+/// A non-owning view of every decoration of type T attached to a packet
+/// </summary>
+/// <remarks>
+/// A view refers directly to the decorations held by the packet, nothing is copied.  Once every
+/// producer of T has run, the decorations of T do not change until the packet is released, and so a
+/// view obtained from within an AutoFilter which takes T as an input remains valid for the duration of
+/// that call.  A view must not outlive the packet from which it was obtained.
+/// </remarks>
+template<class T>
+class DecorationView {
+public:
+  DecorationView(void) = default;
+
+  DecorationView(const AnySharedPointer* first, const AnySharedPointer* last) :
+    m_first(first),
+    m_last(last)
+  {}
+
+  class const_iterator {
+  public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef const T* value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const T* const* pointer;
+    typedef const T* reference;
+
+    const_iterator(void) = default;
+    explicit const_iterator(const AnySharedPointer* cur) : m_cur(cur) {}
+
+  private:
+    const AnySharedPointer* m_cur = nullptr;
+
+  public:
+    const T* operator*(void) const { return static_cast<const T*>(m_cur->ptr()); }
+    const T* operator[](std::ptrdiff_t n) const { return static_cast<const T*>(m_cur[n].ptr()); }
+
+    const_iterator& operator++(void) { ++m_cur; return *this; }
+    const_iterator operator++(int) { return const_iterator(m_cur++); }
+    const_iterator& operator--(void) { --m_cur; return *this; }
+    const_iterator operator--(int) { return const_iterator(m_cur--); }
+    const_iterator& operator+=(std::ptrdiff_t n) { m_cur += n; return *this; }
+    const_iterator& operator-=(std::ptrdiff_t n) { m_cur -= n; return *this; }
+    const_iterator operator+(std::ptrdiff_t n) const { return const_iterator(m_cur + n); }
+    const_iterator operator-(std::ptrdiff_t n) const { return const_iterator(m_cur - n); }
+    std::ptrdiff_t operator-(const const_iterator& rhs) const { return m_cur - rhs.m_cur; }
+
+    bool operator==(const const_iterator& rhs) const { return m_cur == rhs.m_cur; }
+    bool operator!=(const const_iterator& rhs) const { return m_cur != rhs.m_cur; }
+    bool operator<(const const_iterator& rhs) const { return m_cur < rhs.m_cur; }
+  };
+
+private:
+  const AnySharedPointer* m_first = nullptr;
+  const AnySharedPointer* m_last = nullptr;
+
+public:
+  const_iterator begin(void) const { return const_iterator(m_first); }
+  const_iterator end(void) const { return const_iterator(m_last); }
+
+  size_t size(void) const { return m_last - m_first; }
+  bool empty(void) const { return m_first == m_last; }
+
+  /// <returns>The i-th decoration</returns>
+  const T* operator[](size_t i) const { return static_cast<const T*>(m_first[i].ptr()); }
+
+  /// <returns>The shared pointer held by the packet for the i-th decoration, without copying it</returns>
+  const std::shared_ptr<const T>& GetShared(size_t i) const { return m_first[i].template as<const T>(); }
+};
+
+}
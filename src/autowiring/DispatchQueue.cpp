@@ -14,8 +14,11 @@ DispatchQueue::DispatchQueue(size_t dispatchCap):
 
 DispatchQueue::DispatchQueue(DispatchQueue&& q):
   onAborted(std::move(q.onAborted)),
-  m_dispatchCap(q.m_dispatchCap)
+  m_dispatchCap(q.m_dispatchCap.load()),
+  m_inboxEnabled(q.m_inboxEnabled)
 {
+  if (q.m_timerWheel)
+    m_timerWheel.reset(new DispatchTimerWheel(q.m_timerWheel->GetResolution()));
   if (!onAborted)
     *this += std::move(q);
 }
@@ -27,9 +30,104 @@ DispatchQueue::~DispatchQueue(void) {
     delete cur;
     cur = next;
   }
+  for (auto cur = m_pInbox.load(); cur;) {
+    auto next = cur->m_pFlink;
+    delete cur;
+    cur = next;
+  }
+
+  // Thunks we created which are still held elsewhere keep the pool alive until they are deleted
+  m_thunkPool->Release();
+}
+
+bool DispatchQueue::DrainInboxUnsafe(void) {
+  // Entries pended concurrently with Abort are dumped by whoever pended them.  This load must be
+  // sequentially consistent, it is ordered against the increment of m_nWaiting by our caller.
+  if (!m_pInbox.load(std::memory_order_seq_cst) || onAborted)
+    return false;
+
+  DispatchThunkBase* pInbox = m_pInbox.exchange(nullptr, std::memory_order_seq_cst);
+  if (!pInbox)
+    return false;
+
+  // The inbox is linked newest-first, flip it around before appending it
+  DispatchThunkBase* pFirst = nullptr;
+  DispatchThunkBase* pLast = pInbox;
+  for (DispatchThunkBase* pNext; pInbox; pInbox = pNext) {
+    pNext = pInbox->m_pFlink;
+    pInbox->m_pFlink = pFirst;
+    pFirst = pInbox;
+  }
+
+  if (m_pHead)
+    m_pTail->m_pFlink = pFirst;
+  else
+    m_pHead = pFirst;
+  m_pTail = pLast;
+  return true;
+}
+
+bool DispatchQueue::PendInbox(DispatchThunkBase* thunk) {
+  // Reserve a place in the queue first, this is how the dispatch cap is enforced without a lock
+  if (m_count++ >= m_dispatchCap) {
+    if (!--m_count) {
+      // A dispatcher may have observed our reservation, we must stand in for its notification
+      std::lock_guard<std::mutex> lk(m_dispatchLock);
+      m_queueUpdated.notify_all();
+    }
+    delete thunk;
+    return false;
+  }
+
+  DispatchThunkBase* pPrior = m_pInbox.load(std::memory_order_relaxed);
+  do thunk->m_pFlink = pPrior;
+  while (!m_pInbox.compare_exchange_weak(pPrior, thunk, std::memory_order_seq_cst, std::memory_order_relaxed));
+
+  if (m_inboxClosed.load(std::memory_order_seq_cst)) {
+    // Our place was reserved before the queue was aborted, but Abort may have emptied the inbox
+    // before we pushed to it
+    DumpInbox();
+    return true;
+  }
+
+  // Waiters increment m_nWaiting before checking the inbox, so either they will see this entry or
+  // we will see them.  If the inbox was not empty, whoever made it nonempty has woken them already.
+  if (!pPrior && m_nWaiting.load(std::memory_order_seq_cst)) {
+    std::lock_guard<std::mutex> lk(m_dispatchLock);
+    m_queueUpdated.notify_all();
+  }
+
+  // Notification as needed:
+  OnPended(std::unique_lock<std::mutex>{});
+  return true;
+}
+
+void DispatchQueue::DumpInbox(void) {
+  size_t nDumped = 0;
+  for (auto cur = m_pInbox.exchange(nullptr, std::memory_order_seq_cst); cur; nDumped++) {
+    auto next = cur->m_pFlink;
+    delete cur;
+    cur = next;
+  }
+  if (!nDumped)
+    return;
+
+  // Anyone in Barrier is waiting for the count to reach zero
+  m_count -= nDumped;
+  std::lock_guard<std::mutex> lk(m_dispatchLock);
+  m_queueUpdated.notify_all();
 }
 
 bool DispatchQueue::PromoteReadyDispatchersUnsafe(void) {
+  // Anything in the inbox was pended before these elements became ready
+  bool drained = DrainInboxUnsafe();
+
+  if (m_timerWheel) {
+    size_t nPromoted = m_timerWheel->PopReady(std::chrono::steady_clock::now(), m_pHead, m_pTail);
+    m_count += nPromoted;
+    return drained || nPromoted;
+  }
+
   // Move all ready elements out of the delayed queue and into the dispatch queue:
   size_t nInitial = m_delayedQueue.size();
 
@@ -50,7 +148,7 @@ bool DispatchQueue::PromoteReadyDispatchersUnsafe(void) {
   }
 
   // Something was promoted if the dispatch queue size is different
-  return nInitial != m_delayedQueue.size();
+  return drained || nInitial != m_delayedQueue.size();
 }
 
 void DispatchQueue::DispatchEventUnsafe(std::unique_lock<std::mutex>& lk) {
@@ -64,13 +162,92 @@ void DispatchQueue::DispatchEventUnsafe(std::unique_lock<std::mutex>& lk) {
   MakeAtExit([&] {
     if (!--m_count) {
       // Notify that we have hit zero:
-      std::lock_guard<std::mutex>{ *lk.mutex() };
+      std::lock_guard<std::mutex> notifyLock(*lk.mutex());
       m_queueUpdated.notify_all();
     }
   }),
   (*thunk)();
 }
 
+size_t DispatchQueue::DispatchEventsUnsafe(std::unique_lock<std::mutex>& lk, size_t maxEvents, bool interruptible) {
+  // Detach the batch while we hold the lock, all of it at once if we can
+  DispatchThunkBase* pBatch = m_pHead;
+  if (maxEvents == ~size_t(0))
+    m_pHead = nullptr;
+  else {
+    DispatchThunkBase* pLast = pBatch;
+    for (size_t i = 1; i < maxEvents && pLast->m_pFlink; i++)
+      pLast = pLast->m_pFlink;
+    m_pHead = pLast->m_pFlink;
+    pLast->m_pFlink = nullptr;
+  }
+  lk.unlock();
+
+  // Counts are decremented one at a time, so that the queue length includes the batch until it is run
+  auto decrement = [&] {
+    if (!--m_count) {
+      // Notify that we have hit zero:
+      std::lock_guard<std::mutex> notifyLock(*lk.mutex());
+      m_queueUpdated.notify_all();
+    }
+  };
+
+  // Remainder of the batch when a dispatcher throws or the queue is aborted
+  auto dump = [&] {
+    for (; pBatch; decrement()) {
+      std::unique_ptr<DispatchThunkBase> thunk(pBatch);
+      pBatch = thunk->m_pFlink;
+    }
+  };
+
+  // Whatever remains of the batch goes back to the front of the queue, where it was detached
+  auto requeue = [&] {
+    lk.lock();
+    if (onAborted) {
+      lk.unlock();
+      dump();
+      return;
+    }
+
+    DispatchThunkBase* pLast = pBatch;
+    while (pLast->m_pFlink)
+      pLast = pLast->m_pFlink;
+    if (!m_pHead)
+      m_pTail = pLast;
+    pLast->m_pFlink = m_pHead;
+    m_pHead = pBatch;
+    pBatch = nullptr;
+    lk.unlock();
+  };
+
+  size_t nDispatched = 0;
+  while (pBatch) {
+    if (onAborted) {
+      // A dispatcher aborted the queue, nothing else may be run
+      dump();
+      break;
+    }
+
+    std::unique_ptr<DispatchThunkBase> thunk(pBatch);
+    pBatch = thunk->m_pFlink;
+    try {
+      MakeAtExit(decrement),
+      (*thunk)();
+    }
+    catch (...) {
+      if (pBatch)
+        requeue();
+      throw;
+    }
+    nDispatched++;
+
+    if (pBatch && interruptible && ShouldInterruptBatch())
+      // Our owner wants control back, the rest of the batch stays visible in the queue
+      requeue();
+  }
+  return nDispatched;
+}
+
 void DispatchQueue::TryDispatchEventUnsafe(std::unique_lock<std::mutex>& lk) {
   // Pull the ready thunk off of the front of the queue and pop it while we hold the lock.
   // Then, we will excecute the call while the lock has been released so we do not create
@@ -90,7 +267,7 @@ void DispatchQueue::TryDispatchEventUnsafe(std::unique_lock<std::mutex>& lk) {
 
   if (!--m_count) {
     // Notify that we have hit zero:
-    std::lock_guard<std::mutex>{ *lk.mutex() };
+    std::lock_guard<std::mutex> notifyLock(*lk.mutex());
     m_queueUpdated.notify_all();
   }
   delete pThunk;
@@ -101,6 +278,11 @@ void DispatchQueue::Abort(void) {
   DispatchThunkBase* pHead;
   {
     std::lock_guard<std::mutex> lk(m_dispatchLock);
+
+    // Producers which reserved their place before the cap below was lowered may still be pushing to
+    // the inbox.  Those that push after this drain see that the inbox is closed and dump it.
+    m_inboxClosed = true;
+    DrainInboxUnsafe();
     onAborted();
     m_dispatchCap = 0;
     pHead = m_pHead;
@@ -131,11 +313,15 @@ bool DispatchQueue::Cancel(void) {
   std::unique_ptr<DispatchThunkBase> thunk;
 
   std::lock_guard<std::mutex> lk(m_dispatchLock);
-  if(m_pHead) {
+  if(m_pHead || DrainInboxUnsafe()) {
     // Found a ready thunk, run from here:
     thunk.reset(m_pHead);
     m_pHead = thunk->m_pFlink;
   }
+  else if (m_timerWheel) {
+    thunk = m_timerWheel->RemoveEarliest();
+    return thunk != nullptr;
+  }
   else if (!m_delayedQueue.empty()) {
     auto& f = m_delayedQueue.top();
     thunk = std::move(f.GetThunk());
@@ -148,18 +334,51 @@ bool DispatchQueue::Cancel(void) {
   return true;
 }
 
+bool DispatchQueue::Cancel(DispatchHandle handle) {
+  // Holds the cancelled thunk, declared here so that we delete it out of the lock
+  std::unique_ptr<DispatchThunkBase> thunk;
+  if (!handle)
+    return false;
+
+  std::lock_guard<std::mutex> lk(m_dispatchLock);
+  if (m_timerWheel) {
+    thunk = m_timerWheel->Remove(handle.id);
+    return thunk != nullptr;
+  }
+
+  // The priority queue cannot remove an arbitrary element, it must be rebuilt without it
+  std::vector<DispatchThunkDelayed> retained;
+  retained.reserve(m_delayedQueue.size());
+  for (; !m_delayedQueue.empty(); m_delayedQueue.pop()) {
+    auto& top = m_delayedQueue.top();
+    if (top.GetId() == handle.id)
+      thunk = std::move(top.GetThunk());
+    else
+      retained.emplace_back(top.GetReadyTime(), top.GetThunk().release(), top.GetId());
+  }
+  for (auto& cur : retained)
+    m_delayedQueue.push(std::move(cur));
+  return thunk != nullptr;
+}
+
 void DispatchQueue::WakeAllWaitingThreads(void) {
   m_version++;
   m_queueUpdated.notify_all();
 }
 
 void DispatchQueue::WaitForEvent(void) {
+  WaitForEvents(1);
+}
+
+size_t DispatchQueue::WaitForEvents(size_t maxEvents) {
   std::unique_lock<std::mutex> lk(m_dispatchLock);
   if (onAborted)
     throw dispatch_aborted_exception("Dispatch queue was aborted prior to waiting for an event");
 
   // Unconditional delay:
   uint64_t version = m_version;
+  m_nWaiting++;
+  auto waiting = MakeAtExit([this] { m_nWaiting--; });
   m_queueUpdated.wait(
     lk,
     [this, version] {
@@ -168,26 +387,40 @@ void DispatchQueue::WaitForEvent(void) {
 
       return
         // We will need to transition out if the delay queue receives any items:
-        !this->m_delayedQueue.empty() ||
+        this->HasDelayedUnsafe() ||
 
         // We also transition out if the dispatch queue has any events:
         this->m_pHead ||
+        this->DrainInboxUnsafe() ||
 
         // Or, finally, if the versions don't match
         version != m_version;
     }
   );
 
-  if (m_pHead) {
-    // We have an event, we can just hop over to this variant:
+  if (!m_pHead && HasDelayedUnsafe())
+    // The delay queue has items but the dispatch queue does not, we need to switch
+    // to the suggested sleep timeout variant:
+    WaitForReadyUnsafe(lk, SuggestSoonestWakeupTimeUnsafe(std::chrono::steady_clock::time_point::max()));
+
+  if (!m_pHead)
+    return 0;
+  if (maxEvents == 1) {
     DispatchEventUnsafe(lk);
-    return;
+    return 1;
   }
+  return DispatchEventsUnsafe(lk, maxEvents, true);
+}
 
-  if (!m_delayedQueue.empty())
-    // The delay queue has items but the dispatch queue does not, we need to switch
-    // to the suggested sleep timeout variant:
-    WaitForEventUnsafe(lk, m_delayedQueue.top().GetReadyTime());
+size_t DispatchQueue::WaitForEvents(size_t maxEvents, std::chrono::steady_clock::time_point wakeTime) {
+  std::unique_lock<std::mutex> lk(m_dispatchLock);
+  if (!WaitForReadyUnsafe(lk, wakeTime))
+    return 0;
+  if (maxEvents == 1) {
+    DispatchEventUnsafe(lk);
+    return 1;
+  }
+  return DispatchEventsUnsafe(lk, maxEvents, true);
 }
 
 bool DispatchQueue::WaitForEvent(std::chrono::milliseconds milliseconds) {
@@ -204,16 +437,26 @@ bool DispatchQueue::WaitForEvent(std::chrono::steady_clock::time_point wakeTime)
 }
 
 bool DispatchQueue::WaitForEventUnsafe(std::unique_lock<std::mutex>& lk, std::chrono::steady_clock::time_point wakeTime) {
+  if (!WaitForReadyUnsafe(lk, wakeTime))
+    return false;
+
+  DispatchEventUnsafe(lk);
+  return true;
+}
+
+bool DispatchQueue::WaitForReadyUnsafe(std::unique_lock<std::mutex>& lk, std::chrono::steady_clock::time_point wakeTime) {
   if (onAborted)
     throw dispatch_aborted_exception("Dispatch queue was aborted prior to waiting for an event");
 
-  while (!m_pHead) {
+  m_nWaiting++;
+  auto waiting = MakeAtExit([this] { m_nWaiting--; });
+  while (!m_pHead && !DrainInboxUnsafe()) {
     // Derive a wakeup time using the high precision timer:
-    wakeTime = SuggestSoonestWakeupTimeUnsafe(wakeTime);
+    auto suggested = SuggestSoonestWakeupTimeUnsafe(wakeTime);
 
     // Now we wait, either for the timeout to elapse or for the dispatch queue itself to
     // transition to the "aborted" state.
-    std::cv_status status = m_queueUpdated.wait_until(lk, wakeTime);
+    std::cv_status status = m_queueUpdated.wait_until(lk, suggested);
 
     // Short-circuit if the queue was aborted
     if (onAborted)
@@ -223,12 +466,10 @@ bool DispatchQueue::WaitForEventUnsafe(std::unique_lock<std::mutex>& lk, std::ch
       // Dispatcher is ready to run!  Exit our loop and dispatch an event
       break;
 
-    if (status == std::cv_status::timeout)
+    if (status == std::cv_status::timeout && suggested == wakeTime)
       // Can't proceed, queue is empty and nobody is ready to be run
       return false;
   }
-
-  DispatchEventUnsafe(lk);
   return true;
 }
 
@@ -256,12 +497,20 @@ bool DispatchQueue::TryDispatchEvent(void) {
 
 int DispatchQueue::DispatchAllEvents(void) {
   int retVal = 0;
-  while(DispatchEvent())
-    retVal++;
-  return retVal;
+  for (;;) {
+    std::unique_lock<std::mutex> lk(m_dispatchLock);
+    if (!m_pHead && !PromoteReadyDispatchersUnsafe())
+      return retVal;
+
+    // Events pended while this batch runs will be picked up by the next one
+    retVal += static_cast<int>(DispatchEventsUnsafe(lk, ~size_t(0), false));
+  }
 }
 
 void DispatchQueue::PendExisting(std::unique_lock<std::mutex>&& lk, DispatchThunkBase* thunk) {
+  // Entries still in the inbox were pended before this one
+  DrainInboxUnsafe();
+
   // Count must be separately maintained:
   m_count++;
 
@@ -300,7 +549,7 @@ bool DispatchQueue::Barrier(std::chrono::nanoseconds timeout) {
   auto lambda = [complete] { *complete = true; };
   PendExisting(
     std::move(lk),
-    new DispatchThunk<decltype(lambda)>(std::move(lambda))
+    new (*m_thunkPool) DispatchThunk<decltype(lambda)>(std::move(lambda))
   );
   if (!lk.owns_lock())
     lk.lock();
@@ -329,6 +578,10 @@ void DispatchQueue::Barrier(void) {
 
 std::chrono::steady_clock::time_point
 DispatchQueue::SuggestSoonestWakeupTimeUnsafe(std::chrono::steady_clock::time_point latestTime) const {
+  if (m_timerWheel)
+    // The timer wheel may report an earlier time than the soonest ready time, which is still a valid suggestion
+    return std::min(m_timerWheel->NextReadyTime(), latestTime);
+
   return
     m_delayedQueue.empty() ?
 
@@ -345,6 +598,8 @@ DispatchQueue::SuggestSoonestWakeupTimeUnsafe(std::chrono::steady_clock::time_po
 
 void DispatchQueue::operator+=(DispatchQueue&& rhs) {
   std::unique_lock<std::mutex> lk(m_dispatchLock);
+  DrainInboxUnsafe();
+  rhs.DrainInboxUnsafe();
 
   // Append thunks to our queue
   if (m_pHead)
@@ -361,9 +616,12 @@ void DispatchQueue::operator+=(DispatchQueue&& rhs) {
   rhs.m_count = 0;
 
   // Append delayed thunks
+  if (rhs.m_timerWheel)
+    for (auto& cur : rhs.m_timerWheel->ReleaseAll())
+      PendDelayedUnsafe(std::move(cur));
   while (!rhs.m_delayedQueue.empty()) {
     const auto& top = rhs.m_delayedQueue.top();
-    m_delayedQueue.emplace(top.GetReadyTime(), top.GetThunk().release());
+    PendDelayedUnsafe(DispatchThunkDelayed(top.GetReadyTime(), top.GetThunk().release()));
     rhs.m_delayedQueue.pop();
   }
 
@@ -376,16 +634,41 @@ DispatchQueue::DispatchThunkDelayedExpressionAbs DispatchQueue::operator+=(std::
   return{this, rhs};
 }
 
-void DispatchQueue::operator+=(DispatchThunkDelayed&& rhs) {
+DispatchHandle DispatchQueue::operator+=(DispatchThunkDelayed&& rhs) {
   bool shouldNotify;
+  DispatchHandle handle;
   {
     std::lock_guard<std::mutex> lk(m_dispatchLock);
-    m_delayedQueue.push(std::forward<DispatchThunkDelayed>(rhs));
-    shouldNotify = m_delayedQueue.top().GetReadyTime() == rhs.GetReadyTime() && !m_count;
+    auto readyAt = rhs.GetReadyTime();
+    shouldNotify = readyAt < SuggestSoonestWakeupTimeUnsafe(std::chrono::steady_clock::time_point::max()) && !m_count;
+    handle = PendDelayedUnsafe(std::forward<DispatchThunkDelayed>(rhs));
   }
 
   if(shouldNotify)
     // We're becoming the new next-to-execute entity, dispatch queue currently empty, trigger wakeup
     // so our newly pended delay thunk is eventually processed.
     m_queueUpdated.notify_all();
+  return handle;
+}
+
+DispatchHandle DispatchQueue::PendDelayedUnsafe(DispatchThunkDelayed&& thunk) {
+  DispatchHandle handle(m_nextDelayedId++);
+  thunk.SetId(handle.id);
+  if (m_timerWheel)
+    m_timerWheel->Insert(std::move(thunk));
+  else
+    m_delayedQueue.push(std::move(thunk));
+  return handle;
+}
+
+void DispatchQueue::EnableTimerWheel(std::chrono::steady_clock::duration resolution) {
+  std::lock_guard<std::mutex> lk(m_dispatchLock);
+  if (m_timerWheel)
+    return;
+
+  m_timerWheel.reset(new DispatchTimerWheel(resolution));
+  for (; !m_delayedQueue.empty(); m_delayedQueue.pop()) {
+    const auto& top = m_delayedQueue.top();
+    m_timerWheel->Insert(DispatchThunkDelayed(top.GetReadyTime(), top.GetThunk().release(), top.GetId()));
+  }
 }
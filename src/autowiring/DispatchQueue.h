@@ -2,6 +2,7 @@
 #pragma once
 #include "dispatch_aborted_exception.h"
 #include "DispatchThunk.h"
+#include "DispatchTimerWheel.h"
 #include "once.h"
 #include <atomic>
 #include <queue>
@@ -39,7 +40,7 @@ public:
 
 protected:
   // The maximum allowed number of pended dispatches before pended calls start getting dropped
-  size_t m_dispatchCap = 1024;
+  std::atomic<size_t> m_dispatchCap{1024};
 
   // Current linked list length
   std::atomic<size_t> m_count{0};
@@ -51,9 +52,34 @@ protected:
   autowiring::DispatchThunkBase* m_pHead = nullptr;
   autowiring::DispatchThunkBase* m_pTail = nullptr;
 
+  // True if operator+= pends to m_pInbox rather than taking the dispatch lock
+  bool m_inboxEnabled = false;
+
+  // Lock-free stack of dispatchers pended by operator+= which have not yet been moved to the dispatch
+  // queue.  Entries are pushed by any thread, and are linked newest-first via m_pFlink.
+  std::atomic<autowiring::DispatchThunkBase*> m_pInbox{nullptr};
+
+  // The number of threads waiting for an event.  Producers only need to wake a waiter when this is nonzero.
+  // Waiters increment this before they check m_pInbox, and producers push to m_pInbox before they check
+  // this, all with sequentially consistent operations, so that one side always sees the other.
+  std::atomic<size_t> m_nWaiting{0};
+
+  // Set by Abort before it empties m_pInbox.  A producer that pushed to the inbox afterwards, having
+  // reserved its place before the abort, must empty the inbox itself.
+  std::atomic<bool> m_inboxClosed{false};
+
+  // Storage for the thunks created by this queue
+  autowiring::DispatchThunkPool* const m_thunkPool = new autowiring::DispatchThunkPool;
+
   // Priority queue of non-ready events:
   std::priority_queue<autowiring::DispatchThunkDelayed> m_delayedQueue;
 
+  // Timer wheel holding non-ready events in place of m_delayedQueue, if enabled
+  std::unique_ptr<autowiring::DispatchTimerWheel> m_timerWheel;
+
+  // Identifier to be assigned to the next delayed event
+  uint64_t m_nextDelayedId = 1;
+
   // A lock held when the dispatch queue must be updated:
   std::mutex m_dispatchLock;
 
@@ -61,9 +87,50 @@ protected:
   std::condition_variable m_queueUpdated;
 
   /// <summary>
-  /// Moves all ready events from the delayed queue into the dispatch queue
+  /// Moves all dispatchers in the inbox to the end of the dispatch queue, in the order they were pended
+  /// </summary>
+  /// <returns>True if at least one dispatcher was moved</returns>
+  bool DrainInboxUnsafe(void);
+
+  /// <summary>
+  /// Pends a dispatcher to the inbox without taking the dispatch lock
+  /// </summary>
+  /// <returns>False if the dispatcher was deleted because the dispatch cap was reached</returns>
+  bool PendInbox(autowiring::DispatchThunkBase* thunk);
+
+  /// <summary>
+  /// Causes operator+= to pend dispatchers without taking the dispatch lock
+  /// </summary>
+  /// <remarks>
+  /// Pended dispatchers are pushed to a lock-free list, which is moved to the dispatch queue by whichever thread
+  /// next dispatches an event.  The dispatch lock is only taken by a pending thread when a thread is waiting for
+  /// an event and must be woken up.  Barrier, Abort, and the dispatch cap behave as they do otherwise.
+  ///
+  /// When enabled, OnPended is not synchronized with the addition of a dispatcher by operator+=, so this mode is
+  /// not suitable for derived types whose OnPended override examines the dispatch queue.  This method must be
+  /// called before any dispatchers are pended.
+  /// </remarks>
+  void EnableInbox(void) { m_inboxEnabled = true; }
+
+  /// <summary>
+  /// Deletes everything in the inbox of an aborted queue, and removes it from the queue length
+  /// </summary>
+  void DumpInbox(void);
+
+  /// <returns>True if there are any non-ready events</returns>
+  bool HasDelayedUnsafe(void) const {
+    return m_timerWheel ? !m_timerWheel->empty() : !m_delayedQueue.empty();
+  }
+
+  /// <summary>
+  /// Assigns an identifier to the delayed event and adds it to the delayed queue
+  /// </summary>
+  autowiring::DispatchHandle PendDelayedUnsafe(autowiring::DispatchThunkDelayed&& thunk);
+
+  /// <summary>
+  /// Moves the inbox and then all ready events from the delayed queue into the dispatch queue
   /// </summary>
-  /// <returns>True if at least one dispatcher was promoted</returns>
+  /// <returns>True if at least one dispatcher was moved</returns>
   bool PromoteReadyDispatchersUnsafe(void);
 
   /// <summary>
@@ -76,6 +143,29 @@ protected:
   /// </remarks>
   void DispatchEventUnsafe(std::unique_lock<std::mutex>& lk);
 
+  /// <summary>
+  /// Similar to DispatchEventUnsafe, but dispatches up to the specified number of ready events
+  /// </summary>
+  /// <param name="lk">A lock on m_dispatchLock, which will be released</param>
+  /// <param name="maxEvents">The maximum number of events to dispatch</param>
+  /// <param name="interruptible">True if ShouldInterruptBatch should be consulted after each event</param>
+  /// <returns>The number of events dispatched</returns>
+  /// <remarks>
+  /// The events are detached from the queue with a single acquisition of the dispatch lock and are run
+  /// outside of the lock.  If an event throws, or if the batch is interrupted, the remainder of the batch
+  /// is returned to the front of the queue.  If the queue is aborted by one of the events, the remainder
+  /// of the batch is deleted without being run.
+  ///
+  /// This method assumes that the dispatch lock is held and that the dispatch queue is not empty.
+  /// </remarks>
+  size_t DispatchEventsUnsafe(std::unique_lock<std::mutex>& lk, size_t maxEvents, bool interruptible);
+
+  /// <summary>
+  /// Waits until an event is ready to be dispatched or the specified time is reached
+  /// </summary>
+  /// <returns>True if an event is ready to be dispatched</returns>
+  bool WaitForReadyUnsafe(std::unique_lock<std::mutex>& lk, std::chrono::steady_clock::time_point wakeTime);
+
   /// <summary>
   /// Similar to TryDispatchEvent, except assumes that the dispatch lock is currently held
   /// </summary>
@@ -96,11 +186,20 @@ protected:
   /// </remarks>
   virtual void OnPended(std::unique_lock<std::mutex>&& lk) {}
 
+  /// <summary>
+  /// Utility virtual, called by WaitForEvents after each event in a batch is run
+  /// </summary>
+  /// <returns>True if the rest of the batch should be returned to the queue rather than run now</returns>
+  /// <remarks>
+  /// This method is called without the dispatch lock held.  The base implementation never interrupts.
+  /// </remarks>
+  virtual bool ShouldInterruptBatch(void) const { return false; }
+
   template<class _Fx>
   void Pend(_Fx&& fx) {
     PendExisting(
       std::unique_lock<std::mutex>(m_dispatchLock),
-      new autowiring::DispatchThunk<_Fx>(std::forward<_Fx&&>(fx))
+      new (*m_thunkPool) autowiring::DispatchThunk<_Fx>(std::forward<_Fx&&>(fx))
     );
   }
 
@@ -118,7 +217,12 @@ public:
   /// <returns>
   /// True if there are curerntly any dispatchers ready for execution--IE, DispatchEvent would return true
   /// </returns>
-  bool AreAnyDispatchersReady(void) const { return !!m_pHead; }
+  /// <remarks>
+  /// Events in a batch which is currently being run by WaitForEvents or DispatchAllEvents have already been
+  /// detached from the queue, and are not considered ready by this method, although they are still counted
+  /// by GetDispatchQueueLength until they are run.
+  /// </remarks>
+  bool AreAnyDispatchersReady(void) const { return m_pHead || m_pInbox; }
 
   /// <returns>
   /// The total number of all ready and delayed events
@@ -128,7 +232,24 @@ public:
   /// this method from within a dispatcher, or from that dispatcher's destructor, should always return a size of at
   /// least 1.
   /// </remarks>
-  size_t GetDispatchQueueLength(void) const {return m_count + m_delayedQueue.size();}
+  size_t GetDispatchQueueLength(void) const {
+    return m_count + (m_timerWheel ? m_timerWheel->size() : m_delayedQueue.size());
+  }
+
+  /// <summary>
+  /// Causes delayed dispatchers to be held in a hierarchical timer wheel rather than in a priority queue
+  /// </summary>
+  /// <param name="resolution">The granularity with which the wheel tracks time</param>
+  /// <remarks>
+  /// Pending and cancelling a delayed dispatcher take constant time with the timer wheel, rather than time
+  /// logarithmic and linear in the number of delayed dispatchers, respectively.  This is recommended for queues
+  /// which hold many delayed dispatchers at once, such as those used for periodic work or timeouts.  Delayed
+  /// dispatchers which become ready in the same resolution interval are dispatched in the order they were pended,
+  /// rather than in the order of their ready times.
+  ///
+  /// Delayed dispatchers already on the queue are moved to the timer wheel.  Calling this method again has no effect.
+  /// </remarks>
+  void EnableTimerWheel(std::chrono::steady_clock::duration resolution = std::chrono::milliseconds(1));
 
   /// <summary>
   /// Causes the current dispatch queue to be dumped if it's non-empty
@@ -151,14 +272,28 @@ public:
   /// True if a lambda was cancelled, false if the queue was empty when the cancellation attempt was made
   /// </returns>
   /// <remarks>
-  /// This method cannot cancel lambdas that are already being dispatched.  As a result, it's possible for
-  /// this function to return zero even if the dispatch queue length is nonzero before and after the call.
+  /// This method cannot cancel lambdas that are already being dispatched, including the rest of a batch that
+  /// is being run by WaitForEvents or DispatchAllEvents.  As a result, it's possible for this function to
+  /// return zero even if the dispatch queue length is nonzero before and after the call.
   ///
   /// Lambdas are cancelled in the order they are pended.  If there are no lambdas ready to execute, then
   /// deferred lambdas will be cancelled in the order they are scheduled to run.
   /// </remarks>
   bool Cancel(void);
 
+  /// <summary>
+  /// Deletes the delayed lambda identified by the passed handle without running it
+  /// </summary>
+  /// <returns>
+  /// True if the lambda was cancelled, false if it is no longer delayed
+  /// </returns>
+  /// <remarks>
+  /// A lambda that has become ready to run can no longer be cancelled by its handle, even if it has not yet
+  /// been dispatched.  This method takes constant time if the timer wheel is enabled, and otherwise takes
+  /// time linear in the number of delayed lambdas.
+  /// </remarks>
+  bool Cancel(autowiring::DispatchHandle handle);
+
   /// <summary>
   /// Causes all calls to WaitForEvent to return control to their callers
   /// </summary>
@@ -200,6 +335,12 @@ public:
   /// Similar to DispatchEvent, but will attempt to dispatch all events currently queued
   /// </summary>
   /// <returns>The total number of events dispatched</returns>
+  /// <remarks>
+  /// All ready events are detached from the queue at once, so the dispatch lock is acquired once per batch
+  /// rather than once per event.  Events pended while a batch is running are dispatched in a later batch.
+  /// If an event throws, the events which followed it remain in the queue.  This method does not consult
+  /// ShouldInterruptBatch, it always runs the queue down.
+  /// </remarks>
   int DispatchAllEvents(void);
 
   /// <summary>
@@ -211,6 +352,29 @@ public:
   /// </remarks>
   void WaitForEvent(void);
 
+  /// <summary>
+  /// Waits until a lambda function is ready to run in this thread's dispatch queue, and then dispatches
+  /// ready lambda functions in a single batch
+  /// </summary>
+  /// <param name="maxEvents">The maximum number of lambda functions to dispatch</param>
+  /// <returns>The number of lambda functions dispatched, which may be zero if the wait was interrupted</returns>
+  /// <remarks>
+  /// This method behaves like WaitForEvent, except that it detaches up to maxEvents ready lambdas with one
+  /// acquisition of the dispatch lock.  It will throw dispatch_aborted_exception if the queue has been aborted
+  /// at the time of the call.
+  ///
+  /// Until they are run, the lambdas in the batch cannot be removed by Cancel and are not reported by
+  /// AreAnyDispatchersReady.  ShouldInterruptBatch is checked after each lambda, and if it returns true,
+  /// the lambdas which have not yet been run are returned to the front of the queue.
+  /// </remarks>
+  size_t WaitForEvents(size_t maxEvents = ~size_t(0));
+
+  /// <summary>
+  /// Similar to WaitForEvents, but gives up if no lambda function is ready by the specified time
+  /// </summary>
+  /// <returns>The number of lambda functions dispatched, which will be zero if the time was reached</returns>
+  size_t WaitForEvents(size_t maxEvents, std::chrono::steady_clock::time_point wakeTime);
+
   /// <summary>
   /// Waits until a lambda function in the dispatch queue is ready to run or the specified
   /// time period elapses, whichever comes first.
@@ -294,16 +458,18 @@ public:
     const std::chrono::microseconds m_delay;
 
   public:
+    /// <returns>A handle which may be used to cancel the lambda, empty if the lambda was pended without delay</returns>
     template<class _Fx>
-    void operator,(_Fx&& fx) {
+    autowiring::DispatchHandle operator,(_Fx&& fx) {
       // Let the parent handle this one directly after composing a delayed dispatch thunk r-value
       if (m_delay.count())
-        *m_pParent += autowiring::DispatchThunkDelayed(
+        return *m_pParent += autowiring::DispatchThunkDelayed(
           std::chrono::steady_clock::now() + m_delay,
-          new autowiring::DispatchThunk<_Fx>(std::forward<_Fx&&>(fx))
+          new (*m_pParent->m_thunkPool) autowiring::DispatchThunk<_Fx>(std::forward<_Fx&&>(fx))
         );
-      else
-        *m_pParent += std::forward<_Fx&&>(fx);
+
+      *m_pParent += std::forward<_Fx&&>(fx);
+      return{};
     }
   };
 
@@ -319,12 +485,13 @@ public:
     const std::chrono::steady_clock::time_point m_wakeup;
 
   public:
+    /// <returns>A handle which may be used to cancel the lambda</returns>
     template<class _Fx>
-    void operator,(_Fx&& fx) {
+    autowiring::DispatchHandle operator,(_Fx&& fx) {
       // Let the parent handle this one directly after composing a delayed dispatch thunk r-value
-      *m_pParent += autowiring::DispatchThunkDelayed(
+      return *m_pParent += autowiring::DispatchThunkDelayed(
         m_wakeup,
-        new autowiring::DispatchThunk<_Fx>(std::forward<_Fx>(fx))
+        new (*m_pParent->m_thunkPool) autowiring::DispatchThunk<_Fx>(std::forward<_Fx>(fx))
       );
     }
   };
@@ -332,6 +499,10 @@ public:
   /// <summary>
   /// Extracts the contents of the dispatch queue on the right-hand side for handling by this queue
   /// </summary>
+  /// <remarks>
+  /// Delayed dispatchers taken from the right-hand side are given new identifiers, so handles obtained
+  /// from the right-hand side can no longer be used to cancel them.
+  /// </remarks>
   void operator+=(DispatchQueue&& rhs);
 
   /// <summary>
@@ -361,10 +532,11 @@ public:
   /// <summary>
   /// Directly pends a delayed dispatch thunk
   /// </summary>
+  /// <returns>A handle which may be used to cancel the thunk</returns>
   /// <remarks>
   /// This overload will always succeed and does not consult the dispatch cap
   /// </remarks>
-  void operator+=(autowiring::DispatchThunkDelayed&& rhs);
+  autowiring::DispatchHandle operator+=(autowiring::DispatchThunkDelayed&& rhs);
 
   /// <summary>
   /// Generic overload which will pend an arbitrary dispatch type
@@ -375,7 +547,9 @@ public:
     static_assert(!std::is_pointer<_Fx>::value, "Cannot pend a pointer to a function, we must have direct ownership");
 
     // Create the thunk first to reduce the amount of time we spend in lock:
-    auto thunk = new autowiring::DispatchThunk<_Fx>(std::forward<_Fx>(fx));
+    auto thunk = new (*m_thunkPool) autowiring::DispatchThunk<_Fx>(std::forward<_Fx>(fx));
+    if (m_inboxEnabled)
+      return PendInbox(thunk);
 
     m_dispatchLock.lock();
     if (m_count >= m_dispatchCap) {
@@ -0,0 +1,112 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#include "stdafx.h"
+#include "DispatchThunk.h"
+#include THREAD_HEADER
+
+using namespace autowiring;
+
+static std::atomic<size_t> s_nHeapAllocations{0};
+
+namespace {
+  // Yields rather than spinning, the holder might be waiting for the processor we are on
+  struct Guard {
+    Guard(autowiring::spin_lock& lock) :
+      lock(lock)
+    {
+      while (!lock.try_lock())
+        std::this_thread::yield();
+    }
+    ~Guard(void) { lock.unlock(); }
+    autowiring::spin_lock& lock;
+  };
+
+  DispatchThunkPool::Header& HeaderOf(void* ptr) {
+    return *(static_cast<DispatchThunkPool::Header*>(ptr) - 1);
+  }
+}
+
+DispatchThunkPool::DispatchThunkPool(void) {
+  for (size_t i = 0; i < sc_inlineBlocks; i++) {
+    m_inline[i].header.pPool = this;
+    m_inline[i].pFlink = i + 1 < sc_inlineBlocks ? &m_inline[i + 1] : nullptr;
+  }
+  m_pFree = m_inline;
+}
+
+DispatchThunkPool::~DispatchThunkPool(void) {
+  for (Block* slab : m_slabs)
+    ::operator delete(slab);
+}
+
+DispatchThunkPool::Block* DispatchThunkPool::Allocate(void) {
+  m_nRefs++;
+  {
+    Guard lk(m_lock);
+    if (m_pFree) {
+      Block* retVal = m_pFree;
+      m_pFree = retVal->pFlink;
+      return retVal;
+    }
+  }
+
+  // Free list is empty, obtain a new slab.  The first block is ours, the rest are linked together
+  // outside of the lock and then attached all at once.
+  Block* slab = static_cast<Block*>(::operator new(sizeof(Block) * sc_slabBlocks));
+  s_nHeapAllocations++;
+  for (size_t i = 0; i < sc_slabBlocks; i++)
+    slab[i].header.pPool = this;
+  for (size_t i = 1; i < sc_slabBlocks - 1; i++)
+    slab[i].pFlink = &slab[i + 1];
+
+  Guard lk(m_lock);
+  m_slabs.push_back(slab);
+  slab[sc_slabBlocks - 1].pFlink = m_pFree;
+  m_pFree = &slab[1];
+  return slab;
+}
+
+void DispatchThunkPool::Free(Block* block) {
+  {
+    Guard lk(m_lock);
+    block->pFlink = m_pFree;
+    m_pFree = block;
+  }
+  Release();
+}
+
+void DispatchThunkPool::Release(void) {
+  if (!--m_nRefs)
+    delete this;
+}
+
+void* DispatchThunkBase::operator new(size_t size) {
+  auto header = static_cast<DispatchThunkPool::Header*>(::operator new(sizeof(DispatchThunkPool::Header) + size));
+  s_nHeapAllocations++;
+  header->pPool = nullptr;
+  return header + 1;
+}
+
+void* DispatchThunkBase::operator new(size_t size, DispatchThunkPool& pool) {
+  if (size > sc_blockSize)
+    return operator new(size);
+  return pool.Allocate()->storage;
+}
+
+void DispatchThunkBase::operator delete(void* ptr) {
+  if (!ptr)
+    return;
+
+  DispatchThunkPool::Header& header = HeaderOf(ptr);
+  if (header.pPool)
+    header.pPool->Free(reinterpret_cast<DispatchThunkPool::Block*>(&header));
+  else
+    ::operator delete(&header);
+}
+
+void DispatchThunkBase::operator delete(void* ptr, DispatchThunkPool&) {
+  operator delete(ptr);
+}
+
+size_t DispatchThunkBase::GetHeapAllocationCount(void) {
+  return s_nHeapAllocations;
+}
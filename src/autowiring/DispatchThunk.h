@@ -1,19 +1,108 @@
 // Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
 #pragma once
+#include "spin_lock.h"
+#include <atomic>
 #include CHRONO_HEADER
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 namespace autowiring {
 
+class DispatchThunkPool;
+
 /// <summary>
 /// A simple virtual class used to hold a trivial thunk
 /// </summary>
+/// <remarks>
+/// A thunk created by a dispatch queue is constructed in storage obtained from the pool of that
+/// queue.  Thunks no larger than sc_blockSize, which is any thunk whose callable is 48 bytes or
+/// smaller on 64-bit platforms, hold their callable inline in a block that goes back to the pool
+/// when the thunk is deleted, so pending a small lambda in the steady state performs no heap
+/// allocation.  Larger thunks, and thunks created anywhere else, are stored on the heap.
+/// </remarks>
 class DispatchThunkBase {
 public:
   virtual ~DispatchThunkBase(void){}
   virtual void operator()() = 0;
 
   DispatchThunkBase* m_pFlink = nullptr;
+
+  // The size of a pooled block
+  static const size_t sc_blockSize = 64;
+
+  static void* operator new(size_t size);
+  static void* operator new(size_t size, DispatchThunkPool& pool);
+  static void operator delete(void* ptr);
+  static void operator delete(void* ptr, DispatchThunkPool& pool);
+
+  /// <returns>The number of times storage for thunks has been obtained from the heap</returns>
+  /// <remarks>
+  /// Each slab of blocks obtained by a pool counts once, as does each thunk held on the heap.  This
+  /// value never decreases, and is intended for use in diagnostics and tests.
+  /// </remarks>
+  static size_t GetHeapAllocationCount(void);
+};
+
+/// <summary>
+/// Recycles blocks of storage for the thunks created by one dispatch queue
+/// </summary>
+/// <remarks>
+/// The first few blocks are held within the pool itself, further blocks are obtained from the heap
+/// a slab at a time.  A thunk may be deleted by a thread or queue other than the one that created
+/// it, so each block refers back to its pool, and the pool is not destroyed until its owner and
+/// every outstanding block have released it.  Slabs are returned to the heap at that point.
+/// </remarks>
+class DispatchThunkPool {
+public:
+  // Reference held by the creator, which must call Release rather than deleting the pool
+  DispatchThunkPool(void);
+
+  // The number of blocks held within the pool, and the number obtained with each heap allocation
+  static const size_t sc_inlineBlocks = 8;
+  static const size_t sc_slabBlocks = 32;
+
+  // Precedes every thunk, pooled or not, and identifies the pool to return the thunk to
+  union Header {
+    DispatchThunkPool* pPool;
+    std::max_align_t align;
+  };
+
+  struct Block {
+    Header header;
+    union {
+      Block* pFlink;
+      unsigned char storage[DispatchThunkBase::sc_blockSize];
+    };
+  };
+
+private:
+  ~DispatchThunkPool(void);
+
+  // Owner reference plus one reference per outstanding block
+  std::atomic<size_t> m_nRefs{1};
+
+  // Guards the free list and the slab list
+  autowiring::spin_lock m_lock;
+  Block* m_pFree = nullptr;
+  std::vector<Block*> m_slabs;
+
+  Block m_inline[sc_inlineBlocks];
+
+public:
+  /// <returns>An unused block</returns>
+  Block* Allocate(void);
+
+  /// <summary>
+  /// Returns a block obtained from Allocate to this pool
+  /// </summary>
+  void Free(Block* block);
+
+  /// <summary>
+  /// Releases a reference to this pool, destroying it if this was the last one
+  /// </summary>
+  void Release(void);
 };
 
 template<class _Fx>
@@ -37,6 +126,20 @@ std::unique_ptr<DispatchThunkBase> MakeDispatchThunk(Fx&& fx) {
   return std::unique_ptr<DispatchThunkBase>(new DispatchThunk<Fx>(std::forward<Fx&&>(fx)));
 }
 
+/// <summary>
+/// Identifies a delayed dispatcher pended to a DispatchQueue, so that it may later be cancelled
+/// </summary>
+struct DispatchHandle {
+  DispatchHandle(uint64_t id = 0) :
+    id(id)
+  {}
+
+  // Identifier assigned by the dispatch queue, or zero if this handle refers to nothing
+  uint64_t id;
+
+  explicit operator bool(void) const { return id != 0; }
+};
+
 /// <summary>
 /// A so-called "delayed" dispatch thunk which must not be executed prior to the specified time
 /// </summary>
@@ -49,24 +152,32 @@ public:
   /// When this dispatch thunk becomes ready, the associated thunk will be pushed to the back to the owning dispatch queue's
   /// ready queue.
   /// </remarks>
-  DispatchThunkDelayed(std::chrono::steady_clock::time_point readyAt, DispatchThunkBase* thunk) :
+  DispatchThunkDelayed(std::chrono::steady_clock::time_point readyAt, DispatchThunkBase* thunk, uint64_t id = 0) :
     m_readyAt(readyAt),
+    m_id(id),
     m_thunk(thunk)
   {}
 
   DispatchThunkDelayed(DispatchThunkDelayed&& rhs) :
     m_readyAt(rhs.m_readyAt),
+    m_id(rhs.m_id),
     m_thunk(std::move(rhs.m_thunk))
   {}
 
 private:
   // The time when the thunk becomes ready-to-execute
   std::chrono::steady_clock::time_point m_readyAt;
+
+  // Identifier assigned by the owning dispatch queue, used to cancel this thunk
+  uint64_t m_id;
+
   mutable std::unique_ptr<DispatchThunkBase> m_thunk;
 
 public:
   // Accessor methods:
   std::chrono::steady_clock::time_point GetReadyTime(void) const { return m_readyAt; }
+  uint64_t GetId(void) const { return m_id; }
+  void SetId(uint64_t id) { m_id = id; }
   std::unique_ptr<DispatchThunkBase>& GetThunk(void) const { return m_thunk; }
 
   /// <summary>
@@ -78,6 +189,7 @@ public:
 
   void operator=(DispatchThunkDelayed&& rhs) {
     m_readyAt = rhs.m_readyAt;
+    m_id = rhs.m_id;
     m_thunk = std::move(rhs.m_thunk);
   }
   void operator=(const DispatchThunkDelayed&) const = delete;
@@ -0,0 +1,250 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#include "stdafx.h"
+#include "DispatchTimerWheel.h"
+#include <algorithm>
+#include <assert.h>
+
+using namespace autowiring;
+
+static const uint64_t sc_innerSlots = 1 << DispatchTimerWheel::sc_innerBits;
+static const uint64_t sc_outerSlots = 1 << DispatchTimerWheel::sc_outerBits;
+
+DispatchTimerWheel::DispatchTimerWheel(std::chrono::steady_clock::duration resolution) :
+  m_resolution(resolution),
+  m_epoch(std::chrono::steady_clock::now())
+{
+  std::fill(std::begin(m_slots), std::end(m_slots), nullptr);
+  std::fill(std::begin(m_levelCount), std::end(m_levelCount), 0);
+}
+
+DispatchTimerWheel::~DispatchTimerWheel(void) {
+  for (auto& entry : m_entries) {
+    delete entry.second->thunk;
+    delete entry.second;
+  }
+  for (Entry* cur = m_pFree; cur;) {
+    Entry* next = cur->flink;
+    delete cur;
+    cur = next;
+  }
+}
+
+uint64_t DispatchTimerWheel::TickOf(std::chrono::steady_clock::time_point time) const {
+  if (time <= m_epoch)
+    return 0;
+  return static_cast<uint64_t>((time - m_epoch) / m_resolution);
+}
+
+void DispatchTimerWheel::Place(Entry* entry) {
+  // Thunks which are already overdue go into the current slot
+  uint64_t tick = std::max(entry->tick, m_current);
+  uint64_t delta = tick - m_current;
+
+  size_t index;
+  if (delta < sc_innerSlots) {
+    entry->level = 0;
+    index = tick & (sc_innerSlots - 1);
+  }
+  else {
+    // Find the innermost outer level which spans the delay
+    int level = 1;
+    int shift = sc_innerBits;
+    for (; level < sc_nOuterLevels && delta >= uint64_t(1) << (shift + sc_outerBits); level++)
+      shift += sc_outerBits;
+
+    // Too far out to be placed, hold it in the farthest slot until it can be
+    if (delta >= uint64_t(1) << (shift + sc_outerBits))
+      tick = m_current + (uint64_t(1) << (shift + sc_outerBits)) - 1;
+
+    entry->level = level;
+    index = sc_innerSlots + (level - 1) * sc_outerSlots + ((tick >> shift) & (sc_outerSlots - 1));
+  }
+
+  // Link at the back of the slot so that thunks in the same slot retain their order
+  Entry*& head = m_slots[index];
+  entry->slot = &head;
+  if (head) {
+    entry->flink = head;
+    entry->blink = head->blink;
+    head->blink->flink = entry;
+    head->blink = entry;
+  }
+  else
+    head = entry->flink = entry->blink = entry;
+  m_levelCount[entry->level]++;
+}
+
+void DispatchTimerWheel::Unlink(Entry* entry) {
+  Entry*& head = *entry->slot;
+  if (entry->flink == entry)
+    head = nullptr;
+  else {
+    entry->blink->flink = entry->flink;
+    entry->flink->blink = entry->blink;
+    if (head == entry)
+      head = entry->flink;
+  }
+  m_levelCount[entry->level]--;
+}
+
+void DispatchTimerWheel::Cascade(int level, size_t index) {
+  Entry*& head = m_slots[sc_innerSlots + (level - 1) * sc_outerSlots + index];
+  Entry* cur = head;
+  if (!cur)
+    return;
+
+  // Detach the whole slot before placing its entries, some of them may be placed back into it
+  head = nullptr;
+  cur->blink->flink = nullptr;
+  while (cur) {
+    Entry* next = cur->flink;
+    m_levelCount[level]--;
+    Place(cur);
+    cur = next;
+  }
+}
+
+DispatchThunkBase* DispatchTimerWheel::Retire(Entry* entry) {
+  DispatchThunkBase* thunk = entry->thunk;
+  m_entries.erase(entry->id);
+  entry->flink = m_pFree;
+  m_pFree = entry;
+  return thunk;
+}
+
+void DispatchTimerWheel::Release(Entry* entry, DispatchThunkBase*& pHead, DispatchThunkBase*& pTail) {
+  DispatchThunkBase* thunk = Retire(entry);
+  thunk->m_pFlink = nullptr;
+  if (pHead)
+    pTail->m_pFlink = thunk;
+  else
+    pHead = thunk;
+  pTail = thunk;
+}
+
+void DispatchTimerWheel::Insert(DispatchThunkDelayed&& thunk) {
+  assert(thunk.GetId() && !m_entries.count(thunk.GetId()));
+
+  Entry* entry = m_pFree;
+  if (entry)
+    m_pFree = entry->flink;
+  else
+    entry = new Entry;
+
+  entry->readyAt = thunk.GetReadyTime();
+  entry->tick = TickOf(entry->readyAt);
+  entry->id = thunk.GetId();
+  entry->thunk = thunk.GetThunk().release();
+  m_entries[entry->id] = entry;
+  Place(entry);
+}
+
+std::unique_ptr<DispatchThunkBase> DispatchTimerWheel::Remove(uint64_t id) {
+  auto q = m_entries.find(id);
+  if (q == m_entries.end())
+    return nullptr;
+
+  Entry* entry = q->second;
+  Unlink(entry);
+  return std::unique_ptr<DispatchThunkBase>(Retire(entry));
+}
+
+std::unique_ptr<DispatchThunkBase> DispatchTimerWheel::RemoveEarliest(void) {
+  Entry* earliest = nullptr;
+  for (auto& entry : m_entries)
+    if (!earliest || entry.second->readyAt < earliest->readyAt)
+      earliest = entry.second;
+  if (!earliest)
+    return nullptr;
+
+  Unlink(earliest);
+  return std::unique_ptr<DispatchThunkBase>(Retire(earliest));
+}
+
+std::chrono::steady_clock::time_point DispatchTimerWheel::NextReadyTime(void) const {
+  auto retVal = std::chrono::steady_clock::time_point::max();
+
+  // Outer levels can only tell us when they must next be cascaded, the innermost nonempty one is soonest
+  for (int level = 1, shift = sc_innerBits; level <= sc_nOuterLevels; level++, shift += sc_outerBits)
+    if (m_levelCount[level]) {
+      retVal = TimeOf(((m_current >> shift) + 1) << shift);
+      break;
+    }
+
+  // Slots on the innermost level each hold a single tick, so the first nonempty one is exact
+  if (m_levelCount[0])
+    for (uint64_t tick = m_current; tick < m_current + sc_innerSlots; tick++) {
+      const Entry* head = m_slots[tick & (sc_innerSlots - 1)];
+      if (!head)
+        continue;
+
+      const Entry* cur = head;
+      do retVal = std::min(retVal, cur->readyAt);
+      while ((cur = cur->flink) != head);
+      break;
+    }
+  return retVal;
+}
+
+size_t DispatchTimerWheel::PopReady(std::chrono::steady_clock::time_point now, DispatchThunkBase*& pHead, DispatchThunkBase*& pTail) {
+  size_t nReleased = 0;
+
+  for (uint64_t target = TickOf(now); m_current < target;) {
+    if (m_entries.empty()) {
+      // Nothing to cascade, the wheel may be turned all at once
+      m_current = target;
+      break;
+    }
+
+    // Everything in a slot prior to the target tick is ready
+    for (Entry*& head = m_slots[m_current & (sc_innerSlots - 1)]; head; nReleased++) {
+      Entry* entry = head;
+      Unlink(entry);
+      Release(entry, pHead, pTail);
+    }
+
+    // Skip ahead to the next cascade if the innermost level is empty
+    m_current =
+      m_levelCount[0] ?
+      m_current + 1 :
+      std::min(target, (m_current | (sc_innerSlots - 1)) + 1);
+    if (m_current & (sc_innerSlots - 1))
+      continue;
+
+    // Crossed a boundary, pull entries from the outer levels inward
+    size_t index = 0;
+    for (int level = 1, shift = sc_innerBits; level <= sc_nOuterLevels && !index; level++, shift += sc_outerBits) {
+      index = (m_current >> shift) & (sc_outerSlots - 1);
+      Cascade(level, index);
+    }
+  }
+
+  // The slot for the current tick may hold thunks which are not ready yet
+  Entry* head = m_slots[m_current & (sc_innerSlots - 1)];
+  if (head)
+    for (Entry *cur = head, *last = head->blink, *next;; cur = next) {
+      next = cur->flink;
+      if (cur->readyAt <= now) {
+        Unlink(cur);
+        Release(cur, pHead, pTail);
+        nReleased++;
+      }
+      if (cur == last)
+        break;
+    }
+  return nReleased;
+}
+
+std::vector<DispatchThunkDelayed> DispatchTimerWheel::ReleaseAll(void) {
+  std::vector<DispatchThunkDelayed> retVal;
+  retVal.reserve(m_entries.size());
+  for (auto& entry : m_entries) {
+    retVal.emplace_back(entry.second->readyAt, entry.second->thunk, entry.second->id);
+    entry.second->flink = m_pFree;
+    m_pFree = entry.second;
+  }
+  m_entries.clear();
+  std::fill(std::begin(m_slots), std::end(m_slots), nullptr);
+  std::fill(std::begin(m_levelCount), std::end(m_levelCount), 0);
+  return retVal;
+}
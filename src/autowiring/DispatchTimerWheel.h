@@ -0,0 +1,159 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#pragma once
+#include "DispatchThunk.h"
+#include CHRONO_HEADER
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace autowiring {
+
+/// <summary>
+/// A hierarchical timer wheel holding delayed dispatch thunks until they become ready
+/// </summary>
+/// <remarks>
+/// Time is divided into ticks of a fixed resolution.  The innermost level of the wheel has one slot for each of
+/// the next 256 ticks, and each of the three outer levels has 64 slots, each spanning an entire revolution of the
+/// level inside of it.  Thunks are inserted into the slot covering their ready time and are moved inward as the
+/// wheel turns, so insertion and removal by identifier are constant time operations regardless of the number of
+/// thunks held.  Thunks whose ready time lies beyond the outermost level are held in its farthest slot until
+/// they can be placed.
+///
+/// This type is not synchronized, DispatchQueue accesses it only while holding its dispatch lock.
+/// </remarks>
+class DispatchTimerWheel {
+public:
+  DispatchTimerWheel(std::chrono::steady_clock::duration resolution = std::chrono::milliseconds(1));
+  DispatchTimerWheel(const DispatchTimerWheel&) = delete;
+  ~DispatchTimerWheel(void);
+
+  // Number of bits used to index each level of the wheel
+  static const int sc_innerBits = 8;
+  static const int sc_outerBits = 6;
+  static const int sc_nOuterLevels = 3;
+
+private:
+  struct Entry {
+    // The time when the thunk becomes ready-to-execute, and the tick in which that time falls
+    std::chrono::steady_clock::time_point readyAt;
+    uint64_t tick;
+
+    // Identifier assigned by the owning dispatch queue
+    uint64_t id;
+
+    // The thunk proper, owned by this entry
+    DispatchThunkBase* thunk;
+
+    // The head of the slot holding this entry, and the level of that slot
+    Entry** slot;
+    int level;
+
+    // Slots are circular, doubly linked lists
+    Entry* flink;
+    Entry* blink;
+  };
+
+  const std::chrono::steady_clock::duration m_resolution;
+  const std::chrono::steady_clock::time_point m_epoch;
+
+  // The tick up to which the wheel has been turned
+  uint64_t m_current = 0;
+
+  // Slot heads, innermost level first
+  Entry* m_slots[(1 << sc_innerBits) + sc_nOuterLevels * (1 << sc_outerBits)];
+
+  // The number of entries on each level, used to skip empty levels when turning the wheel
+  size_t m_levelCount[1 + sc_nOuterLevels];
+
+  // All entries by identifier
+  std::unordered_map<uint64_t, Entry*> m_entries;
+
+  // Entries which are not in use, linked by flink
+  Entry* m_pFree = nullptr;
+
+  uint64_t TickOf(std::chrono::steady_clock::time_point time) const;
+  std::chrono::steady_clock::time_point TimeOf(uint64_t tick) const { return m_epoch + m_resolution * tick; }
+
+  /// <summary>
+  /// Links the entry into the slot appropriate for its tick relative to the current tick
+  /// </summary>
+  void Place(Entry* entry);
+
+  /// <summary>
+  /// Unlinks the entry from its slot
+  /// </summary>
+  void Unlink(Entry* entry);
+
+  /// <summary>
+  /// Moves all entries in the specified outer slot to slots appropriate for the current tick
+  /// </summary>
+  void Cascade(int level, size_t index);
+
+  /// <summary>
+  /// Moves the thunk held by the entry to the end of the passed list and recycles the entry
+  /// </summary>
+  void Release(Entry* entry, DispatchThunkBase*& pHead, DispatchThunkBase*& pTail);
+
+  /// <summary>
+  /// Recycles the entry and returns its thunk
+  /// </summary>
+  DispatchThunkBase* Retire(Entry* entry);
+
+public:
+  // Accessor methods:
+  std::chrono::steady_clock::duration GetResolution(void) const { return m_resolution; }
+  size_t size(void) const { return m_entries.size(); }
+  bool empty(void) const { return m_entries.empty(); }
+
+  /// <summary>
+  /// Adds a delayed thunk to the wheel
+  /// </summary>
+  /// <remarks>
+  /// The thunk must have an identifier that is nonzero and is not held by any other thunk on this wheel
+  /// </remarks>
+  void Insert(DispatchThunkDelayed&& thunk);
+
+  /// <summary>
+  /// Removes the thunk with the specified identifier from the wheel
+  /// </summary>
+  /// <returns>The removed thunk, or nullptr if no thunk with this identifier is on the wheel</returns>
+  std::unique_ptr<DispatchThunkBase> Remove(uint64_t id);
+
+  /// <summary>
+  /// Removes the thunk which will be ready soonest
+  /// </summary>
+  /// <returns>The removed thunk, or nullptr if the wheel is empty</returns>
+  /// <remarks>
+  /// Unlike Remove, this method is linear in the number of thunks on the wheel
+  /// </remarks>
+  std::unique_ptr<DispatchThunkBase> RemoveEarliest(void);
+
+  /// <returns>
+  /// A time no later than the time when the soonest thunk on the wheel will be ready
+  /// </returns>
+  /// <remarks>
+  /// The returned time is exact if a thunk will be ready within one revolution of the innermost level.
+  /// Otherwise, the time when the wheel next needs to be turned is returned.  If the wheel is empty, the
+  /// maximum time point is returned.
+  /// </remarks>
+  std::chrono::steady_clock::time_point NextReadyTime(void) const;
+
+  /// <summary>
+  /// Turns the wheel to the specified time and removes all thunks which are ready at that time
+  /// </summary>
+  /// <param name="pHead">The head of the list to which ready thunks are appended</param>
+  /// <param name="pTail">The tail of the list to which ready thunks are appended</param>
+  /// <returns>The number of thunks appended</returns>
+  /// <remarks>
+  /// Thunks are appended in the order of the ticks in which they become ready.  Thunks which become ready
+  /// in the same tick are appended in the order they were inserted.
+  /// </remarks>
+  size_t PopReady(std::chrono::steady_clock::time_point now, DispatchThunkBase*& pHead, DispatchThunkBase*& pTail);
+
+  /// <summary>
+  /// Removes all thunks from the wheel, in no particular order
+  /// </summary>
+  std::vector<DispatchThunkDelayed> ReleaseAll(void);
+};
+
+}
@@ -0,0 +1,188 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#include "stdafx.h"
+#include "FlightRecorder.h"
+#include "demangle.h"
+#include <algorithm>
+#include <ostream>
+
+using namespace autowiring;
+
+struct FlightRecorder::Buffer {
+  Buffer(size_t capacity, uint32_t thread) :
+    slots(new Slot[capacity]),
+    thread(thread)
+  {}
+
+  // Fields are written and read individually.  A slot is only read if its sequence is the same before
+  // and after, and shows that the slot was completely written.
+  struct Slot {
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<uint8_t> type{0};
+    std::atomic<int64_t> timestamp{0};
+    std::atomic<uint64_t> packet{0};
+    std::atomic<const auto_id_block*> id{nullptr};
+    std::atomic<uint32_t> thread{0};
+  };
+  std::unique_ptr<Slot[]> slots;
+
+  // The number of events ever written to this buffer
+  std::atomic<uint64_t> head{0};
+
+  // The thread now writing to this buffer, and whether that thread has exited
+  uint32_t thread;
+  std::atomic<bool> retired{false};
+
+  static void Retire(Buffer* buffer) {
+    buffer->retired = true;
+  }
+};
+
+FlightRecorder::FlightRecorder(size_t capacity) :
+  m_capacity(capacity ? capacity : 1),
+  m_epoch(std::chrono::steady_clock::now()),
+  m_local(&Buffer::Retire)
+{}
+
+FlightRecorder::~FlightRecorder(void) {
+  // Buffers belong to this recorder, the current thread's slot must simply be cleared
+  m_local.release();
+}
+
+FlightRecorder::Buffer& FlightRecorder::GetLocalBuffer(void) {
+  Buffer* buffer = m_local.get();
+  if (buffer)
+    return *buffer;
+
+  {
+    std::lock_guard<std::mutex> lk(m_lock);
+    for (auto& cur : m_buffers)
+      if (cur->retired) {
+        // The thread that owned this buffer is gone, keep its events and take over recording
+        buffer = cur.get();
+        buffer->retired = false;
+        buffer->thread = m_nThreads++;
+        break;
+      }
+
+    if (!buffer) {
+      m_buffers.emplace_back(new Buffer(m_capacity, m_nThreads++));
+      buffer = m_buffers.back().get();
+    }
+  }
+  m_local.reset(buffer);
+  return *buffer;
+}
+
+void FlightRecorder::Record(FlightEvent::Type type, uint64_t packet, auto_id id) {
+  Buffer& buffer = GetLocalBuffer();
+  const int64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_epoch).count();
+
+  // Only this thread writes to the buffer
+  const uint64_t index = buffer.head.load(std::memory_order_relaxed);
+  Buffer::Slot& slot = buffer.slots[index % m_capacity];
+  slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.type.store(static_cast<uint8_t>(type), std::memory_order_relaxed);
+  slot.timestamp.store(timestamp, std::memory_order_relaxed);
+  slot.packet.store(packet, std::memory_order_relaxed);
+  slot.id.store(id.block, std::memory_order_relaxed);
+  slot.thread.store(buffer.thread, std::memory_order_relaxed);
+  slot.sequence.store(2 * index + 2, std::memory_order_release);
+  buffer.head.store(index + 1, std::memory_order_release);
+}
+
+std::vector<FlightEvent> FlightRecorder::GetEvents(void) const {
+  std::vector<FlightEvent> retVal;
+  {
+    std::lock_guard<std::mutex> lk(m_lock);
+    for (const auto& buffer : m_buffers) {
+      const uint64_t head = buffer->head.load(std::memory_order_acquire);
+      for (uint64_t index = head < m_capacity ? 0 : head - m_capacity; index < head; index++) {
+        const Buffer::Slot& slot = buffer->slots[index % m_capacity];
+        const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * index + 2)
+          // Already overwritten
+          continue;
+
+        FlightEvent event;
+        event.type = static_cast<FlightEvent::Type>(slot.type.load(std::memory_order_relaxed));
+        event.timestamp = std::chrono::nanoseconds(slot.timestamp.load(std::memory_order_relaxed));
+        event.packet = slot.packet.load(std::memory_order_relaxed);
+        const auto_id_block* id = slot.id.load(std::memory_order_relaxed);
+        event.id = id ? auto_id(*id) : auto_id{};
+        event.thread = slot.thread.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == sequence)
+          retVal.push_back(event);
+      }
+    }
+  }
+
+  // Events from each buffer are already in order, they only need to be interleaved
+  std::stable_sort(
+    retVal.begin(),
+    retVal.end(),
+    [] (const FlightEvent& lhs, const FlightEvent& rhs) {
+      return lhs.timestamp < rhs.timestamp;
+    }
+  );
+  return retVal;
+}
+
+/// <summary>
+/// Writes the specified string as a quoted JSON string
+/// </summary>
+static void WriteJsonString(std::ostream& os, const std::string& str) {
+  os << '"';
+  for (char c : str)
+    switch (c) {
+    case '"':
+    case '\\':
+      os << '\\' << c;
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20)
+        os << ' ';
+      else
+        os << c;
+      break;
+    }
+  os << '"';
+}
+
+void FlightRecorder::WriteChromeTrace(std::ostream& os) const {
+  os << "{\"traceEvents\":[";
+
+  bool first = true;
+  for (const FlightEvent& event : GetEvents()) {
+    os << (first ? "\n" : ",\n");
+    first = false;
+
+    os << "{\"name\":";
+    switch (event.type) {
+    case FlightEvent::Type::PacketIssued:
+    case FlightEvent::Type::PacketReleased:
+      os << "\"packet\",\"cat\":\"packet\",\"ph\":\"" << (event.type == FlightEvent::Type::PacketIssued ? 'b' : 'e') << '"'
+         << ",\"id\":" << event.packet;
+      break;
+    case FlightEvent::Type::DecorationPublished:
+      WriteJsonString(os, demangle(event.id));
+      os << ",\"cat\":\"decoration\",\"ph\":\"i\",\"s\":\"t\"";
+      break;
+    case FlightEvent::Type::FilterStarted:
+    case FlightEvent::Type::FilterFinished:
+      WriteJsonString(os, demangle(event.id));
+      os << ",\"cat\":\"filter\",\"ph\":\"" << (event.type == FlightEvent::Type::FilterStarted ? 'B' : 'E') << '"';
+      break;
+    }
+
+    // Timestamps are in microseconds
+    os << ",\"ts\":" << event.timestamp.count() / 1000 << '.';
+    const auto fraction = event.timestamp.count() % 1000;
+    os << (fraction < 100 ? "0" : "") << (fraction < 10 ? "0" : "") << fraction;
+    os << ",\"pid\":1,\"tid\":" << event.thread
+       << ",\"args\":{\"packet\":" << event.packet << "}}";
+  }
+  os << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
@@ -0,0 +1,105 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#pragma once
+#include "auto_id.h"
+#include "thread_specific_ptr.h"
+#include <atomic>
+#include CHRONO_HEADER
+#include MEMORY_HEADER
+#include MUTEX_HEADER
+#include <iosfwd>
+#include <vector>
+
+namespace autowiring {
+
+/// <summary>
+/// A single event recorded by a FlightRecorder
+/// </summary>
+struct FlightEvent {
+  enum class Type : uint8_t {
+    // A packet was issued by its factory
+    PacketIssued,
+
+    // A decoration was attached to a packet
+    DecorationPublished,
+
+    // An AutoFilter was called, and returned
+    FilterStarted,
+    FilterFinished,
+
+    // A packet was finalized
+    PacketReleased
+  };
+
+  Type type;
+
+  // The time at which the event occurred, relative to the creation of the recorder
+  std::chrono::nanoseconds timestamp;
+
+  // The sequence number of the packet on which the event occurred
+  uint64_t packet;
+
+  // The decoration type for DecorationPublished, the AutoFilter type for filter events, and void otherwise
+  auto_id id;
+
+  // The recording thread, numbered in the order in which threads first recorded an event
+  uint32_t thread;
+};
+
+/// <summary>
+/// Records the most recent packet events on each thread, for diagnosing pipeline stalls after the fact
+/// </summary>
+/// <remarks>
+/// Each thread records to its own ring buffer, which holds a fixed number of its most recent events.
+/// Recording takes no locks and makes no allocations, except for the first event recorded on each
+/// thread.  Buffers may be read at any time from any thread; an event that is being overwritten while
+/// it is read is left out.  The buffer of a thread which exits is retained, and is reused by the next
+/// thread to begin recording.
+///
+/// Attach a recorder to a factory with AutoPacketFactory::SetFlightRecorder.
+/// </remarks>
+class FlightRecorder {
+public:
+  /// <param name="capacity">The number of events retained for each thread</param>
+  FlightRecorder(size_t capacity = 4096);
+  ~FlightRecorder(void);
+
+  struct Buffer;
+
+private:
+  const size_t m_capacity;
+  const std::chrono::steady_clock::time_point m_epoch;
+
+  // Every buffer created by this recorder, and the number of threads that have recorded, guarded by m_lock
+  mutable std::mutex m_lock;
+  std::vector<std::unique_ptr<Buffer>> m_buffers;
+  uint32_t m_nThreads = 0;
+
+  // The buffer of the current thread
+  thread_specific_ptr<Buffer> m_local;
+
+  /// <returns>The buffer of the current thread, which is assigned if necessary</returns>
+  Buffer& GetLocalBuffer(void);
+
+public:
+  /// <returns>The number of events retained for each thread</returns>
+  size_t GetCapacity(void) const { return m_capacity; }
+
+  /// <summary>
+  /// Records an event on the current thread
+  /// </summary>
+  void Record(FlightEvent::Type type, uint64_t packet, auto_id id = auto_id{});
+
+  /// <returns>All retained events, in order of occurrence</returns>
+  std::vector<FlightEvent> GetEvents(void) const;
+
+  /// <summary>
+  /// Writes all retained events in the Chrome trace event format, which may also be loaded by Perfetto
+  /// </summary>
+  /// <remarks>
+  /// AutoFilter calls are written as duration events on the thread that made them, decorations as
+  /// instant events, and packet lifetimes as asynchronous events identified by packet sequence number.
+  /// </remarks>
+  void WriteChromeTrace(std::ostream& os) const;
+};
+
+}
@@ -0,0 +1,134 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#include "stdafx.h"
+#include "LatencyHistogram.h"
+#include <cmath>
+
+using namespace autowiring;
+
+LatencyHistogram::LatencyHistogram(void) {
+  Reset();
+}
+
+LatencyHistogram::LatencyHistogram(const LatencyHistogram& rhs) {
+  Reset();
+  Merge(rhs);
+}
+
+LatencyHistogram& LatencyHistogram::operator=(const LatencyHistogram& rhs) {
+  if (this != &rhs) {
+    Reset();
+    Merge(rhs);
+  }
+  return *this;
+}
+
+size_t LatencyHistogram::BucketOf(uint64_t value) {
+  if (value < sc_subBucketCount)
+    // Small values are recorded exactly
+    return static_cast<size_t>(value);
+
+  // Find the position of the most significant bit
+  int msb = 0;
+  for (int shift = 32; shift; shift >>= 1)
+    if (value >> (msb + shift))
+      msb += shift;
+
+  // Keep the most significant bits, the bucket is given by the power of two and these bits
+  int shift = msb - sc_subBucketBits;
+  return (shift + 1) * sc_subBucketCount + static_cast<size_t>((value >> shift) - sc_subBucketCount);
+}
+
+uint64_t LatencyHistogram::HighestValueOf(size_t bucket) {
+  if (bucket < sc_subBucketCount)
+    return bucket;
+
+  int shift = static_cast<int>(bucket / sc_subBucketCount) - 1;
+  uint64_t lowBits = bucket % sc_subBucketCount + sc_subBucketCount;
+  return ((lowBits + 1) << shift) - 1;
+}
+
+void LatencyHistogram::Record(std::chrono::nanoseconds duration) {
+  uint64_t value = duration.count() < 0 ? 0 : static_cast<uint64_t>(duration.count());
+  m_buckets[BucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+  m_sum.fetch_add(value, std::memory_order_relaxed);
+
+  for (uint64_t prior = m_max.load(std::memory_order_relaxed); prior < value;)
+    if (m_max.compare_exchange_weak(prior, value, std::memory_order_relaxed))
+      break;
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& rhs) {
+  for (size_t i = 0; i < sc_bucketCount; i++) {
+    uint64_t count = rhs.m_buckets[i].load(std::memory_order_relaxed);
+    if (count)
+      m_buckets[i].fetch_add(count, std::memory_order_relaxed);
+  }
+  m_sum.fetch_add(rhs.m_sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+  uint64_t value = rhs.m_max.load(std::memory_order_relaxed);
+  for (uint64_t prior = m_max.load(std::memory_order_relaxed); prior < value;)
+    if (m_max.compare_exchange_weak(prior, value, std::memory_order_relaxed))
+      break;
+}
+
+void LatencyHistogram::Reset(void) {
+  for (auto& bucket : m_buckets)
+    bucket.store(0, std::memory_order_relaxed);
+  m_sum.store(0, std::memory_order_relaxed);
+  m_max.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::GetCount(void) const {
+  uint64_t retVal = 0;
+  for (auto& bucket : m_buckets)
+    retVal += bucket.load(std::memory_order_relaxed);
+  return retVal;
+}
+
+std::chrono::nanoseconds LatencyHistogram::GetMean(void) const {
+  uint64_t count = GetCount();
+  if (!count)
+    return std::chrono::nanoseconds(0);
+  return std::chrono::nanoseconds(m_sum.load(std::memory_order_relaxed) / count);
+}
+
+std::chrono::nanoseconds LatencyHistogram::GetStandardDeviation(void) const {
+  uint64_t count = GetCount();
+  if (!count)
+    return std::chrono::nanoseconds(0);
+
+  // Each sample is taken to lie at the middle of its bucket
+  double mean = static_cast<double>(m_sum.load(std::memory_order_relaxed)) / count;
+  double sqSum = 0.0;
+  for (size_t i = 0; i < sc_bucketCount; i++) {
+    uint64_t n = m_buckets[i].load(std::memory_order_relaxed);
+    if (!n)
+      continue;
+
+    double low = i ? static_cast<double>(HighestValueOf(i - 1) + 1) : 0.0;
+    double delta = (low + static_cast<double>(HighestValueOf(i))) / 2.0 - mean;
+    sqSum += delta * delta * n;
+  }
+  return std::chrono::nanoseconds(static_cast<std::chrono::nanoseconds::rep>(std::sqrt(sqSum / count)));
+}
+
+std::chrono::nanoseconds LatencyHistogram::GetPercentile(double percentile) const {
+  uint64_t count = GetCount();
+  if (!count)
+    return std::chrono::nanoseconds(0);
+
+  // The rank of the sample we're looking for, counting from one
+  double rank = std::ceil(percentile / 100.0 * count);
+  uint64_t target = rank < 1.0 ? 1 : rank > count ? count : static_cast<uint64_t>(rank);
+
+  uint64_t max = m_max.load(std::memory_order_relaxed);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < sc_bucketCount; i++) {
+    seen += m_buckets[i].load(std::memory_order_relaxed);
+    if (seen >= target) {
+      uint64_t value = HighestValueOf(i);
+      return std::chrono::nanoseconds(value < max ? value : max);
+    }
+  }
+  return std::chrono::nanoseconds(max);
+}
@@ -0,0 +1,89 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#pragma once
+#include <atomic>
+#include CHRONO_HEADER
+#include <cstdint>
+
+namespace autowiring {
+
+/// <summary>
+/// A histogram of durations with logarithmically spaced buckets
+/// </summary>
+/// <remarks>
+/// Each power of two is divided into 2^sc_subBucketBits equal buckets, so any recorded value can be
+/// recovered to within a relative error of 1/2^sc_subBucketBits across the whole range of a 64-bit
+/// nanosecond count.  Durations may be recorded from any number of threads concurrently without
+/// locking.  Readers observe a consistent histogram only if no durations are being recorded, but a
+/// histogram read while recording is underway is never more than a few samples out of date.
+/// </remarks>
+class LatencyHistogram {
+public:
+  LatencyHistogram(void);
+  LatencyHistogram(const LatencyHistogram& rhs);
+
+  LatencyHistogram& operator=(const LatencyHistogram& rhs);
+
+  // Number of bits of precision retained within each power of two
+  static const int sc_subBucketBits = 4;
+  static const size_t sc_subBucketCount = size_t(1) << sc_subBucketBits;
+
+  // Total number of buckets required to cover all 64-bit values
+  static const size_t sc_bucketCount = (64 - sc_subBucketBits + 1) * sc_subBucketCount;
+
+private:
+  std::atomic<uint64_t> m_buckets[sc_bucketCount];
+  std::atomic<uint64_t> m_sum;
+  std::atomic<uint64_t> m_max;
+
+  /// <returns>The bucket into which the specified value falls</returns>
+  static size_t BucketOf(uint64_t value);
+
+  /// <returns>The largest value which falls into the specified bucket</returns>
+  static uint64_t HighestValueOf(size_t bucket);
+
+public:
+  /// <summary>
+  /// Adds one sample to the histogram
+  /// </summary>
+  /// <remarks>
+  /// Negative durations are recorded as zero
+  /// </remarks>
+  void Record(std::chrono::nanoseconds duration);
+
+  /// <summary>
+  /// Adds all of the samples in the passed histogram to this one
+  /// </summary>
+  void Merge(const LatencyHistogram& rhs);
+
+  /// <summary>
+  /// Discards all samples
+  /// </summary>
+  /// <remarks>
+  /// Samples recorded concurrently with a call to Reset might be partially discarded
+  /// </remarks>
+  void Reset(void);
+
+  /// <returns>The number of samples in the histogram</returns>
+  uint64_t GetCount(void) const;
+
+  /// <returns>The arithmetic mean of all samples, or zero if there are none</returns>
+  std::chrono::nanoseconds GetMean(void) const;
+
+  /// <returns>The standard deviation of all samples, estimated from the bucket each falls in</returns>
+  std::chrono::nanoseconds GetStandardDeviation(void) const;
+
+  /// <returns>The largest sample, or zero if there are none</returns>
+  std::chrono::nanoseconds GetMax(void) const { return std::chrono::nanoseconds(m_max.load(std::memory_order_relaxed)); }
+
+  /// <summary>
+  /// Estimates the value below which the specified percentage of samples fall
+  /// </summary>
+  /// <param name="percentile">The percentage of interest, in the range [0, 100]</param>
+  /// <returns>
+  /// The highest value that could be held by the bucket containing the specified percentile, but no
+  /// larger than the largest sample.  Zero is returned if there are no samples.
+  /// </returns>
+  std::chrono::nanoseconds GetPercentile(double percentile) const;
+};
+
+}
@@ -163,22 +163,23 @@ protected:
   /// <remarks>
   /// The Initialize is applied immediate when Wrap is called.
   /// The Finalize function will be applied is in the shared_ptr destructor.
+  ///
+  /// The returned shared pointer owns the object directly, rather than being an alias of the pool
+  /// entry, so that types deriving from std::enable_shared_from_this may also be pooled.
   /// </remarks>
   std::shared_ptr<T> Wrap(PoolEntry* entry) {
     // Create the shared pointer which will delegate cleanup
-    std::shared_ptr<PoolEntry> pe(
-      entry,
-      [] (PoolEntry* entry) {
+    std::shared_ptr<T> retVal(
+      reinterpret_cast<T*>(entry->obj),
+      [entry] (T*) {
         if(!entry->Return())
           delete entry;
       }
     );
 
     // Initialize the issued object, now that a shared pointer has been created for it.
-    m_monitor->initial(*reinterpret_cast<T*>(entry->obj));
-
-    // All done, use an aliased shared pointer here
-    return std::shared_ptr<T>(std::move(pe), reinterpret_cast<T*>(entry->obj));
+    m_monitor->initial(*retVal);
+    return retVal;
   }
 
   bool ReturnUnsafe(PoolEntry* ptr) {
@@ -0,0 +1,75 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#pragma once
+#include "SatCounter.h"
+#include <cstddef>
+#include TYPE_TRAITS_HEADER
+
+class AutoPacket;
+
+namespace autowiring {
+
+/// <summary>
+/// A continuation attached to a single issuance of a packet
+/// </summary>
+/// <remarks>
+/// A callable no larger than sc_inlineSize is constructed within the node itself, larger ones are
+/// allocated from the heap.  Nodes are kept by the packet after their continuation has run or been
+/// discarded, so that a pooled packet reuses its nodes from one issuance to the next.
+/// </remarks>
+struct PacketContinuation {
+  // The largest callable stored within the node
+  static const size_t sc_inlineSize = 8 * sizeof(void*);
+
+  // Counter linked into the packet for a continuation waiting on decorations, unused otherwise
+  SatCounter counter;
+
+  // Set if counter is linked into the packet
+  bool linked = false;
+
+  // Called when the packet is released, for a completion callback
+  void(*pfnComplete)(void* pFn, const AutoPacket& packet) = nullptr;
+
+  // Destroys the callable without releasing its memory
+  void(*pfnDestroy)(void* pFn) = nullptr;
+
+  // The callable, which is either in storage or on the heap
+  void* pFn = nullptr;
+
+  // Next node in the list of attached or free nodes
+  PacketContinuation* pFlink = nullptr;
+
+  typename std::aligned_storage<sc_inlineSize, alignof(std::max_align_t)>::type storage;
+
+  /// <returns>Memory for a callable of the specified size and alignment</returns>
+  void* Allocate(size_t size, size_t alignment) {
+    pFn =
+      size <= sc_inlineSize && alignment <= alignof(std::max_align_t) ?
+      static_cast<void*>(&storage) :
+      ::operator new(size);
+    return pFn;
+  }
+
+  /// <summary>
+  /// Releases the memory obtained from Allocate
+  /// </summary>
+  void Free(void) {
+    if (pFn != &storage)
+      ::operator delete(pFn);
+    pFn = nullptr;
+  }
+
+  /// <summary>
+  /// Destroys the callable and returns this node to its unused state
+  /// </summary>
+  void Reset(void) {
+    if (pfnDestroy)
+      pfnDestroy(pFn);
+    Free();
+    counter = SatCounter();
+    linked = false;
+    pfnComplete = nullptr;
+    pfnDestroy = nullptr;
+  }
+};
+
+}
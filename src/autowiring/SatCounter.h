@@ -22,6 +22,21 @@ struct SatCounter:
     remaining(source.remaining)
   {}
 
+  SatCounter& operator=(const SatCounter& rhs) = default;
+
+  /// <summary>
+  /// Makes this counter a copy of the passed counter which does not share ownership of its AutoFilter
+  /// </summary>
+  /// <remarks>
+  /// No reference count is touched.  The caller must keep the passed counter's AutoFilter alive for as
+  /// long as this counter is in use.
+  /// </remarks>
+  void AssignUnowned(const SatCounter& rhs) {
+    static_cast<AutoFilterDescriptorStub&>(*this) = rhs;
+    m_autoFilter = rhs.m_autoFilter.unowned();
+    remaining = rhs.remaining;
+  }
+
   // Forward and backward linked list pointers
   SatCounter* flink = nullptr;
   SatCounter* blink = nullptr;
@@ -29,6 +44,11 @@ struct SatCounter:
   // The number of inputs remaining to this counter:
   size_t remaining = 0;
 
+  // The disposition of each argument, in argument order, bound when the counter was wired from a
+  // packet template.  Entries are nullptr for arguments that are not inputs, and the pointer itself is
+  // nullptr if the counter was not wired from a template, in which case arguments are looked up.
+  const DecorationDisposition* const* dispositions = nullptr;
+
   /// <summary>
   /// Conditionally decrements AutoFilter argument satisfaction.
   /// </summary>
@@ -43,6 +63,13 @@ struct SatCounter:
   void Increment(void) {
     ++remaining;
   }
+
+  /// <summary>
+  /// Restores the counter to its initial, unsatisfied state
+  /// </summary>
+  void Reset(void) {
+    remaining = m_requiredCount;
+  }
 };
 
 }
@@ -1,6 +1,7 @@
 // Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
 #include "stdafx.h"
 #include "SystemThreadPool.h"
+#include "SystemThreadPoolStealing.h"
 
 using namespace autowiring;
 
@@ -9,3 +10,12 @@ SystemThreadPool::SystemThreadPool(void)
 
 SystemThreadPool::~SystemThreadPool(void)
 {}
+
+std::shared_ptr<SystemThreadPool> SystemThreadPool::New(SystemThreadPoolType type) {
+  switch (type) {
+  case SystemThreadPoolType::WorkStealing:
+    return std::make_shared<SystemThreadPoolStealing>();
+  default:
+    return New();
+  }
+}
@@ -4,6 +4,17 @@
 
 namespace autowiring {
 
+/// <summary>
+/// The kinds of system thread pool which may be requested from SystemThreadPool::New
+/// </summary>
+enum class SystemThreadPoolType {
+  // The platform's native thread pool, or an STL-based fallback where there isn't one
+  Native,
+
+  // A pool with a work queue per worker, where idle workers steal work from busy ones
+  WorkStealing
+};
+
 /// <summary>
 /// A thread pool that makes use of the underlying system's APIs
 /// </summary>
@@ -17,6 +28,9 @@ public:
   // Creates a new platform-specific thread pool
   static std::shared_ptr<SystemThreadPool> New(void);
 
+  // Creates a new thread pool of the specified type
+  static std::shared_ptr<SystemThreadPool> New(SystemThreadPoolType type);
+
   /// <summary>
   /// Makes a recommendation as to the number of worker threads that should be used to process work
   /// </summary>
@@ -0,0 +1,212 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#include "stdafx.h"
+#include "SystemThreadPoolStealing.h"
+#include "thread_specific_ptr.h"
+#include <algorithm>
+#include <deque>
+#include THREAD_HEADER
+
+using namespace autowiring;
+using namespace autowiring::detail;
+
+namespace autowiring {
+namespace detail {
+  struct StealingWorker {
+    // The pool to which this worker belongs
+    SystemThreadPoolStealing* pool = nullptr;
+
+    // Work queued to this worker.  The worker takes work from the back, and thieves take it from the front.
+    std::mutex lock;
+    std::deque<DispatchThunkBase*> queue;
+
+    // The thread running this worker, if any.  running is guarded by the pool's sleep lock.
+    std::thread thread;
+    bool running = false;
+
+    // State for choosing the first victim of a steal
+    uint32_t seed = 0;
+  };
+}
+}
+
+/// <summary>
+/// The worker running on the current thread, or nullptr if the current thread does not belong to a pool
+/// </summary>
+static thread_specific_ptr<StealingWorker> s_currentWorker{ nullptr };
+
+const size_t SystemThreadPoolStealing::sc_maxWorkers;
+
+SystemThreadPoolStealing::SystemThreadPoolStealing(void) :
+  m_workers(new StealingWorker[sc_maxWorkers]),
+  m_nDesired(std::min<size_t>(std::max<size_t>(std::thread::hardware_concurrency(), 2), sc_maxWorkers))
+{
+  for (size_t i = 0; i < sc_maxWorkers; i++) {
+    m_workers[i].pool = this;
+    m_workers[i].seed = static_cast<uint32_t>(i * 2654435761U + 1);
+  }
+}
+
+SystemThreadPoolStealing::~SystemThreadPoolStealing(void) {
+  {
+    std::lock_guard<std::mutex> lk(m_sleepLock);
+    m_stopping = true;
+  }
+  m_wake.notify_all();
+
+  for (size_t i = 0; i < sc_maxWorkers; i++) {
+    auto& worker = m_workers[i];
+    if (worker.thread.joinable()) {
+      if (worker.thread.get_id() == std::this_thread::get_id())
+        // The last reference to the pool was held by this worker, which has already left Run
+        worker.thread.detach();
+      else
+        worker.thread.join();
+    }
+
+    for (auto thunk : worker.queue)
+      delete thunk;
+  }
+}
+
+void SystemThreadPoolStealing::StartWorkersUnsafe(void) {
+  // Each worker holds the pool, so that a thunk releasing the last outside reference cannot destroy
+  // the pool out from under the worker running it
+  auto pThis = shared_from_this();
+
+  std::lock_guard<std::mutex> lk(m_sleepLock);
+  for (size_t i = 0; i < m_nDesired; i++) {
+    auto& worker = m_workers[i];
+    if (worker.running)
+      // Still running, possibly because it had not yet noticed that the pool was stopped
+      continue;
+
+    // A prior thread for this worker has already decided to exit, make sure it's gone first
+    if (worker.thread.joinable())
+      worker.thread.join();
+
+    worker.running = true;
+    worker.thread = std::thread([this, pThis, &worker] { Run(worker); });
+  }
+
+  if (m_nWorkers < m_nDesired)
+    m_nWorkers = m_nDesired;
+}
+
+DispatchThunkBase* SystemThreadPoolStealing::FindWork(StealingWorker& worker) {
+  DispatchThunkBase* retVal = nullptr;
+
+  // Most recently queued work first, it's the most likely to still be in cache
+  {
+    std::lock_guard<std::mutex> lk(worker.lock);
+    if (!worker.queue.empty()) {
+      retVal = worker.queue.back();
+      worker.queue.pop_back();
+    }
+  }
+
+  // Steal the oldest work from someone else.  Victims that are busy are skipped, our caller will try
+  // again if anything was missed.
+  size_t nWorkers = m_nWorkers;
+  if (!retVal && nWorkers > 1) {
+    worker.seed ^= worker.seed << 13;
+    worker.seed ^= worker.seed >> 17;
+    worker.seed ^= worker.seed << 5;
+
+    for (size_t i = 0, first = worker.seed % nWorkers; i < nWorkers && !retVal; i++) {
+      auto& victim = m_workers[(first + i) % nWorkers];
+      if (&victim == &worker)
+        continue;
+
+      std::unique_lock<std::mutex> lk(victim.lock, std::try_to_lock);
+      if (lk && !victim.queue.empty()) {
+        retVal = victim.queue.front();
+        victim.queue.pop_front();
+      }
+    }
+  }
+
+  if (retVal)
+    m_nQueued--;
+  return retVal;
+}
+
+void SystemThreadPoolStealing::Run(StealingWorker& worker) {
+  s_currentWorker.reset(&worker);
+
+  for (;;) {
+    if (DispatchThunkBase* thunk = FindWork(worker)) {
+      std::unique_ptr<DispatchThunkBase> pThunk(thunk);
+      try {
+        (*pThunk)();
+      }
+      catch (...) {
+        // Unknown, we have nowhere to report this exception, silently fail
+      }
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lk(m_sleepLock);
+    if (m_nQueued)
+      // Work was queued to a worker we couldn't lock, go back and try again
+      continue;
+    if (m_stopping) {
+      worker.running = false;
+      break;
+    }
+
+    // Submitters check m_nSleeping after queueing, so incrementing it before checking m_nQueued ensures that
+    // either we see their work or they see us
+    m_nSleeping++;
+    m_wake.wait(lk, [this] { return m_nQueued || m_stopping; });
+    m_nSleeping--;
+  }
+
+  s_currentWorker.release();
+}
+
+void SystemThreadPoolStealing::OnStartUnsafe(void) {
+  {
+    std::lock_guard<std::mutex> lk(m_sleepLock);
+    m_stopping = false;
+  }
+  StartWorkersUnsafe();
+}
+
+void SystemThreadPoolStealing::OnStop(void) {
+  {
+    std::lock_guard<std::mutex> lk(m_sleepLock);
+    m_stopping = true;
+  }
+  m_wake.notify_all();
+}
+
+void SystemThreadPoolStealing::SuggestThreadPoolSize(size_t nThreads) {
+  std::lock_guard<std::mutex> lk(m_lock);
+  m_nDesired = std::max(m_nDesired, std::min(nThreads, sc_maxWorkers));
+  if (IsStarted())
+    StartWorkersUnsafe();
+}
+
+bool SystemThreadPoolStealing::Submit(std::unique_ptr<DispatchThunkBase>&& thunk) {
+  // Work submitted by one of our own workers stays with that worker, everything else is spread around
+  StealingWorker* target = s_currentWorker.get();
+  if (!target || target->pool != this) {
+    size_t nWorkers = m_nWorkers;
+    target = &m_workers[nWorkers ? m_nextWorker++ % nWorkers : 0];
+  }
+
+  {
+    std::lock_guard<std::mutex> lk(target->lock);
+    target->queue.push_back(thunk.release());
+  }
+  m_nQueued++;
+
+  // Only need to wake someone up if there is someone asleep.  This is done for every submission, not
+  // just the first one to a worker, because a thief takes one thunk at a time: a worker fanning out
+  // work into its own queue would otherwise leave all but one of the sleeping workers asleep.
+  if (m_nSleeping) {
+    std::lock_guard<std::mutex> lk(m_sleepLock);
+    m_wake.notify_one();
+  }
+  return true;
+}
@@ -0,0 +1,89 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#pragma once
+#include "SystemThreadPool.h"
+#include <atomic>
+#include MEMORY_HEADER
+#include MUTEX_HEADER
+
+namespace autowiring {
+namespace detail {
+  struct StealingWorker;
+}
+
+/// <summary>
+/// A thread pool in which each worker has its own queue of work, and idle workers steal from the others
+/// </summary>
+/// <remarks>
+/// Work submitted from one of this pool's own threads is queued to that thread, and is run by it in the
+/// reverse order of submission unless another worker steals it first.  Work submitted from any other thread
+/// is distributed among the workers in turn.  A worker with nothing left to do attempts to steal the oldest
+/// work from the other workers, starting at a randomly chosen one, before it goes to sleep.  Workers thus
+/// share no lock except when one of them has to be woken up.
+///
+/// The number of workers defaults to the number of hardware threads, and may be increased up to
+/// sc_maxWorkers with SuggestThreadPoolSize.  Stopping the pool causes each worker to exit once there is no
+/// more work for it to do, work submitted afterwards is held until the pool is started again.  Workers are
+/// joined when the pool is destroyed.
+/// </remarks>
+class SystemThreadPoolStealing:
+  public SystemThreadPool
+{
+public:
+  SystemThreadPoolStealing(void);
+  ~SystemThreadPoolStealing(void);
+
+  // The maximum number of worker threads in the pool
+  static const size_t sc_maxWorkers = 64;
+
+private:
+  // Per-worker state.  All sc_maxWorkers entries are allocated up front so that workers may be added
+  // while others are stealing.
+  std::unique_ptr<detail::StealingWorker[]> m_workers;
+
+  // The number of entries in m_workers that have been assigned a thread
+  std::atomic<size_t> m_nWorkers{0};
+
+  // The number of workers that should be running while the pool is started
+  size_t m_nDesired;
+
+  // Round-robin counter used to pick a worker for work submitted from outside of the pool
+  std::atomic<size_t> m_nextWorker{0};
+
+  // The number of thunks held by all workers which have not yet been claimed for execution
+  std::atomic<size_t> m_nQueued{0};
+
+  // The number of workers waiting on m_wake.  Submitters only take m_sleepLock when this is nonzero.
+  std::atomic<size_t> m_nSleeping{0};
+
+  // Set while the pool is stopped
+  bool m_stopping = true;
+
+  // Lock and condition used to put idle workers to sleep
+  std::mutex m_sleepLock;
+  std::condition_variable m_wake;
+
+  /// <summary>
+  /// Starts threads for any workers that should be running but are not
+  /// </summary>
+  void StartWorkersUnsafe(void);
+
+  /// <summary>
+  /// Claims a thunk from the passed worker's queue, or failing that, from another worker's queue
+  /// </summary>
+  DispatchThunkBase* FindWork(detail::StealingWorker& worker);
+
+  /// <summary>
+  /// Processing loop for the passed worker
+  /// </summary>
+  void Run(detail::StealingWorker& worker);
+
+  // ThreadPool overrides
+  void OnStartUnsafe(void) override;
+  void OnStop(void) override;
+
+public:
+  void SuggestThreadPoolSize(size_t nThreads) override;
+  bool Submit(std::unique_ptr<DispatchThunkBase>&& thunk) override;
+};
+
+}
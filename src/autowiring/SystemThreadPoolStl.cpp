@@ -1,16 +1,66 @@
 // Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
 #include "stdafx.h"
 #include "SystemThreadPoolStl.h"
-#include "at_exit.h"
+#include <algorithm>
 
 using namespace autowiring;
 
+namespace {
+  /// <summary>
+  /// Wraps a submitted thunk, so that the pool can find out how long the thunk waited to be run
+  /// </summary>
+  /// <remarks>
+  /// Reading the clock is not free, so only one thunk at a time is timed
+  /// </remarks>
+  class TimedThunk:
+    public DispatchThunkBase
+  {
+  public:
+    TimedThunk(std::unique_ptr<DispatchThunkBase>&& thunk, std::weak_ptr<SystemThreadPoolStl> pool) :
+      m_thunk(std::move(thunk)),
+      m_submitted(std::chrono::steady_clock::now()),
+      m_pool(std::move(pool))
+    {}
+
+  private:
+    std::unique_ptr<DispatchThunkBase> m_thunk;
+    const std::chrono::steady_clock::time_point m_submitted;
+
+    // Not held strongly, the thunk may be run or deleted after the pool is gone
+    const std::weak_ptr<SystemThreadPoolStl> m_pool;
+
+  public:
+    void operator()() override {
+      if (auto pool = m_pool.lock())
+        pool->OnSampled(std::chrono::steady_clock::now() - m_submitted);
+      (*m_thunk)();
+    }
+  };
+}
+
 SystemThreadPoolStl::SystemThreadPoolStl(void):
-  m_toBeDone(~0)
+  m_toBeDone(~0),
+  m_maxThreads(2 * std::max(std::thread::hardware_concurrency(), 1U)),
+  m_latencyThreshold(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::milliseconds(10)).count()),
+  m_idleTimeout(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::seconds(30)).count())
 {}
 
-SystemThreadPoolStl::~SystemThreadPoolStl(void)
-{}
+SystemThreadPoolStl::~SystemThreadPoolStl(void) {
+  // Workers exit once they find the queue aborted, and any thunk underway is allowed to finish
+  m_toBeDone.Abort();
+
+  std::vector<std::thread> threads;
+  {
+    std::lock_guard<std::mutex> lk(m_lock);
+    threads = std::move(m_threads);
+  }
+  for (auto& t : threads)
+    if (t.get_id() == std::this_thread::get_id())
+      // The last reference to the pool was held by this worker, which has already left Run
+      t.detach();
+    else
+      t.join();
+}
 
 // Used on non-MSVC platforms, but we still want to be able to test the rest of these pool
 // behaviors on MSVC
@@ -21,34 +71,87 @@ std::shared_ptr<SystemThreadPool> SystemThreadPool::New(void) {
 #endif
 
 void SystemThreadPoolStl::AddWorkerThreadUnsafe(void) {
-  auto pThis = shared_from_this();
-  std::thread t([this, pThis] {
-    auto clear = MakeAtExit([&] { m_outstanding--; });
-    try {
-      for (;;)
-        m_toBeDone.WaitForEvent();
-    }
-    catch (dispatch_aborted_exception&) {
-      // Dispatch aborted exception, back out
-    }
-    catch (...) {
-      // Unknown, we have nowhere to report this exception, silently fail
-    }
-  });
-  t.detach();
+  // Reclaim any workers which have retired
+  for (auto id : m_exited) {
+    auto q = std::find_if(m_threads.begin(), m_threads.end(), [id](const std::thread& t) { return t.get_id() == id; });
+    q->join();
+    m_threads.erase(q);
+  }
+  m_exited.clear();
+
+  // Each worker holds the pool, so that a thunk releasing the last outside reference cannot destroy
+  // the pool out from under the worker running it
+  auto pThis = std::static_pointer_cast<SystemThreadPoolStl>(shared_from_this());
   m_outstanding++;
+  m_threads.emplace_back([this, pThis] { Run(); });
 }
 
-void SystemThreadPoolStl::OnStartUnsafe(void) {
-  if (m_outstanding)
-    // Do nothing if the pool size was already set by someone else
-    return;
+void SystemThreadPoolStl::Grow(void) {
+  std::lock_guard<std::mutex> lk(m_lock);
+  if (IsStarted() && m_outstanding < m_maxThreads)
+    AddWorkerThreadUnsafe();
+}
 
+void SystemThreadPoolStl::OnSampled(std::chrono::steady_clock::duration latency) {
+  m_sampling = false;
+
+  // Only worth another worker if there's more work behind this one
+  if (latency.count() > m_latencyThreshold && m_outstanding < m_maxThreads && m_toBeDone.GetDispatchQueueLength() > 1)
+    Grow();
+}
+
+void SystemThreadPoolStl::Run(void) {
+  auto lastWork = std::chrono::steady_clock::now();
+  try {
+    for (;;) {
+      // Each worker claims its share of whatever is ready, taking everything would starve the others
+      size_t nWorkers = m_outstanding;
+      std::chrono::steady_clock::duration idleTimeout(m_idleTimeout);
+      if (m_toBeDone.WaitForEvents(m_toBeDone.GetDispatchQueueLength() / (nWorkers ? nWorkers : 1) + 1, lastWork + idleTimeout)) {
+        lastWork = std::chrono::steady_clock::now();
+        continue;
+      }
+
+      auto now = std::chrono::steady_clock::now();
+      if (now - lastWork < idleTimeout)
+        // Woken up early, keep waiting
+        continue;
+
+      // Idle for too long, retire unless we're needed to maintain the pool's size
+      std::lock_guard<std::mutex> lk(m_lock);
+      lastWork = now;
+      if (m_outstanding <= m_minThreads)
+        continue;
+
+      // Submit queues work before it checks for workers, so we must stop counting ourselves before we
+      // check for work.  Either we will see the work or the submitter will see that it must add a worker.
+      m_outstanding--;
+      if (!m_toBeDone.GetDispatchQueueLength()) {
+        m_exited.push_back(std::this_thread::get_id());
+        return;
+      }
+      m_outstanding++;
+    }
+  }
+  catch (dispatch_aborted_exception&) {
+    // Dispatch aborted exception, back out
+  }
+  catch (...) {
+    // Unknown, we have nowhere to report this exception, silently fail
+  }
+
+  // Leave our thread to be joined by whoever adds the next worker, or by our destructor
+  std::lock_guard<std::mutex> lk(m_lock);
+  m_outstanding--;
+  m_exited.push_back(std::this_thread::get_id());
+}
+
+void SystemThreadPoolStl::OnStartUnsafe(void) {
   // TODO:  Set this number according to std::thread::hardware_concurrency (or
   // get_nprocs() on gcc, to retain libstdc++ backwards-compatibility).  This can't
   // be done right now due to the fact that DispatchQueue has terrible concurrency
   // performance.
-  while (m_outstanding < 2)
+  while (m_outstanding < m_minThreads)
     AddWorkerThreadUnsafe();
 }
 
@@ -56,20 +159,27 @@ void SystemThreadPoolStl::OnStop(void) {
   m_toBeDone += [this] { m_toBeDone.Abort(); };
 }
 
+void SystemThreadPoolStl::SetGrowthThresholds(size_t backlog, std::chrono::steady_clock::duration latency) {
+  m_backlogThreshold = backlog;
+  m_latencyThreshold = latency.count();
+}
+
 void SystemThreadPoolStl::SuggestThreadPoolSize(size_t nThreads) {
   std::lock_guard<std::mutex> lk(m_lock);
+  m_minThreads = std::max(m_minThreads, nThreads);
   while (m_outstanding < nThreads)
     AddWorkerThreadUnsafe();
 }
 
 bool SystemThreadPoolStl::Submit(std::unique_ptr<DispatchThunkBase>&& thunk) {
-  // Add some more work
+  // Add some more work, timing it if nothing else is being timed
+  if (!m_sampling && !m_sampling.exchange(true))
+    thunk.reset(new TimedThunk(std::move(thunk), std::static_pointer_cast<SystemThreadPoolStl>(shared_from_this())));
   m_toBeDone.AddExisting(std::move(thunk));
 
-  // If we don't have anyone to do work, we need to wake someone up:
-  std::lock_guard<std::mutex> lk(m_lock);
-  if (!m_outstanding && !m_startToken.expired())
-    AddWorkerThreadUnsafe();
-
+  // If we don't have anyone to do work, or the backlog is too long for those we have, add someone:
+  size_t nWorkers = m_outstanding;
+  if (!nWorkers || (nWorkers < m_maxThreads && m_toBeDone.GetDispatchQueueLength() > nWorkers * m_backlogThreshold))
+    Grow();
   return false;
 }
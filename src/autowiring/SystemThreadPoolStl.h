@@ -14,6 +14,11 @@ namespace autowiring {
 /// This implementation avoids using std::async to achieve thread pooling because some systems
 /// do not attempt to reuse threads to run operations enqueued by std::async, resulting in very
 /// poor performance.
+///
+/// The pool is elastic.  A worker is added whenever the number of waiting thunks exceeds the
+/// backlog threshold for each worker, or whenever a sampled thunk waited longer than the latency
+/// threshold to be run, up to the maximum pool size.  Workers beyond the size suggested by SuggestThreadPoolSize
+/// exit once they have been idle for the idle timeout.  Workers are joined when the pool is destroyed.
 /// </remarks>
 class SystemThreadPoolStl:
   public SystemThreadPool
@@ -29,16 +34,71 @@ private:
   // The current number of outstanding workers
   std::atomic<size_t> m_outstanding{0};
 
+  // Number of workers that will not be retired when idle, and the most workers that will be added
+  size_t m_minThreads = 2;
+  std::atomic<size_t> m_maxThreads;
+
+  // Thresholds for adding a worker, and the amount of time a worker may sit idle before it is retired
+  std::atomic<size_t> m_backlogThreshold{4};
+  std::atomic<std::chrono::steady_clock::rep> m_latencyThreshold;
+  std::atomic<std::chrono::steady_clock::rep> m_idleTimeout;
+
+  // True while a submitted thunk is being timed
+  std::atomic<bool> m_sampling{false};
+
+  // All worker threads, and the identifiers of those which have exited and need to be joined
+  std::vector<std::thread> m_threads;
+  std::vector<std::thread::id> m_exited;
+
   /// <summary>
   /// Creates a new worker thread to process the dispatch queue
   /// </summary>
   void AddWorkerThreadUnsafe(void);
 
+  /// <summary>
+  /// Adds a worker if the pool is running and is not already at its maximum size
+  /// </summary>
+  void Grow(void);
+
+  /// <summary>
+  /// Processing loop for a worker thread
+  /// </summary>
+  void Run(void);
+
   // ThreadPool overrides
   void OnStartUnsafe(void) override;
   void OnStop(void) override;
 
 public:
+  /// <summary>
+  /// Called with the amount of time a timed thunk waited, just before it is run
+  /// </summary>
+  void OnSampled(std::chrono::steady_clock::duration latency);
+
+  /// <returns>The current number of worker threads</returns>
+  size_t GetThreadCount(void) const { return m_outstanding; }
+
+  /// <summary>
+  /// Sets the maximum number of workers the pool will grow to
+  /// </summary>
+  /// <remarks>
+  /// The default is twice the number of hardware threads.  This limit does not apply to workers
+  /// requested through SuggestThreadPoolSize.
+  /// </remarks>
+  void SetMaxThreadPoolSize(size_t nThreads) { m_maxThreads = nThreads; }
+
+  /// <summary>
+  /// Sets the thresholds at which the pool will add a worker
+  /// </summary>
+  /// <param name="backlog">The number of thunks which may be waiting for each worker</param>
+  /// <param name="latency">The amount of time a thunk may wait before it is run</param>
+  void SetGrowthThresholds(size_t backlog, std::chrono::steady_clock::duration latency);
+
+  /// <summary>
+  /// Sets the amount of time a worker may be idle before it exits
+  /// </summary>
+  void SetIdleTimeout(std::chrono::steady_clock::duration idleTimeout) { m_idleTimeout = idleTimeout.count(); }
+
   void SuggestThreadPoolSize(size_t nThreads) override;
   bool Submit(std::unique_ptr<DispatchThunkBase>&& thunk) override;
 };
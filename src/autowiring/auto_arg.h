@@ -1,6 +1,9 @@
 // Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
 #pragma once
 #include "auto_id.h"
+#include "DecorationView.h"
+#include <algorithm>
+#include MEMORY_HEADER
 
 class AutoPacket;
 class CoreContext;
@@ -200,6 +203,18 @@ public:
   }
 };
 
+/// <summary>
+/// Constructs a decoration for the specified packet, in the packet's arena if it has one
+/// </summary>
+/// <remarks>
+/// If a pool is registered for T with the factory that issued the packet, and the pool is able to
+/// supply the decoration, the decoration is taken from the pool instead.
+///
+/// Defined in AutoPacket.h
+/// </remarks>
+template<class T, class... Args>
+std::shared_ptr<T> MakeDecoration(AutoPacket& packet, Args&&... args);
+
 namespace detail {
 
 /// <summary>
@@ -215,7 +230,7 @@ struct auto_arg_ctor_helper;
 template<class T, bool has_default>
 struct auto_arg_ctor_helper<T, has_default, true> {
   static std::shared_ptr<T> arg(AutoPacket& packet) {
-    return std::make_shared<T>(packet);
+    return MakeDecoration<T>(packet, packet);
   }
 };
 
@@ -227,19 +242,19 @@ struct auto_arg_ctor_helper<T, has_default, false> {
   struct fn {};
 
   template<typename U>
-  static std::shared_ptr<U> Allocate(fn<&U::operator new>*) {
+  static std::shared_ptr<U> Allocate(AutoPacket&, fn<&U::operator new>*) {
     return std::shared_ptr<U>(new U);
   }
 
   template<typename U>
-  static std::shared_ptr<U> Allocate(...) {
-    return std::make_shared<U>();
+  static std::shared_ptr<U> Allocate(AutoPacket& packet, ...) {
+    return MakeDecoration<U>(packet);
   }
 
-  static std::shared_ptr<T> arg(AutoPacket&) {
-    // Use make shared, if we can; if static new is present on this type, though, then we have to use
-    // the uglier two-part construction syntax
-    return Allocate<T>(nullptr);
+  static std::shared_ptr<T> arg(AutoPacket& packet) {
+    // Construct with the packet's allocator, if we can; if static new is present on this type, though,
+    // then we have to use the uglier two-part construction syntax
+    return Allocate<T>(packet, nullptr);
   }
 };
 
@@ -363,11 +378,18 @@ public:
   static std::shared_ptr<CoreContext> arg(AutoPacket&);
 };
 
+/// <summary>
+/// The number of decorations a multi-in argument can pass without allocating
+/// </summary>
+static const size_t sc_multiInlineCount = 8;
+
 /// <summary>
 /// Multi-in specialization
 /// </summary>
 /// <remarks>
-/// This specialization is for gathering multiply decorated types from a packet
+/// This specialization is for gathering multiply decorated types from a packet.  The null-terminated
+/// array passed to the filter is built from a view of the packet's decorations, on the stack unless
+/// there are more than sc_multiInlineCount of them.
 /// </remarks>
 template<class T>
 class auto_arg<T const **>
@@ -376,16 +398,30 @@ public:
   typedef const T** arg_type;
   struct type {
     type(type&& rhs) :
-      ptr(std::move(rhs.ptr))
-    {}
-
-    explicit type(std::unique_ptr<const T*[]> ptr) :
-      ptr{std::move(ptr)}
-    {}
-
-    std::unique_ptr<const T*[]> ptr;
-
-    operator const T**(void) const { return ptr.get(); }
+      heap(std::move(rhs.heap))
+    {
+      if (heap)
+        ptr = heap.get();
+      else {
+        // Only the entries up to and including the terminator were ever assigned
+        ptr = buf;
+        for (size_t i = 0; (buf[i] = rhs.buf[i]); i++);
+      }
+    }
+
+    explicit type(const DecorationView<T>& view) {
+      if (view.size() > sc_multiInlineCount)
+        heap.reset(new const T*[view.size() + 1]);
+      ptr = heap ? heap.get() : buf;
+      std::copy(view.begin(), view.end(), ptr);
+      ptr[view.size()] = nullptr;
+    }
+
+    const T* buf[sc_multiInlineCount + 1];
+    std::unique_ptr<const T*[]> heap;
+    const T** ptr;
+
+    operator const T**(void) const { return ptr; }
   };
 
   typedef auto_id_t<T> id_type;
@@ -399,7 +435,7 @@ public:
   template<class C>
   static type arg(C& packet) {
     (void) auto_id_t_init<T, false>::init;
-    return type{packet.template GetAll<T>()};
+    return type{packet.template GetAllView<T>()};
   }
 };
 
@@ -411,6 +447,10 @@ class auto_arg<T const *const*>:
 /// <summary>
 /// Shared pointer multi-in specialization
 /// </summary>
+/// <remarks>
+/// As with the multi-in specialization, the array is on the stack unless there are more than
+/// sc_multiInlineCount decorations.  Each shared pointer must still be copied from the packet.
+/// </remarks>
 template<class T>
 class auto_arg<std::shared_ptr<const T>*>
 {
@@ -419,16 +459,25 @@ public:
 
   struct type {
     type(type&& rhs) :
-      ptr(std::move(rhs.ptr))
-    {}
-
-    explicit type(std::unique_ptr<std::shared_ptr<const T>[]> ptr) :
-      ptr{std::move(ptr)}
-    {}
-
-    std::unique_ptr<std::shared_ptr<const T>[]> ptr;
-
-    operator std::shared_ptr<const T>*(void) const { return ptr.get(); }
+      heap(std::move(rhs.heap))
+    {
+      std::move(rhs.buf, rhs.buf + sc_multiInlineCount + 1, buf);
+      ptr = heap ? heap.get() : buf;
+    }
+
+    explicit type(const DecorationView<T>& view) {
+      if (view.size() > sc_multiInlineCount)
+        heap.reset(new std::shared_ptr<const T>[view.size() + 1]);
+      ptr = heap ? heap.get() : buf;
+      for (size_t i = 0; i < view.size(); i++)
+        ptr[i] = view.GetShared(i);
+    }
+
+    std::shared_ptr<const T> buf[sc_multiInlineCount + 1];
+    std::unique_ptr<std::shared_ptr<const T>[]> heap;
+    std::shared_ptr<const T>* ptr;
+
+    operator std::shared_ptr<const T>*(void) const { return ptr; }
   };
 
   typedef auto_id_t<T> id_type;
@@ -442,11 +491,10 @@ public:
   template<class C>
   static type arg(C& packet) {
     (void) auto_id_t_init<T, false>::init;
-    return type{packet.template GetAllShared<T>()};
+    return type{packet.template GetAllView<T>()};
   }
 };
 
-
 template<class T>
 class auto_arg<const std::shared_ptr<const T>*>:
   public auto_arg<std::shared_ptr<const T>*>
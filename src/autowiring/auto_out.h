@@ -83,10 +83,10 @@ public:
       return m_decoration.get();
     }
     void operator=(const T& t) {
-      m_decoration = std::make_shared<T>(t);
+      m_decoration = MakeDecoration<T>(*m_packet, t);
     }
     void operator=(T&& t) {
-      m_decoration = std::make_shared<T>(std::forward<T&&>(t));
+      m_decoration = MakeDecoration<T>(*m_packet, std::forward<T&&>(t));
     }
     void operator=(const std::shared_ptr<T>& t) {
       m_decoration = t;
@@ -12,7 +12,12 @@ class auto_arg;
 /// </summary>
 /// <remarks>
 /// When auto_prev is used as an AutoFilter argument, its value will be the value of 'T'
-/// from the previous packet. It's null for the the first packet
+/// from the packet issued N packets before this one. It's null for the first N packets,
+/// and if that packet was released without a 'T'.
+///
+/// The packet factory retains only the decorations needed to satisfy these arguments, not the
+/// packets that held them.  Prior decorations are only provided for AutoFilters registered with
+/// the factory.
 /// </remarks>
 template<class T, int N = 1>
 struct auto_prev {
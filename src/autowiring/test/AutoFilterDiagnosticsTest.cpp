@@ -38,3 +38,19 @@ TEST_F(AutoFilterDiagnosticsTest, CanGetExpectedTrueType) {
   ASSERT_NO_THROW(id = ctxt->GetAutoTypeId(asp)) << "Exception thrown while attempting to get true type information";
   ASSERT_EQ(auto_id_t<FilterMemberNotInheritingObject>{}, id) << "True type not correctly reported, got " << autowiring::demangle(id) << ", expected FilterMemberNotInheritingObject";
 }
+
+TEST_F(AutoFilterDiagnosticsTest, AdHocDecorationsAreReported) {
+  AutoRequired<FilterMemberNotInheritingObject> mnio;
+  AutoRequired<AutoPacketFactory> factory;
+
+  auto packet = factory->NewPacket();
+  packet->Decorate(1);
+  packet->Decorate(std::string("ad hoc"));
+  ASSERT_TRUE(packet->Has<int>()) << "Decoration of a type named by an AutoFilter was not found";
+  ASSERT_TRUE(packet->Has<std::string>()) << "Decoration of a type not named by any AutoFilter was not found";
+
+  auto decorations = packet->GetDecorations();
+  ASSERT_EQ(2UL, decorations.size()) << "Dispositions collection did not contain both filter and ad hoc decorations";
+  ASSERT_EQ(2UL, packet->GetDecorationTypeCount()) << "Decoration type count did not include both filter and ad hoc decorations";
+  ASSERT_EQ(1UL, decorations[DecorationKey(auto_id_t<std::string>{}, 0)].m_decorations.size()) << "Ad hoc decoration was not reported";
+}
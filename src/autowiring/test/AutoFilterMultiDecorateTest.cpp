@@ -188,6 +188,34 @@ TEST_F(AutoFilterMultiDecorateTest, ArrayOfSharedPointers) {
   ASSERT_EQ(2, f2) << "const shared_ptr[] input decoration count mismatch";
 }
 
+TEST_F(AutoFilterMultiDecorateTest, FanInBeyondInlineCapacity) {
+  // More producers than a multi-in argument holds without allocating
+  const int nProducers = static_cast<int>(autowiring::sc_multiInlineCount) + 2;
+  for (int i = 0; i < nProducers; i++)
+    *factory += [i](int& out) { out = i; };
+
+  int nRaw = 0;
+  size_t nView = 0;
+  *factory += [&](AutoPacket& packet, const int* vals []) {
+    auto view = packet.GetAllView<int>();
+    nView = view.size();
+    for (nRaw = 0; vals[nRaw]; nRaw++)
+      ASSERT_EQ(view[nRaw], vals[nRaw]) << "Multi-in argument did not refer to the packet's decorations";
+    ASSERT_TRUE(std::equal(view.begin(), view.end(), vals)) << "View did not enumerate the packet's decorations";
+  };
+
+  int nShared = 0;
+  *factory += [&](std::shared_ptr<const int> vals []) {
+    for (nShared = 0; vals[nShared]; nShared++);
+  };
+
+  auto packet = factory->NewPacket();
+  ASSERT_EQ(nProducers, nRaw) << "Multi-in argument did not pass every decoration";
+  ASSERT_EQ(static_cast<size_t>(nProducers), nView) << "View did not include every decoration";
+  ASSERT_EQ(nProducers, nShared) << "Shared multi-in argument did not pass every decoration";
+  ASSERT_TRUE(packet->GetAllView<double>().empty()) << "View of an absent decoration was not empty";
+}
+
 class SameOutputTwiceWithInput {
 public:
   void AutoFilter(Decoration<0>& one, Decoration<0>& two) {
@@ -337,3 +337,57 @@ TEST_F(AutoFilterSequencing, UnsatisfiableImmediate) {
   ASSERT_EQ(0UL, twoInRunCt) << "A zero-argument immediate filter was incorrectly run";
   ASSERT_NO_THROW(packet->DecorateImmediate(Decoration<1>{}));
 }
+
+TEST_F(AutoFilterSequencing, PrevOutOfOrder) {
+  AutoRequired<AutoPacketFactory> factory;
+
+  std::vector<int> seen;
+  *factory += [&seen](const int& current, auto_prev<int, 3> prev) {
+    seen.push_back(prev ? *prev : -1);
+  };
+  ASSERT_EQ(0UL, factory->GetDecorationHistoryDepth(auto_id_t<int>{})) << "History was kept before any packet was issued";
+
+  std::vector<std::shared_ptr<AutoPacket>> packets;
+  for (int i = 0; i < 5; i++)
+    packets.push_back(factory->NewPacket());
+  ASSERT_EQ(3UL, factory->GetDecorationHistoryDepth(auto_id_t<int>{})) << "History depth did not match the largest time shift";
+
+  // The fourth packet cannot proceed until the first one has been decorated
+  packets[3]->Decorate(103);
+  ASSERT_EQ((std::vector<int>{}), seen);
+  packets[0]->Decorate(100);
+  ASSERT_EQ((std::vector<int>{-1, 100}), seen) << "Prior decoration was not delivered to a waiting packet";
+
+  // Releasing a packet without decorating it must release the packets waiting on it
+  packets[0].reset();
+  packets[1].reset();
+  packets[4]->Decorate(104);
+  ASSERT_EQ((std::vector<int>{-1, 100, -1}), seen) << "Packet was not released from waiting on an undecorated packet";
+
+  // Packets issued later find the decoration in the history, though the packet that held it is gone
+  packets.clear();
+  for (int i = 5; i < 10; i++)
+    factory->NewPacket()->Decorate(100 + i);
+  ASSERT_EQ((std::vector<int>{-1, 100, -1, -1, 103, 104, 105, 106}), seen) << "Prior decorations were not served from the history";
+}
+
+TEST_F(AutoFilterSequencing, PrevFromPacketWithoutHistory) {
+  AutoRequired<AutoPacketFactory> factory;
+
+  // Issued before anyone asked for prior decorations, this packet will never record its int
+  auto first = factory->NewPacket();
+
+  std::vector<int> seen;
+  *factory += [&seen](const int& current, auto_prev<int> prev) {
+    seen.push_back(prev ? *prev : -1);
+  };
+
+  auto second = factory->NewPacket();
+  auto third = factory->NewPacket();
+  second->Decorate(2);
+  ASSERT_EQ((std::vector<int>{-1}), seen) << "Packet waited on a prior packet which will never record the decoration";
+
+  first->Decorate(1);
+  third->Decorate(3);
+  ASSERT_EQ((std::vector<int>{-1, 2}), seen) << "Prior decoration was not delivered from the history";
+}
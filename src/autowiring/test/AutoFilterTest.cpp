@@ -3,6 +3,7 @@
 #include "TestFixtures/Decoration.hpp"
 #include <autowiring/AutoPacket.h>
 #include <autowiring/AutoPacketFactory.h>
+#include <autowiring/BatchedAutoFilter.h>
 #include <autowiring/Deferred.h>
 #include <autowiring/demangle.h>
 #include <autowiring/ObjectPool.h>
@@ -933,3 +934,49 @@ TEST_F(AutoFilterTest, AutoOut4) {
     ASSERT_EQ(1, d[DecorationKey(auto_id_t<int>(),0)].m_decorations.size()) << "Incorrect `int` decoration disposition.";
   }
 }
+
+class BatchDoubler:
+  public BatchedAutoFilter<Decoration<0>, Decoration<1>>
+{
+public:
+  BatchDoubler(void) :
+    BatchedAutoFilter(3, std::chrono::milliseconds(10))
+  {}
+
+  std::mutex lock;
+  std::vector<size_t> batchSizes;
+
+  std::vector<size_t> GetBatchSizes(void) {
+    std::lock_guard<std::mutex> lk(lock);
+    return batchSizes;
+  }
+
+  void BatchFilter(const std::vector<const Decoration<0>*>& inputs, std::vector<Decoration<1>>& outputs) override {
+    {
+      std::lock_guard<std::mutex> lk(lock);
+      batchSizes.push_back(inputs.size());
+    }
+    for (const Decoration<0>* input : inputs)
+      outputs.push_back(Decoration<1>(input->i * 2));
+  }
+};
+
+TEST_F(AutoFilterTest, BatchedAutoFilter) {
+  AutoRequired<AutoPacketFactory> factory;
+  AutoRequired<BatchDoubler> doubler;
+
+  std::vector<std::shared_ptr<AutoPacket>> packets;
+  for (int i = 0; i < 4; i++) {
+    packets.push_back(factory->NewPacket());
+    packets.back()->Decorate(Decoration<0>(i));
+  }
+
+  // The first three packets fill a batch, the last one is dispatched once it times out
+  std::condition_variable cv;
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(packets[i]->Wait<const Decoration<1>&>(std::chrono::seconds(5), cv)) << "Batched filter output was not decorated";
+    ASSERT_EQ(i * 2, packets[i]->Get<Decoration<1>>().i) << "Batched output was scattered to the wrong packet";
+  }
+  ASSERT_EQ((std::vector<size_t>{3, 1}), doubler->GetBatchSizes()) << "Packets were not batched as expected";
+  ASSERT_EQ(2UL, doubler->GetBatchCount());
+}
@@ -1,8 +1,15 @@
 // Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
 #include "stdafx.h"
+#include <autowiring/AutoPacketTemplate.h>
 #include <autowiring/CoreThread.h>
+#include <autowiring/FlightRecorder.h>
+#include <autowiring/SatCounter.h>
+#include <autowiring/SystemThreadPoolStl.h>
 #include CHRONO_HEADER
+#include FUTURE_HEADER
 #include THREAD_HEADER
+#include <set>
+#include <sstream>
 
 class AutoPacketFactoryTest:
   public testing::Test
@@ -166,6 +173,16 @@ TEST_F(AutoPacketFactoryTest, AutoPacketStatistics) {
   ASSERT_EQ(numPackets, factory->GetTotalPacketCount()) << "The factory did not get enough packets";
 
   ASSERT_LE(packetDelay, factory->GetMeanPacketLifetime()) << "The mean packet lifetime was less than the delay on each packet";
+
+  // Every packet was delayed, so even the fastest packet bounds the median from below
+  ASSERT_LE(std::chrono::milliseconds(1), factory->GetMedianPacketLifetime()) << "The median packet lifetime was less than the delay on each packet";
+  ASSERT_LE(factory->GetMedianPacketLifetime(), factory->GetP99PacketLifetime()) << "Percentiles were not monotonic";
+  ASSERT_LE(factory->GetP99PacketLifetime(), factory->GetP999PacketLifetime()) << "Percentiles were not monotonic";
+  ASSERT_LE(factory->GetP999PacketLifetime(), factory->GetMaxPacketLifetime()) << "A percentile exceeded the maximum packet lifetime";
+
+  factory->ResetPacketStatistics();
+  ASSERT_EQ(0, factory->GetTotalPacketCount()) << "Packet statistics were not reset";
+  ASSERT_EQ(std::chrono::nanoseconds(0), factory->GetMaxPacketLifetime()) << "Maximum packet lifetime was not reset";
 }
 
 TEST_F(AutoPacketFactoryTest, MultipleInstanceAddition) {
@@ -243,3 +260,524 @@ TEST_F(AutoPacketFactoryTest, CurrentPacket) {
   packet.reset();
   ASSERT_EQ(nullptr, factory->CurrentPacket()) << "A current packet was reported after the current packet has expired";
 }
+
+TEST_F(AutoPacketFactoryTest, PooledPacketsAreRecycled) {
+  AutoCurrentContext ctxt;
+  AutoRequired<AutoPacketFactory> factory;
+  factory->SetPacketPooling(true);
+  ctxt->Initiate();
+
+  int sum = 0;
+  *factory += [&sum](int value) { sum += value; };
+
+  std::set<AutoPacket*> issued;
+  for (int i = 1; i <= 10; i++) {
+    auto packet = factory->NewPacket();
+    issued.insert(packet.get());
+    ASSERT_FALSE(packet->Has<int>()) << "A recycled packet still carried a decoration from its prior issuance";
+    packet->Decorate(i);
+  }
+
+  ASSERT_EQ(55, sum) << "AutoFilter was not called exactly once on each recycled packet";
+  ASSERT_GT(10UL, issued.size()) << "Packets were not recycled even though pooling was enabled";
+  ASSERT_LT(0UL, factory->GetPooledPacketCount()) << "No packets were returned to the pool";
+}
+
+TEST_F(AutoPacketFactoryTest, PooledPacketsRewireOnFilterChange) {
+  AutoCurrentContext ctxt;
+  AutoRequired<AutoPacketFactory> factory;
+  factory->SetPacketPooling(true);
+  ctxt->Initiate();
+
+  int nFirst = 0;
+  int nSecond = 0;
+  *factory += [&nFirst](int) { nFirst++; };
+  for (int i = 0; i < 4; i++)
+    factory->NewPacket()->Decorate(i);
+
+  auto desc = *factory += [&nSecond](const int&) { nSecond++; };
+  for (int i = 0; i < 4; i++)
+    factory->NewPacket()->Decorate(i);
+  ASSERT_EQ(8, nFirst) << "Original filter was not called on every packet";
+  ASSERT_EQ(4, nSecond) << "Filter added to the factory was not called on recycled packets";
+
+  *factory -= desc;
+  for (int i = 0; i < 4; i++)
+    factory->NewPacket()->Decorate(i);
+  ASSERT_EQ(12, nFirst) << "Original filter was not called on every packet";
+  ASSERT_EQ(4, nSecond) << "Filter removed from the factory was still called on recycled packets";
+}
+
+TEST_F(AutoPacketFactoryTest, PooledPacketFactoryCycle) {
+  AutoCurrentContext()->Initiate();
+
+  std::weak_ptr<CoreContext> ctxtWeak;
+  std::weak_ptr<HoldsAutoPacketFactoryReference> hapfrWeak;
+
+  {
+    AutoCreateContext ctxt;
+    CurrentContextPusher pshr(ctxt);
+    AutoRequired<HoldsAutoPacketFactoryReference> hapfr;
+    AutoRequired<AutoPacketFactory> factory;
+    factory->SetPacketPooling(true);
+    ctxt->Initiate();
+
+    ctxtWeak = ctxt;
+    hapfrWeak = hapfr;
+
+    for (int i = 0; i < 4; i++)
+      factory->NewPacket()->Decorate(i);
+    ASSERT_EQ(3, hapfr->m_value) << "AutoFilter did not receive a packet as expected";
+
+    ctxt->SignalShutdown();
+  }
+
+  ASSERT_TRUE(ctxtWeak.expired()) << "Pooled packets held a cyclic reference to their context after shutdown";
+  ASSERT_TRUE(hapfrWeak.expired()) << "Pooled packets held a reference to an AutoFilter after shutdown";
+}
+
+TEST_F(AutoPacketFactoryTest, PacketTemplateCompiledOncePerFilterSet) {
+  AutoCurrentContext()->Initiate();
+  AutoRequired<AutoPacketFactory> factory;
+
+  *factory += [](int) {};
+  factory->NewPacket();
+  auto packetTemplate = factory->GetPacketTemplate();
+  for (int i = 0; i < 4; i++)
+    factory->NewPacket()->Decorate(i);
+  ASSERT_EQ(packetTemplate, factory->GetPacketTemplate()) << "Packet template was recompiled even though the filter set did not change";
+  ASSERT_EQ(1UL, packetTemplate->GetCounterCount()) << "Packet template did not contain a counter for the sole AutoFilter";
+
+  bool called = false;
+  *factory += [&called](const int&) { called = true; };
+  factory->NewPacket()->Decorate(101);
+  ASSERT_TRUE(called) << "Filter added after the template was compiled was not called";
+  ASSERT_NE(packetTemplate, factory->GetPacketTemplate()) << "Packet template was not recompiled after the filter set changed";
+  ASSERT_EQ(2UL, factory->GetPacketTemplate()->GetCounterCount()) << "Recompiled template did not contain both AutoFilters";
+}
+
+TEST_F(AutoPacketFactoryTest, PacketTemplateSlots) {
+  AutoCurrentContext()->Initiate();
+  AutoRequired<AutoPacketFactory> factory;
+
+  *factory += [](const char&) {};
+  auto packetTemplate = factory->GetPacketTemplate();
+  ASSERT_EQ(1UL, packetTemplate->GetSlotCount());
+  ASSERT_EQ(0, packetTemplate->FindSlot(autowiring::DecorationKey(auto_id_t<char>{}, 0))) << "Sole decoration was not given the first slot";
+
+  // Types without slots must not be mistaken for the type in the first slot, whatever their index
+  ASSERT_EQ(-1, packetTemplate->FindSlot(autowiring::DecorationKey(auto_id_t<int>{}, 0))) << "Type without a slot was found in the first slot";
+  ASSERT_EQ(-1, packetTemplate->FindSlot(autowiring::DecorationKey(auto_id_t<bool>{}, 0))) << "Type without a slot was found in the first slot";
+  ASSERT_EQ(0, packetTemplate->GetShiftCount(auto_id_t<int>{})) << "Type without a slot reported time shifts";
+}
+
+namespace {
+  class CountsIntCalls {
+  public:
+    int nCalls = 0;
+    void AutoFilter(const int&) { nCalls++; }
+  };
+}
+
+TEST_F(AutoPacketFactoryTest, PacketsDoNotOwnTemplateFilters) {
+  AutoCurrentContext()->Initiate();
+  AutoRequired<AutoPacketFactory> factory;
+
+  auto filter = std::make_shared<CountsIntCalls>();
+  auto desc = factory->AddSubscriber(filter);
+  factory->NewPacket();
+  const long baseline = filter.use_count();
+
+  std::vector<std::shared_ptr<AutoPacket>> packets;
+  for (int i = 0; i < 8; i++)
+    packets.push_back(factory->NewPacket());
+  ASSERT_EQ(baseline, filter.use_count()) << "Packets wired from a template took their own references to its AutoFilters";
+
+  // Packets keep the template, and so the filter, even once the filter is removed from the factory
+  std::weak_ptr<CountsIntCalls> weak = filter;
+  *factory -= desc;
+  desc = {};
+  filter.reset();
+  ASSERT_FALSE(weak.expired()) << "AutoFilter was destroyed while packets wired to it were outstanding";
+  packets.back()->Decorate(1);
+  ASSERT_EQ(1, weak.lock()->nCalls) << "AutoFilter removed from the factory was not called on an outstanding packet";
+
+  packets.clear();
+  factory->NewPacket();
+  ASSERT_TRUE(weak.expired()) << "AutoFilter outlived every packet wired to it";
+}
+
+namespace {
+  class ReadsBoundInputs {
+  public:
+    int sum = 0;
+    int nFlags = 0;
+    void AutoFilter(const int& value, std::shared_ptr<const bool> flag, std::string& out) {
+      sum += value;
+      if (flag)
+        nFlags++;
+      out = std::to_string(value);
+    }
+  };
+}
+
+TEST_F(AutoPacketFactoryTest, FilterInputsBoundWhenWired) {
+  AutoCurrentContext ctxt;
+  AutoRequired<AutoPacketFactory> factory;
+  factory->SetPacketPooling(true);
+  ctxt->Initiate();
+
+  auto filter = std::make_shared<ReadsBoundInputs>();
+  factory->AddSubscriber(filter);
+
+  for (int i = 1; i <= 4; i++) {
+    auto packet = factory->NewPacket();
+    const autowiring::SatCounter& counter = packet->GetSatisfaction<ReadsBoundInputs>();
+    ASSERT_NE(nullptr, counter.dispositions) << "Counter wired from the packet template was not bound to its arguments";
+    ASSERT_NE(nullptr, counter.dispositions[0]) << "Required input was not bound";
+    ASSERT_NE(nullptr, counter.dispositions[1]) << "Optional input was not bound";
+    ASSERT_EQ(nullptr, counter.dispositions[2]) << "Output was bound even though outputs are never read";
+
+    if (i % 2)
+      packet->Decorate(true);
+    else
+      packet->MarkUnsatisfiable<bool>();
+    packet->Decorate(i);
+    ASSERT_EQ(std::to_string(i), packet->Get<std::string>()) << "Filter did not read the input of the current packet";
+  }
+  ASSERT_EQ(10, filter->sum) << "Bound input did not deliver the value decorated on each packet";
+  ASSERT_EQ(2, filter->nFlags) << "Bound optional input was not empty when it was unsatisfiable";
+
+  // Immediate decorations are seen through the same binding
+  auto packet = factory->NewPacket();
+  packet->Decorate(false);
+  int value = 100;
+  packet->DecorateImmediate(value);
+  ASSERT_EQ(110, filter->sum) << "Bound input did not deliver an immediate decoration";
+}
+
+TEST_F(AutoPacketFactoryTest, ParallelFiltersRunConcurrently) {
+  AutoCurrentContext()->Initiate();
+  AutoRequired<AutoPacketFactory> factory;
+
+  auto pool = std::make_shared<autowiring::SystemThreadPoolStl>();
+  pool->SuggestThreadPoolSize(4);
+  auto token = pool->Start();
+  factory->SetFilterThreadPool(pool);
+
+  // Each filter waits for all of the others to arrive, which can only happen if they run concurrently
+  const size_t nFilters = 3;
+  size_t arrived = 0;
+  size_t rendezvous = 0;
+  std::mutex lock;
+  std::condition_variable cv;
+  std::set<std::thread::id> threads;
+  for (size_t i = 0; i < nFilters; i++)
+    *factory += [&](const int&) {
+      std::unique_lock<std::mutex> lk(lock);
+      threads.insert(std::this_thread::get_id());
+      if (++arrived == nFilters)
+        cv.notify_all();
+      if (cv.wait_for(lk, std::chrono::seconds(5), [&] { return arrived == nFilters; }))
+        rendezvous++;
+    };
+
+  factory->NewPacket()->Decorate(1);
+  ASSERT_EQ(nFilters, arrived) << "Not all filters were called before the decoration returned";
+  ASSERT_EQ(nFilters, rendezvous) << "Filters satisfied by the same decoration did not run concurrently";
+  ASSERT_EQ(nFilters, threads.size()) << "Filters were not distributed across threads";
+}
+
+TEST_F(AutoPacketFactoryTest, ParallelFiltersRespectAltitude) {
+  AutoCurrentContext()->Initiate();
+  AutoRequired<AutoPacketFactory> factory;
+
+  auto pool = std::make_shared<autowiring::SystemThreadPoolStl>();
+  auto token = pool->Start();
+  factory->SetFilterThreadPool(pool);
+
+  std::atomic<bool> highDone{false};
+  std::atomic<int> lowCalls{0};
+  std::atomic<int> lowCallsBeforeHigh{0};
+  *factory += autowiring::altitude::Highest, [&](const int&) { highDone = true; };
+  for (int i = 0; i < 2; i++)
+    *factory += [&](const int&) {
+      if (!highDone)
+        lowCallsBeforeHigh++;
+      lowCalls++;
+    };
+
+  factory->NewPacket()->Decorate(1);
+  ASSERT_EQ(2, lowCalls) << "Standard altitude filters were not called";
+  ASSERT_EQ(0, lowCallsBeforeHigh) << "A standard altitude filter was called before a higher altitude filter returned";
+
+  // Exceptions thrown on the pool must reach the decorating thread
+  *factory += [](const int&) { throw std::runtime_error("Filter failure"); };
+  auto packet = factory->NewPacket();
+  ASSERT_THROW(packet->Decorate(2), std::runtime_error) << "Exception thrown by a concurrently run filter was not rethrown";
+}
+
+TEST_F(AutoPacketFactoryTest, ParallelFilterExceptionStopsGroup) {
+  AutoCurrentContext()->Initiate();
+  AutoRequired<AutoPacketFactory> factory;
+
+  // The pool is never started, so the decorating thread makes every call itself, one after another
+  auto pool = std::make_shared<autowiring::SystemThreadPoolStl>();
+  factory->SetFilterThreadPool(pool);
+
+  int nCalls = 0;
+  for (int i = 0; i < 3; i++)
+    *factory += [&nCalls](const int&) {
+      nCalls++;
+      throw std::runtime_error("Filter failure");
+    };
+
+  auto packet = factory->NewPacket();
+  ASSERT_THROW(packet->Decorate(1), std::runtime_error) << "Exception thrown by a filter in a group was not rethrown";
+  ASSERT_EQ(1, nCalls) << "Filters in a group were started after another filter in the group threw";
+}
+
+TEST_F(AutoPacketFactoryTest, FilterProfiling) {
+  AutoCurrentContext()->Initiate();
+  AutoRequired<AutoPacketFactory> factory;
+
+  int nSlowCalls = 0;
+  *factory += [&](const int&) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    nSlowCalls++;
+  };
+  *factory += [](const int&, const char&) {};
+
+  // Nothing is recorded until profiling is enabled
+  factory->NewPacket()->Decorate(1);
+  ASSERT_TRUE(factory->GetFilterProfiles().empty()) << "Statistics were collected while profiling was disabled";
+
+  factory->SetFilterProfiling(true);
+  for (int i = 0; i < 3; i++) {
+    auto packet = factory->NewPacket();
+    packet->Decorate(i);
+    if (i == 0)
+      packet->Decorate('a');
+  }
+
+  auto profiles = factory->GetFilterProfiles();
+  ASSERT_EQ(2UL, profiles.size()) << "Expected statistics for exactly two filters";
+  for (const auto& profile : profiles) {
+    if (profile.descriptor.GetArity() == 1) {
+      ASSERT_EQ(3UL, profile.GetCallCount()) << "Single-input filter call count was incorrect";
+      ASSERT_EQ(0UL, profile.nSkipped) << "Single-input filter was recorded as skipped";
+      ASSERT_LE(std::chrono::milliseconds(2), profile.latency.GetPercentile(50)) << "Median call duration was less than the filter's delay";
+      ASSERT_LE(profile.latency.GetPercentile(50), profile.latency.GetMax()) << "Median call duration exceeded the maximum";
+    }
+    else {
+      ASSERT_EQ(1UL, profile.GetCallCount()) << "Two-input filter call count was incorrect";
+      ASSERT_EQ(2UL, profile.nSkipped) << "Packets lacking an input were not recorded as skipping the two-input filter";
+    }
+  }
+
+  factory->ResetFilterProfiles();
+  ASSERT_TRUE(factory->GetFilterProfiles().empty()) << "Statistics were not discarded by a reset";
+  ASSERT_EQ(4, nSlowCalls);
+}
+
+TEST_F(AutoPacketFactoryTest, FlightRecorder) {
+  AutoCurrentContext()->Initiate();
+  AutoRequired<AutoPacketFactory> factory;
+  *factory += [](const int&) {};
+
+  auto recorder = std::make_shared<autowiring::FlightRecorder>();
+  factory->SetFlightRecorder(recorder);
+  factory->NewPacket()->Decorate(1);
+
+  typedef autowiring::FlightEvent::Type Type;
+  const Type expected[] = {
+    Type::PacketIssued,
+    Type::DecorationPublished,
+    Type::FilterStarted,
+    Type::FilterFinished,
+    Type::PacketReleased
+  };
+  auto events = recorder->GetEvents();
+  ASSERT_EQ(5UL, events.size()) << "Unexpected number of events recorded for a single packet";
+  for (size_t i = 0; i < events.size(); i++) {
+    ASSERT_EQ(expected[i], events[i].type) << "Event " << i << " was of the wrong type";
+    ASSERT_EQ(events[0].packet, events[i].packet) << "Event " << i << " was recorded against the wrong packet";
+    ASSERT_EQ(events[0].thread, events[i].thread) << "Events on a single thread were attributed to different threads";
+  }
+  ASSERT_EQ(auto_id_t<int>{}, events[1].id) << "Decoration event did not identify the decoration type";
+
+  std::stringstream ss;
+  recorder->WriteChromeTrace(ss);
+  ASSERT_NE(std::string::npos, ss.str().find("\"traceEvents\"")) << "Trace was not written in the Chrome trace format";
+
+  // Only the most recent events are retained
+  autowiring::FlightRecorder small(4);
+  for (uint64_t i = 0; i < 10; i++)
+    small.Record(Type::PacketIssued, i);
+  events = small.GetEvents();
+  ASSERT_EQ(4UL, events.size()) << "Recorder retained more events than its capacity";
+  ASSERT_EQ(6ULL, events.front().packet) << "Recorder did not retain the most recent events";
+
+  factory->SetFlightRecorder(nullptr);
+  factory->NewPacket()->Decorate(2);
+  ASSERT_EQ(5UL, recorder->GetEvents().size()) << "Events were recorded after the recorder was detached";
+}
+
+TEST_F(AutoPacketFactoryTest, PacketDeadline) {
+  AutoCurrentContext()->Initiate();
+  AutoRequired<AutoPacketFactory> factory;
+
+  int nProduced = 0;
+  int nConsumed = 0;
+  bool consumedValue = false;
+  *factory += [&](const int&, float& out) {
+    nProduced++;
+    out = 1.0f;
+  };
+  *factory += [&](std::shared_ptr<const float> in) {
+    nConsumed++;
+    consumedValue = !!in;
+  };
+
+  // Deadline not yet passed, everything runs
+  {
+    auto packet = factory->NewPacket();
+    packet->SetDeadline(std::chrono::hours(1));
+    packet->Decorate(1);
+    ASSERT_FALSE(packet->IsPastDeadline());
+  }
+  ASSERT_EQ(1, nProduced) << "Filter was not called before its packet's deadline";
+  ASSERT_EQ(1, nConsumed);
+  ASSERT_TRUE(consumedValue) << "Optional consumer did not receive the producer's output";
+
+  // Deadline passed, the producer is shed but the optional consumer still runs
+  {
+    auto packet = factory->NewPacket();
+    packet->SetDeadline(std::chrono::steady_clock::now() - std::chrono::milliseconds(1));
+    ASSERT_TRUE(packet->IsPastDeadline());
+    packet->Decorate(1);
+    ASSERT_TRUE(packet->IsUnsatisfiable<float>()) << "Output of a shed filter was not marked unsatisfiable";
+  }
+  ASSERT_EQ(1, nProduced) << "Filter was called after its packet's deadline";
+  ASSERT_EQ(2, nConsumed) << "Optional consumer of a shed filter's output was not called";
+  ASSERT_FALSE(consumedValue) << "Optional consumer received a value from a shed filter";
+
+  // Deadlines may also be given to every packet by the factory
+  factory->SetPacketDeadline(std::chrono::nanoseconds(1));
+  {
+    auto packet = factory->NewPacket();
+    ASSERT_TRUE(packet->HasDeadline()) << "Factory did not give its packet a deadline";
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    packet->Decorate(1);
+  }
+  factory->SetPacketDeadline(std::chrono::nanoseconds::zero());
+  ASSERT_FALSE(factory->NewPacket()->HasDeadline()) << "Packet was given a deadline after the factory's was cleared";
+  ASSERT_EQ(1, nProduced) << "Filter was called after its packet's deadline";
+  ASSERT_EQ(3, nConsumed);
+
+  auto stats = factory->GetShedStatistics();
+  ASSERT_EQ(2ULL, stats.nFilters) << "Shed filters were miscounted";
+  ASSERT_EQ(2ULL, stats.nPackets) << "Packets with shed filters were miscounted";
+}
+
+namespace {
+  class DeferredProducer:
+    public CoreThread
+  {
+  public:
+    int nCalled = 0;
+
+    Deferred AutoFilter(const int&, float& out) {
+      nCalled++;
+      out = 1.0f;
+      return Deferred(this);
+    }
+  };
+}
+
+TEST_F(AutoPacketFactoryTest, DeferredFilterShedAfterDeadline) {
+  AutoCurrentContext()->Initiate();
+  AutoRequired<AutoPacketFactory> factory;
+  AutoRequired<DeferredProducer> producer;
+
+  // Hold up the producer so that its call is still queued when the deadline passes
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future();
+  *producer += [released] { released.wait(); };
+
+  auto packet = factory->NewPacket();
+  packet->Decorate(1);
+  packet->SetDeadline(std::chrono::steady_clock::now() - std::chrono::milliseconds(1));
+  release.set_value();
+
+  std::promise<void> drained;
+  *producer += [&drained] { drained.set_value(); };
+  ASSERT_EQ(std::future_status::ready, drained.get_future().wait_for(std::chrono::seconds(5))) << "Producer did not run its queue";
+
+  ASSERT_EQ(0, producer->nCalled) << "Deferred filter was called after its packet's deadline";
+  ASSERT_TRUE(packet->IsUnsatisfiable<float>()) << "Output of a shed deferred filter was not marked unsatisfiable";
+  ASSERT_EQ(1ULL, factory->GetShedStatistics().nFilters) << "Shed deferred filter was not counted";
+}
+
+TEST_F(AutoPacketFactoryTest, OutstandingPacketCap) {
+  AutoCurrentContext()->Initiate();
+  AutoRequired<AutoPacketFactory> factory;
+
+  // Fail immediately once two packets are outstanding
+  factory->SetOutstandingPacketCap(2, AutoPacketFactory::CapPolicy::Fail);
+  auto packet1 = factory->NewPacket();
+  auto packet2 = factory->NewPacket();
+  ASSERT_EQ(2UL, factory->GetInFlightPacketCount());
+  ASSERT_THROW(factory->NewPacket(), autowiring_error) << "Packet was issued beyond the cap";
+  packet1.reset();
+  ASSERT_NO_THROW(packet1 = factory->NewPacket()) << "Packet could not be issued after another was released";
+  ASSERT_EQ(1UL, factory->GetCapStatistics().nFailed);
+
+  // Block, giving up after a timeout
+  factory->SetOutstandingPacketCap(2, AutoPacketFactory::CapPolicy::Block, std::chrono::milliseconds(1));
+  ASSERT_THROW(factory->NewPacket(), autowiring_error) << "Blocked call to NewPacket did not time out";
+  ASSERT_EQ(1UL, factory->GetCapStatistics().nTimedOut);
+
+  // Block until another thread releases a packet
+  factory->SetOutstandingPacketCap(2, AutoPacketFactory::CapPolicy::Block);
+  std::thread t([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    packet2.reset();
+  });
+  std::shared_ptr<AutoPacket> packet3;
+  ASSERT_NO_THROW(packet3 = factory->NewPacket()) << "Blocked call to NewPacket was not released";
+  t.join();
+  ASSERT_EQ(2UL, factory->GetCapStatistics().nBlocked);
+}
+
+TEST_F(AutoPacketFactoryTest, OutstandingPacketCapRecycleOldest) {
+  AutoCurrentContext()->Initiate();
+  AutoRequired<AutoPacketFactory> factory;
+
+  int nCalls = 0;
+  *factory += [&](const int&) { nCalls++; };
+
+  factory->SetOutstandingPacketCap(1, AutoPacketFactory::CapPolicy::RecycleOldest);
+  auto packet1 = factory->NewPacket();
+  auto packet2 = factory->NewPacket();
+  ASSERT_TRUE(packet1->IsAbandoned()) << "Oldest packet was not abandoned to make room for a new one";
+  ASSERT_FALSE(packet2->IsAbandoned()) << "Newest packet was abandoned";
+  ASSERT_EQ(1UL, factory->GetInFlightPacketCount()) << "Abandoned packet still counts against the cap";
+  ASSERT_EQ(1UL, factory->GetCapStatistics().nRecycled);
+
+  packet1->Decorate(1);
+  ASSERT_EQ(0, nCalls) << "A filter was called on an abandoned packet";
+  packet2->Decorate(2);
+  ASSERT_EQ(1, nCalls) << "A filter was not called on an outstanding packet";
+
+  // Packets issued under another policy cannot be recycled, the caller must wait for them instead
+  packet1.reset();
+  packet2.reset();
+  factory->SetOutstandingPacketCap(1, AutoPacketFactory::CapPolicy::Block);
+  auto packet3 = factory->NewPacket();
+  factory->SetOutstandingPacketCap(1, AutoPacketFactory::CapPolicy::RecycleOldest, std::chrono::milliseconds(1));
+  ASSERT_THROW(factory->NewPacket(), autowiring_error) << "Packet was issued beyond the cap without recycling another";
+  ASSERT_FALSE(packet3->IsAbandoned()) << "Packet issued under another policy was abandoned";
+  ASSERT_EQ(1UL, factory->GetCapStatistics().nRecycled) << "A recycling was counted though no packet was abandoned";
+  ASSERT_EQ(1UL, factory->GetCapStatistics().nTimedOut);
+}
@@ -2,6 +2,7 @@
 #include "stdafx.h"
 #include <autowiring/CoreThread.h>
 #include "TestFixtures/Decoration.hpp"
+#include <set>
 
 class AutoPacketTest:
   public testing::Test
@@ -245,3 +246,231 @@ TEST_F(AutoPacketTest, NoUnneededOutputCopy) {
   ASSERT_EQ(109, rcc.value) << "Copy-counting output value was not copied correctly";
   ASSERT_EQ(0UL, rcc.nCopies) << "An unnecessary number of copies was made during an extracting call";
 }
+
+TEST_F(AutoPacketTest, DecorationArena) {
+  factory->SetDecorationArena(1024);
+  factory->SetPacketPooling(true);
+
+  *factory += [](const Decoration<0>& in, Decoration<1>& out) { out.i = in.i + 1; };
+
+  std::shared_ptr<const Decoration<1>> retained;
+  {
+    auto packet = factory->NewPacket();
+    ASSERT_NE(nullptr, packet->GetDecorationArena()) << "Packet was not given an arena";
+    packet->Decorate(Decoration<0>{1});
+    ASSERT_EQ(1UL, packet->GetDecorationArena()->GetChunkCount()) << "Decorations were not placed in the arena";
+    ASSERT_TRUE(packet->Get(retained)) << "Filter output was not attached";
+  }
+
+  // Recycled packets must not hand out space still held by the retained decoration
+  for (int i = 0; i < 4; i++) {
+    auto packet = factory->NewPacket();
+    packet->Decorate(Decoration<0>{i * 10});
+    ASSERT_EQ(i * 10 + 1, packet->Get<Decoration<1>>().i) << "Filter was not called with a decoration from the arena";
+  }
+  ASSERT_EQ(2, retained->i) << "Decoration retained beyond the lifetime of its packet was not preserved";
+}
+
+TEST_F(AutoPacketTest, DecorationArenaReset) {
+  autowiring::DecorationArena arena(1024);
+  void* a = arena.Allocate(16);
+  void* b = arena.Allocate(16);
+  ASSERT_EQ(0UL, (size_t)a % autowiring::DecorationArena::sc_alignment) << "Arena allocation was misaligned";
+  ASSERT_EQ(1UL, arena.GetChunkCount()) << "Small allocations did not share a chunk";
+  autowiring::DecorationArena::Deallocate(b);
+
+  // An allocation is outstanding, the chunk must be abandoned rather than rewound
+  arena.Reset();
+  ASSERT_EQ(0UL, arena.GetChunkCount()) << "Chunk with an outstanding allocation was retained by the arena";
+  void* c = arena.Allocate(16);
+  ASSERT_NE(a, c) << "Space still held by an allocation was handed out again";
+
+  // With nothing outstanding, the chunk is rewound for reuse
+  autowiring::DecorationArena::Deallocate(a);
+  autowiring::DecorationArena::Deallocate(c);
+  arena.Reset();
+  ASSERT_EQ(1UL, arena.GetChunkCount()) << "Chunk with no outstanding allocations was not retained";
+  void* d = arena.Allocate(16);
+  ASSERT_EQ(c, d) << "Chunk was not rewound";
+
+  // Large allocations bypass the arena
+  void* e = arena.Allocate(512);
+  ASSERT_EQ(1UL, arena.GetChunkCount());
+  autowiring::DecorationArena::Deallocate(d);
+  autowiring::DecorationArena::Deallocate(e);
+}
+
+TEST_F(AutoPacketTest, DecorationPool) {
+  // Reissued objects are not reconstructed, the finalizer is what resets them
+  factory->SetDecorationPool(
+    ObjectPool<Decoration<1>>(
+      ~0, ~0,
+      &DefaultPlacement<Decoration<1>>,
+      &DefaultInitialize<Decoration<1>>,
+      [](Decoration<1>& d) { d.i = 1; }
+    )
+  );
+  factory->SetDecorationPool<Decoration<2>>();
+  std::vector<int> initial;
+  *factory += [&initial](const Decoration<0>& in, Decoration<1>& out) {
+    initial.push_back(out.i);
+    out.i = in.i + 1;
+  };
+
+  std::set<const Decoration<1>*> issued;
+  for (int i = 0; i < 4; i++) {
+    auto packet = factory->NewPacket();
+    packet->Decorate(Decoration<0>{i});
+    ASSERT_EQ(i + 1, packet->Get<Decoration<1>>().i) << "Filter was not called with a pooled output";
+    issued.insert(&packet->Get<Decoration<1>>());
+  }
+  ASSERT_EQ(1UL, issued.size()) << "Output was not returned to the pool when its packet was released";
+  ASSERT_EQ(std::vector<int>(4, 1), initial) << "Pooled output was not reset by its finalizer";
+
+  auto stats = factory->GetDecorationPoolStatistics<Decoration<1>>();
+  ASSERT_EQ(3UL, stats.nHits) << "Pooled outputs were not counted as hits";
+  ASSERT_EQ(1UL, stats.nMisses) << "The first output was not counted as a miss";
+
+  // A decoration retained beyond its packet must not be given to another packet
+  std::shared_ptr<const Decoration<1>> retained;
+  {
+    auto packet = factory->NewPacket();
+    packet->Decorate(Decoration<0>{20});
+    ASSERT_TRUE(packet->Get(retained));
+  }
+  {
+    auto packet = factory->NewPacket();
+    packet->Decorate(Decoration<0>{30});
+    ASSERT_NE(retained.get(), &packet->Get<Decoration<1>>()) << "Retained decoration was reissued by the pool";
+  }
+  ASSERT_EQ(21, retained->i) << "Retained decoration was modified after its packet was released";
+
+  // Decorations given by value are assigned to a pooled object
+  const Decoration<2>* pDecoration = nullptr;
+  for (int i = 0; i < 2; i++) {
+    auto packet = factory->NewPacket();
+    packet->Decorate(Decoration<2>{i});
+    ASSERT_EQ(i, packet->Get<Decoration<2>>().i) << "Value was not assigned to the pooled decoration";
+    if (pDecoration) {
+      ASSERT_EQ(pDecoration, &packet->Get<Decoration<2>>()) << "Decoration given by value was not pooled";
+    }
+    pDecoration = &packet->Get<Decoration<2>>();
+  }
+
+  factory->ClearDecorationPool<Decoration<1>>();
+  stats = factory->GetDecorationPoolStatistics<Decoration<1>>();
+  ASSERT_EQ(0UL, stats.nHits + stats.nMisses) << "Statistics were reported for a pool that was removed";
+  factory->NewPacket()->Decorate(Decoration<0>{});
+}
+
+TEST_F(AutoPacketTest, DecorationPoolReusesStorage) {
+  // Clearing rather than releasing the buffer is what allows the next packet to reuse it
+  factory->SetDecorationPool(
+    ObjectPool<std::vector<uint8_t>>(
+      ~0, ~0,
+      &DefaultPlacement<std::vector<uint8_t>>,
+      &DefaultInitialize<std::vector<uint8_t>>,
+      [](std::vector<uint8_t>& buf) { buf.clear(); }
+    )
+  );
+
+  std::vector<size_t> initialSizes;
+  *factory += [&initialSizes](const Decoration<0>& in, std::vector<uint8_t>& out) {
+    initialSizes.push_back(out.size());
+    out.resize(1024, static_cast<uint8_t>(in.i));
+  };
+
+  const uint8_t* pData = nullptr;
+  for (int i = 0; i < 4; i++) {
+    auto packet = factory->NewPacket();
+    packet->Decorate(Decoration<0>{i});
+    const auto& buf = packet->Get<std::vector<uint8_t>>();
+    ASSERT_EQ(1024UL, buf.size()) << "Filter did not fill the pooled buffer";
+    ASSERT_EQ(i, buf[0]) << "Pooled buffer did not hold this packet's contents";
+    if (pData) {
+      ASSERT_EQ(pData, buf.data()) << "Storage of the pooled buffer was not reused";
+    }
+    pData = buf.data();
+  }
+  ASSERT_EQ(std::vector<size_t>(4, 0), initialSizes) << "Pooled buffer was not cleared by its finalizer";
+
+  auto stats = factory->GetDecorationPoolStatistics<std::vector<uint8_t>>();
+  ASSERT_EQ(3UL, stats.nHits) << "Reused buffers were not counted as hits";
+}
+
+TEST_F(AutoPacketTest, DecorateAll) {
+  int nJoined = 0;
+  bool sawAll = true;
+  *factory += [&](AutoPacket& packet, const Decoration<0>&) {
+    // Nothing downstream of the batch may run before every decoration is attached
+    sawAll = sawAll && packet.Has<Decoration<1>>() && packet.Has<Decoration<2>>();
+  };
+  *factory += [&](const Decoration<0>&, const Decoration<1>&, const Decoration<2>& d2) {
+    nJoined++;
+    ASSERT_EQ(2, d2.i);
+  };
+
+  auto packet = factory->NewPacket();
+  auto d2 = std::make_shared<Decoration<2>>(2);
+  packet->DecorateAll(Decoration<0>{}, Decoration<1>{}, d2);
+  ASSERT_TRUE(sawAll) << "A filter was called before the whole batch was attached";
+  ASSERT_EQ(1, nJoined) << "Filter satisfied by several decorations in a batch was not called exactly once";
+  ASSERT_EQ(d2.get(), &packet->Get<Decoration<2>>()) << "Shared pointer was copied rather than attached";
+
+  // A batch that cannot be completely attached is not attached at all
+  auto partial = factory->NewPacket();
+  partial->Decorate(Decoration<1>{});
+  ASSERT_THROW(partial->DecorateAll(Decoration<0>{}, Decoration<1>{}), autowiring_error);
+  ASSERT_FALSE(partial->Has<Decoration<0>>()) << "Part of a failed batch was attached";
+  ASSERT_THROW(partial->DecorateAll(Decoration<3>{}, Decoration<3>{}), autowiring_error) << "A type repeated within a batch was accepted";
+}
+
+TEST_F(AutoPacketTest, ContinuationsAndFutures) {
+  std::thread::id calledOn;
+  int observed = 0;
+  bool completed = false;
+  auto token = std::make_shared<bool>(false);
+  std::future<std::shared_ptr<const Decoration<1>>> value;
+  std::future<std::shared_ptr<const Decoration<2>>> unsatisfied;
+  std::future<std::shared_ptr<const Decoration<3>>> abandoned;
+  {
+    auto packet = factory->NewPacket();
+    packet->Then([&](const Decoration<0>& dec) {
+      calledOn = std::this_thread::get_id();
+      observed = dec.i;
+    });
+    packet->Then([token](const Decoration<4>&) {});
+    packet->OnComplete([&](const AutoPacket& packet) { completed = packet.Has<Decoration<0>>(); });
+    value = packet->GetFuture<Decoration<1>>();
+    unsatisfied = packet->GetFuture<Decoration<2>>();
+    abandoned = packet->GetFuture<Decoration<3>>();
+
+    std::thread([&] { packet->Decorate(Decoration<0>{5}); }).join();
+    ASSERT_EQ(5, observed) << "Continuation was not called when its input was attached";
+    ASSERT_FALSE(std::this_thread::get_id() == calledOn) << "Continuation was not called on the thread which satisfied it";
+
+    // Already satisfied, called before Then returns
+    observed = 0;
+    packet->Then([&](const Decoration<0>& dec) { observed = dec.i; });
+    ASSERT_EQ(5, observed) << "Continuation on a satisfied input was not called immediately";
+
+    packet->Decorate(Decoration<1>{7});
+    ASSERT_EQ(std::future_status::ready, value.wait_for(std::chrono::seconds(0))) << "Future was not ready once its decoration was attached";
+    packet->MarkUnsatisfiable<Decoration<2>>();
+    ASSERT_FALSE(completed) << "Completion callback was called before the packet was released";
+  }
+  ASSERT_TRUE(completed) << "Completion callback was not called when the packet was released";
+  ASSERT_TRUE(token.unique()) << "A continuation which was never called was not destroyed with its packet";
+  ASSERT_EQ(7, value.get()->i);
+  ASSERT_THROW(unsatisfied.get(), autowiring_error) << "Unsatisfiable decoration did not produce an error";
+  ASSERT_THROW(abandoned.get(), std::future_error) << "Future of a released packet was left pending";
+
+  // Nodes are kept by pooled packets and reused
+  factory->SetPacketPooling(true);
+  for (int i = 0; i < 3; i++) {
+    auto packet = factory->NewPacket();
+    packet->Then([&](const Decoration<0>& dec) { observed = dec.i; });
+    packet->Decorate(Decoration<0>{i});
+    ASSERT_EQ(i, observed) << "Continuation was not called on a reissued packet";
+  }
+}
@@ -2,6 +2,7 @@
 #include "stdafx.h"
 #include <autowiring/autowiring.h>
 #include <autowiring/AutowiringDebug.h>
+#include <autowiring/AutoFilterCriticalPath.h>
 #include "TestFixtures/Decoration.hpp"
 #include <algorithm>
 #include <fstream>
@@ -110,6 +111,90 @@ TEST_F(AutowiringDebugTest, FilterInfoTest) {
   ASSERT_NE(std::string{"Filter not found"}, text) << "Debug helper routine did not find a named filter in the current context as expected";
 }
 
+TEST_F(AutowiringDebugTest, AutoFilterProfile) {
+  AutoCurrentContext()->Initiate();
+  AutoRequired<AutoPacketFactory> factory;
+  AutoRequired<IntOutputer> filter1;
+  AutoRequired<IntInFloatIn> filter2;
+
+  factory->SetFilterProfiling(true);
+  factory->NewPacket();
+
+  auto text = autowiring::dbg::AutoFilterProfileStr();
+  ASSERT_NE(std::string::npos, text.find("IntOutputer")) << "Profile did not list a filter that was called";
+  ASSERT_NE(std::string::npos, text.find("IntInFloatIn")) << "Profile did not list a filter that was skipped";
+}
+
+struct IntInCharOut {
+  void AutoFilter(const int& i, char& c) {}
+};
+
+struct FloatInCharIn {
+  void AutoFilter(const float& f, const char& c) {}
+};
+
+TEST_F(AutowiringDebugTest, CriticalPath) {
+  // IntOutputer feeds two branches which join at FloatInCharIn, the float branch is the slower one
+  std::vector<autowiring::AutoFilterDescriptor> descriptors{
+    autowiring::MakeAutoFilterDescriptor(std::make_shared<IntOutputer>()),
+    autowiring::MakeAutoFilterDescriptor(std::make_shared<IntInFloatOut>()),
+    autowiring::MakeAutoFilterDescriptor(std::make_shared<IntInCharOut>()),
+    autowiring::MakeAutoFilterDescriptor(std::make_shared<FloatInCharIn>())
+  };
+  const std::chrono::milliseconds latencies[] = {
+    std::chrono::milliseconds(1),
+    std::chrono::milliseconds(3),
+    std::chrono::milliseconds(1),
+    std::chrono::milliseconds(2)
+  };
+
+  std::vector<autowiring::AutoFilterProfile> profiles(descriptors.size());
+  for (size_t i = 0; i < descriptors.size(); i++) {
+    profiles[i].descriptor = descriptors[i];
+    profiles[i].pFilter = descriptors[i].GetAutoFilter().ptr();
+    profiles[i].latency.Record(latencies[i]);
+  }
+
+  autowiring::AutoFilterCriticalPath path(descriptors, profiles);
+  ASSERT_EQ(std::chrono::milliseconds(6), path.GetLength()) << "Critical path length was incorrect";
+  ASSERT_EQ(std::chrono::milliseconds(7), path.GetTotalWork()) << "Total work was incorrect";
+  ASSERT_DOUBLE_EQ(7.0 / 6.0, path.GetSpeedup()) << "Speedup bound was incorrect";
+
+  const std::vector<size_t> expected{0, 1, 3};
+  ASSERT_EQ(expected, path.GetCriticalPath()) << "Critical path passed through the wrong filters";
+
+  const auto& filters = path.GetFilters();
+  ASSERT_EQ(std::chrono::milliseconds(2), filters[2].GetSlack()) << "Filter off the critical path had the wrong slack";
+  ASSERT_EQ(std::chrono::milliseconds(1), filters[2].earliestStart) << "Filter was not scheduled after its input";
+  for (size_t i : expected)
+    ASSERT_TRUE(filters[i].IsCritical()) << "Filter on the critical path had slack";
+
+  std::stringstream gv;
+  path.WriteGV(gv);
+  ASSERT_NE(std::string::npos, gv.str().find("color=red")) << "Critical path was not highlighted in the graph";
+
+  // The report is also available through the debug routines for the current context
+  AutoCurrentContext()->Initiate();
+  AutoRequired<AutoPacketFactory> factory;
+  AutoRequired<IntOutputer> filter1;
+  AutoRequired<IntInFloatOut> filter2;
+  factory->SetFilterProfiling(true);
+  factory->NewPacket();
+
+  auto text = autowiring::dbg::CriticalPathStr();
+  ASSERT_NE(std::string::npos, text.find("IntInFloatOut")) << "Report did not list a filter in the current context";
+}
+
+TEST_F(AutowiringDebugTest, CriticalPathWithoutFactory) {
+  // Both forms of the report describe an empty network when there is no factory
+  auto text = autowiring::dbg::CriticalPathStr();
+  ASSERT_NE(std::string::npos, text.find("Critical path: 0 us")) << "Empty network was not reported";
+
+  std::stringstream gv;
+  autowiring::dbg::WriteCriticalPathGraph(gv);
+  ASSERT_NE(std::string::npos, gv.str().find("digraph")) << "Empty network was not written as a graph";
+}
+
 TEST_F(AutowiringDebugTest, BasicAutoFilterGraph) {
   AutoRequired<AutoPacketFactory> factory;
   AutoRequired<IntOutputer> filter1;
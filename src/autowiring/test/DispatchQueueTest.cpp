@@ -2,6 +2,7 @@
 #include "stdafx.h"
 #include <autowiring/CoreThread.h>
 #include <autowiring/DispatchQueue.h>
+#include <array>
 #include <thread>
 #include FUTURE_HEADER
 
@@ -335,3 +336,323 @@ TEST_F(DispatchQueueTest, MixedCancel) {
   ASSERT_FALSE(called1.unique()) << "Cancellation cancelled the wrong lambda";
   ASSERT_TRUE(called2.unique()) << "Cancellation cancelled the wrong lambda";
 }
+
+TEST_F(DispatchQueueTest, InboxPreservesOrder) {
+  static const size_t nProducers = 4;
+  static const size_t nPerProducer = 1000;
+  EnableInbox();
+  SetDispatcherCap(nProducers * nPerProducer);
+  std::vector<size_t> lastSeen(nProducers, 0);
+  bool outOfOrder = false;
+
+  std::vector<std::thread> producers;
+  for (size_t i = 0; i < nProducers; i++)
+    producers.emplace_back([&, i] {
+      for (size_t j = 1; j <= nPerProducer; j++)
+        *this += [&, i, j] {
+          if (lastSeen[i] + 1 != j)
+            outOfOrder = true;
+          lastSeen[i] = j;
+        };
+    });
+
+  // Dispatch concurrently with the producers
+  size_t nDispatched = 0;
+  while (nDispatched < nProducers * nPerProducer)
+    if (WaitForEvent(std::chrono::seconds(5)))
+      nDispatched++;
+    else
+      break;
+
+  for (auto& producer : producers)
+    producer.join();
+
+  ASSERT_EQ(nProducers * nPerProducer, nDispatched) << "Not all dispatchers pended to the inbox were run";
+  ASSERT_FALSE(outOfOrder) << "Dispatchers pended by one thread were not run in the order they were pended";
+  ASSERT_FALSE(AreAnyDispatchersReady()) << "Dispatchers remained after all were run";
+}
+
+TEST_F(DispatchQueueTest, InboxRespectsCapAndAbort) {
+  EnableInbox();
+  SetDispatcherCap(2);
+
+  ASSERT_TRUE(*this += [] {});
+  ASSERT_TRUE(*this += [] {});
+  ASSERT_FALSE(*this += [] {}) << "Inbox accepted a dispatcher beyond the dispatch cap";
+  ASSERT_EQ(2UL, GetDispatchQueueLength()) << "Rejected dispatcher was counted";
+
+  // Barrier must wait for entries still in the inbox
+  ASSERT_FALSE(Barrier(std::chrono::seconds(0))) << "Barrier passed with entries in the inbox";
+
+  auto called = std::make_shared<bool>(false);
+  Abort();
+  ASSERT_FALSE(*this += [called] { *called = true; }) << "Inbox accepted a dispatcher after the queue was aborted";
+  ASSERT_TRUE(called.unique()) << "Dispatcher rejected after abort was leaked";
+  ASSERT_EQ(0UL, GetDispatchQueueLength()) << "Abort did not dump dispatchers in the inbox";
+}
+
+TEST_F(DispatchQueueTest, AbortDuringInboxPendStrandsNothing) {
+  EnableInbox();
+
+  auto token = std::make_shared<bool>(false);
+  std::atomic<bool> stop{false};
+  std::vector<std::thread> producers;
+  for (size_t i = 0; i < 4; i++)
+    producers.emplace_back([&] {
+      while (!stop)
+        *this += [token] {};
+    });
+
+  // Abort while producers are still reserving places in the queue
+  while (!GetDispatchQueueLength())
+    std::this_thread::yield();
+  Abort();
+  stop = true;
+  for (auto& producer : producers)
+    producer.join();
+
+  ASSERT_EQ(0UL, GetDispatchQueueLength()) << "A dispatcher pended concurrently with Abort was left in the inbox";
+  ASSERT_TRUE(token.unique()) << "A dispatcher pended concurrently with Abort was not deleted";
+}
+
+TEST_F(DispatchQueueTest, MultipleProducersOneCoreThread) {
+  AutoCurrentContext()->Initiate();
+  AutoRequired<CoreThread> ct;
+
+  static const size_t nProducers = 8;
+  static const size_t nPerProducer = 1000;
+  std::atomic<size_t> count{0};
+
+  // Dispatchers in excess of the dispatch cap are dropped, only those that were accepted must run
+  std::atomic<size_t> accepted{0};
+
+  std::vector<std::thread> producers;
+  for (size_t i = 0; i < nProducers; i++)
+    producers.emplace_back([&] {
+      for (size_t j = 0; j < nPerProducer; j++)
+        if (*ct += [&count] { count++; })
+          accepted++;
+    });
+  for (auto& producer : producers)
+    producer.join();
+
+  ASSERT_TRUE(ct->Barrier(std::chrono::seconds(10))) << "Barrier did not complete after all producers were done";
+  ASSERT_EQ(accepted, count) << "Dispatchers pended concurrently were lost";
+}
+
+TEST_F(DispatchQueueTest, SmallThunksAreRecycled) {
+  int count = 0;
+  auto pendAndRun = [&] {
+    for (size_t i = 0; i < 256; i++)
+      *this += [&count] { count++; };
+    DispatchAllEvents();
+  };
+
+  // First pass may need to obtain storage, subsequent passes must reuse it
+  pendAndRun();
+  size_t nAllocations = autowiring::DispatchThunkBase::GetHeapAllocationCount();
+  pendAndRun();
+  pendAndRun();
+  ASSERT_EQ(768, count) << "Not all dispatchers were run";
+  ASSERT_EQ(nAllocations, autowiring::DispatchThunkBase::GetHeapAllocationCount()) << "Steady state pend of a small lambda allocated from the heap";
+
+  // Delayed dispatchers are held in thunks as well
+  *this += std::chrono::microseconds(1), [&count] { count++; };
+  ASSERT_TRUE(WaitForEvent(std::chrono::seconds(5)));
+  ASSERT_EQ(nAllocations, autowiring::DispatchThunkBase::GetHeapAllocationCount()) << "Delayed pend of a small lambda allocated from the heap";
+
+  // Large callables cannot use recycled storage
+  std::array<char, autowiring::DispatchThunkBase::sc_blockSize> large{};
+  *this += [large, &count] { count += large[0] + 1; };
+  ASSERT_EQ(nAllocations + 1, autowiring::DispatchThunkBase::GetHeapAllocationCount()) << "Large lambda was not held on the heap";
+  DispatchAllEvents();
+  ASSERT_EQ(770, count) << "Large lambda was not run";
+
+  // Thunks keep the storage of the queue that created them after that queue is gone
+  {
+    DispatchQueue source;
+    source += [&count] { count++; };
+    *this += std::move(source);
+  }
+  DispatchAllEvents();
+  ASSERT_EQ(771, count) << "Lambda moved from a destroyed queue was not run";
+}
+
+TEST_F(DispatchQueueTest, BatchRequeuesAfterException) {
+  std::vector<int> order;
+  *this += [&] { order.push_back(1); };
+  *this += [&] { throw std::runtime_error("Dispatcher failure"); };
+  *this += [&] { order.push_back(3); };
+  *this += [&] { order.push_back(4); };
+
+  ASSERT_THROW(DispatchAllEvents(), std::runtime_error) << "Exception thrown by a dispatcher in a batch was not propagated";
+  ASSERT_EQ(std::vector<int>{1}, order) << "Dispatchers after the one that threw were run";
+  ASSERT_EQ(2UL, GetDispatchQueueLength()) << "Remainder of the batch was not returned to the queue";
+
+  // Anything pended later must still follow the remainder
+  *this += [&] { order.push_back(5); };
+  ASSERT_EQ(3, DispatchAllEvents());
+  ASSERT_EQ((std::vector<int>{1, 3, 4, 5}), order) << "Remainder of the batch was not run in order";
+}
+
+TEST_F(DispatchQueueTest, BatchStopsOnAbort) {
+  auto called = std::make_shared<bool>(false);
+  *this += [] {};
+  *this += [this] { Abort(); };
+  *this += [called] { *called = true; };
+
+  ASSERT_EQ(2, DispatchAllEvents()) << "Batch did not stop when the queue was aborted";
+  ASSERT_FALSE(*called) << "Dispatcher was run after the queue was aborted";
+  ASSERT_TRUE(called.unique()) << "Remainder of an aborted batch was leaked";
+  ASSERT_EQ(0UL, GetDispatchQueueLength()) << "Remainder of an aborted batch was still counted";
+}
+
+TEST_F(DispatchQueueTest, WaitForEventsHonorsLimit) {
+  int count = 0;
+  for (int i = 0; i < 5; i++)
+    *this += [&count] { count++; };
+
+  ASSERT_EQ(2UL, WaitForEvents(2)) << "Batch dispatched an unexpected number of events";
+  ASSERT_EQ(2, count);
+  ASSERT_EQ(3UL, GetDispatchQueueLength()) << "Events beyond the batch limit were not left in the queue";
+  ASSERT_EQ(3UL, WaitForEvents()) << "Unlimited batch did not dispatch all ready events";
+  ASSERT_EQ(5, count);
+}
+
+namespace {
+  class InterruptibleQueue:
+    public DispatchQueue
+  {
+  public:
+    bool interrupt = false;
+
+  protected:
+    bool ShouldInterruptBatch(void) const override { return interrupt; }
+  };
+}
+
+TEST_F(DispatchQueueTest, InterruptedBatchIsReturnedToQueue) {
+  InterruptibleQueue dq;
+  int count = 0;
+  dq += [&] {
+    count++;
+    dq.interrupt = true;
+  };
+  for (int i = 0; i < 3; i++)
+    dq += [&count] { count++; };
+
+  ASSERT_EQ(1UL, dq.WaitForEvents()) << "Batch was not interrupted after the first event";
+  ASSERT_EQ(1, count);
+  ASSERT_EQ(3UL, dq.GetDispatchQueueLength()) << "Remainder of an interrupted batch was lost";
+  ASSERT_TRUE(dq.AreAnyDispatchersReady()) << "Remainder of an interrupted batch was not returned to the queue";
+  ASSERT_TRUE(dq.Cancel()) << "Remainder of an interrupted batch could not be cancelled";
+
+  // DispatchAllEvents always runs the queue down
+  ASSERT_EQ(2, dq.DispatchAllEvents());
+  ASSERT_EQ(3, count);
+}
+
+TEST_F(DispatchQueueTest, TimerWheelDispatchesInOrder) {
+  EnableTimerWheel();
+
+  std::vector<int> order;
+  *this += std::chrono::milliseconds(30), [&] { order.push_back(30); };
+  *this += std::chrono::milliseconds(10), [&] { order.push_back(10); };
+  *this += std::chrono::hours(2), [&] { order.push_back(-1); };
+  *this += std::chrono::milliseconds(20), [&] { order.push_back(20); };
+  ASSERT_EQ(4UL, GetDispatchQueueLength()) << "Delayed dispatchers on the timer wheel were not counted";
+
+  for (size_t i = 0; i < 3; i++)
+    ASSERT_TRUE(WaitForEvent(std::chrono::seconds(5))) << "Delayed dispatcher did not become ready";
+  ASSERT_EQ((std::vector<int>{10, 20, 30}), order) << "Delayed dispatchers were not run in the order they became ready";
+  ASSERT_EQ(1UL, GetDispatchQueueLength());
+  ASSERT_TRUE(Cancel()) << "Failed to cancel a dispatcher held by the timer wheel";
+  ASSERT_EQ(0UL, GetDispatchQueueLength());
+}
+
+TEST_F(DispatchQueueTest, TimerWheelTurnsThroughAllLevels) {
+  // Microsecond resolution, so that delays which span every level of the wheel can be simulated quickly
+  autowiring::DispatchTimerWheel wheel(std::chrono::microseconds(1));
+  auto base = std::chrono::steady_clock::now();
+
+  const std::array<std::chrono::microseconds, 9> delays = {{
+    std::chrono::microseconds(1),
+    std::chrono::microseconds(100),
+    std::chrono::microseconds(255),
+    std::chrono::microseconds(256),
+    std::chrono::microseconds(5000),
+    std::chrono::microseconds(20000),
+    std::chrono::microseconds(3000000),
+    std::chrono::microseconds(80000000),
+    std::chrono::microseconds(400000000)
+  }};
+
+  // The times of the steps before and at which each dispatcher was released
+  std::vector<std::pair<std::chrono::steady_clock::time_point, std::chrono::steady_clock::time_point>> ran(delays.size());
+  auto previous = base;
+  auto now = base;
+  size_t nRan = 0;
+  for (size_t i = 0; i < delays.size(); i++)
+    wheel.Insert(
+      autowiring::DispatchThunkDelayed(
+        base + delays[i],
+        new autowiring::DispatchThunk<std::function<void()>>([&, i] {
+          ran[i] = std::make_pair(previous, now);
+          nRan++;
+        }),
+        i + 1
+      )
+    );
+  ASSERT_EQ(delays.size(), wheel.size());
+
+  // Turn the wheel forward in irregular steps
+  for (std::chrono::microseconds step(37); !wheel.empty(); step = step * 3 / 2 + std::chrono::microseconds(1)) {
+    ASSERT_LE(wheel.NextReadyTime(), base + delays[nRan]) << "Timer wheel reported a next ready time later than the soonest delayed dispatcher";
+    previous = now;
+    now += step;
+
+    autowiring::DispatchThunkBase* pHead = nullptr;
+    autowiring::DispatchThunkBase* pTail = nullptr;
+    size_t n = wheel.PopReady(now, pHead, pTail);
+    for (auto cur = pHead; cur; n--) {
+      auto next = cur->m_pFlink;
+      (*cur)();
+      delete cur;
+      cur = next;
+    }
+    ASSERT_EQ(0UL, n) << "Number of released dispatchers was not reported correctly";
+  }
+
+  // Each dispatcher must have been released by the first step at or after the time it became ready
+  for (size_t i = 0; i < delays.size(); i++) {
+    ASSERT_LE(base + delays[i], ran[i].second) << "Dispatcher " << i << " was released before it was ready";
+    ASSERT_GT(base + delays[i], ran[i].first) << "Dispatcher " << i << " was released late";
+  }
+}
+
+TEST_F(DispatchQueueTest, CancelByHandle) {
+  for (bool useTimerWheel : {false, true}) {
+    DispatchQueue dq;
+    if (useTimerWheel)
+      dq.EnableTimerWheel();
+
+    auto called1 = std::make_shared<bool>(false);
+    auto called2 = std::make_shared<bool>(false);
+    auto h1 = (dq += std::chrono::milliseconds(1), [called1] { *called1 = true; });
+    auto h2 = (dq += std::chrono::hours(1), [called2] { *called2 = true; });
+    auto h3 = (dq += std::chrono::seconds(0), [] {});
+    ASSERT_TRUE(h1 && h2) << "Delayed dispatchers were not assigned handles";
+    ASSERT_FALSE(h3) << "A dispatcher pended without delay was assigned a handle";
+
+    ASSERT_TRUE(dq.Cancel(h2)) << "Failed to cancel a delayed dispatcher by its handle";
+    ASSERT_TRUE(called2.unique()) << "Cancelled dispatcher was leaked";
+    ASSERT_FALSE(dq.Cancel(h2)) << "Dispatcher was cancelled twice";
+    ASSERT_FALSE(dq.Cancel(h3)) << "An empty handle cancelled a dispatcher";
+
+    ASSERT_TRUE(dq.DispatchEvent());
+    ASSERT_TRUE(dq.WaitForEvent(std::chrono::seconds(5))) << "Remaining delayed dispatcher was not run";
+    ASSERT_TRUE(*called1) << "Wrong dispatcher was cancelled";
+    ASSERT_FALSE(dq.Cancel(h1)) << "A dispatcher which already ran was cancelled";
+    ASSERT_EQ(0UL, dq.GetDispatchQueueLength());
+  }
+}
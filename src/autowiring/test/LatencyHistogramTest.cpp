@@ -0,0 +1,134 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#include "stdafx.h"
+#include <autowiring/LatencyHistogram.h>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+using autowiring::LatencyHistogram;
+
+/// <returns>The sample at the rank that LatencyHistogram::GetPercentile looks for</returns>
+static uint64_t ExactPercentile(const std::vector<uint64_t>& sorted, double percentile) {
+  double rank = std::ceil(percentile / 100.0 * sorted.size());
+  size_t index = rank < 1.0 ? 0 : rank > sorted.size() ? sorted.size() - 1 : static_cast<size_t>(rank) - 1;
+  return sorted[index];
+}
+
+/// <summary>
+/// Asserts that the estimate is no smaller than the exact value, and no larger than the documented error allows
+/// </summary>
+static void ExpectWithinError(uint64_t exact, std::chrono::nanoseconds estimate, const char* what) {
+  uint64_t value = static_cast<uint64_t>(estimate.count());
+  EXPECT_LE(exact, value) << what << " was underestimated";
+  EXPECT_LE(value, exact + exact / LatencyHistogram::sc_subBucketCount) << what << " exceeded the relative error of the histogram";
+}
+
+TEST(LatencyHistogramTest, Empty) {
+  LatencyHistogram hist;
+  ASSERT_EQ(0UL, hist.GetCount());
+  ASSERT_EQ(0, hist.GetMax().count());
+  ASSERT_EQ(0, hist.GetMean().count());
+  ASSERT_EQ(0, hist.GetPercentile(50).count()) << "An empty histogram reported a percentile";
+}
+
+TEST(LatencyHistogramTest, SmallValuesAreExact) {
+  for (uint64_t v = 0; v < LatencyHistogram::sc_subBucketCount; v++) {
+    // The outlier keeps the percentile from being clamped to the largest sample
+    LatencyHistogram hist;
+    hist.Record(std::chrono::nanoseconds(v));
+    hist.Record(std::chrono::hours(1));
+    ASSERT_EQ(v, static_cast<uint64_t>(hist.GetPercentile(50).count())) << "Value below the first power of two was not recorded exactly";
+  }
+}
+
+TEST(LatencyHistogramTest, BucketEdges) {
+  const uint64_t width = LatencyHistogram::sc_subBucketCount;
+  for (int power = LatencyHistogram::sc_subBucketBits; power < 40; power++) {
+    const uint64_t edge = uint64_t(1) << power;
+    const uint64_t step = edge / width;
+
+    LatencyHistogram below;
+    below.Record(std::chrono::nanoseconds(edge - 1));
+    below.Record(std::chrono::hours(1));
+    ASSERT_EQ(edge - 1, static_cast<uint64_t>(below.GetPercentile(50).count())) << "Value at the top of a bucket was not its own estimate, at 2^" << power;
+
+    LatencyHistogram at;
+    at.Record(std::chrono::nanoseconds(edge));
+    at.Record(std::chrono::hours(1));
+    ASSERT_EQ(edge + step - 1, static_cast<uint64_t>(at.GetPercentile(50).count())) << "Value at the bottom of a bucket was not placed in that bucket, at 2^" << power;
+  }
+}
+
+TEST(LatencyHistogramTest, PercentilesOfKnownSamples) {
+  // A uniform body of one to ten milliseconds, with a tail of one second outliers
+  std::vector<uint64_t> samples;
+  for (uint64_t i = 1; i <= 10000; i++)
+    samples.push_back(i * 1000);
+  for (size_t i = 10; i--;)
+    samples.push_back(1000000000);
+
+  LatencyHistogram hist;
+  for (uint64_t sample : samples)
+    hist.Record(std::chrono::nanoseconds(sample));
+  std::sort(samples.begin(), samples.end());
+
+  ASSERT_EQ(samples.size(), hist.GetCount());
+  ASSERT_EQ(1000000000, hist.GetMax().count()) << "Largest sample was not recorded exactly";
+  ExpectWithinError(ExactPercentile(samples, 50), hist.GetPercentile(50), "p50");
+  ExpectWithinError(ExactPercentile(samples, 99), hist.GetPercentile(99), "p99");
+  ExpectWithinError(ExactPercentile(samples, 99.9), hist.GetPercentile(99.9), "p99.9");
+  ASSERT_EQ(1000000000, hist.GetPercentile(99.99).count()) << "Outlier percentile was not clamped to the largest sample";
+  ASSERT_EQ(1000000000, hist.GetPercentile(100).count()) << "p100 was not the largest sample";
+
+  // Negative durations are recorded as zero
+  LatencyHistogram negative;
+  negative.Record(std::chrono::nanoseconds(-5));
+  ASSERT_EQ(0, negative.GetMax().count());
+  ASSERT_EQ(0, negative.GetPercentile(100).count());
+}
+
+TEST(LatencyHistogramTest, ConcurrentStripesMerge) {
+  static const size_t nThreads = 4;
+  static const size_t nSamples = 10000;
+
+  // Each thread records into its own stripe and into one shared histogram, and the largest value is
+  // recorded by a different thread than the smallest so that the shared maximum is contended
+  auto sample = [](size_t thread, size_t i) {
+    return uint64_t(1) + (i * nThreads + thread) * 37;
+  };
+
+  std::vector<LatencyHistogram> stripes(nThreads);
+  LatencyHistogram shared;
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < nThreads; t++)
+    threads.emplace_back([&, t] {
+      for (size_t i = 0; i < nSamples; i++) {
+        std::chrono::nanoseconds value(sample(t, i));
+        stripes[t].Record(value);
+        shared.Record(value);
+      }
+    });
+  for (auto& thread : threads)
+    thread.join();
+
+  LatencyHistogram merged;
+  for (const auto& stripe : stripes)
+    merged.Merge(stripe);
+
+  LatencyHistogram reference;
+  for (size_t t = 0; t < nThreads; t++)
+    for (size_t i = 0; i < nSamples; i++)
+      reference.Record(std::chrono::nanoseconds(sample(t, i)));
+
+  const auto max = static_cast<std::chrono::nanoseconds::rep>(sample(nThreads - 1, nSamples - 1));
+  for (const LatencyHistogram* hist : {&merged, &shared}) {
+    const char* name = hist == &merged ? "Merged stripes" : "Shared histogram";
+    ASSERT_EQ(reference.GetCount(), hist->GetCount()) << name << " lost samples";
+    ASSERT_EQ(max, hist->GetMax().count()) << name << " did not keep the largest sample";
+    ASSERT_EQ(reference.GetMean(), hist->GetMean()) << name << " had a different mean";
+    ASSERT_EQ(reference.GetStandardDeviation(), hist->GetStandardDeviation()) << name << " had a different deviation";
+    for (double p : {0.0, 10.0, 50.0, 90.0, 99.0, 99.9, 100.0})
+      ASSERT_EQ(reference.GetPercentile(p), hist->GetPercentile(p)) << name << " differed at percentile " << p;
+  }
+}
@@ -3,6 +3,7 @@
 #include <autowiring/autowiring.h>
 #include <autowiring/ManualThreadPool.h>
 #include <autowiring/NullPool.h>
+#include <autowiring/SystemThreadPoolStealing.h>
 #include <autowiring/SystemThreadPoolStl.h>
 #include FUTURE_HEADER
 
@@ -49,7 +50,29 @@ TYPED_TEST_P(ThreadPoolTest, PoolOverload) {
   ASSERT_EQ(std::future_status::ready, rs.wait_for(std::chrono::seconds(5))) << "Pool saturation did not complete in a timely fashion";
 }
 
-REGISTER_TYPED_TEST_CASE_P(ThreadPoolTest, PoolOverload);
+TYPED_TEST_P(ThreadPoolTest, NestedSubmission) {
+  static const size_t nRoots = 8;
+  static const size_t nChildren = 100;
+
+  auto ctr = std::make_shared<std::atomic<size_t>>(nRoots * nChildren);
+  auto p = std::make_shared<std::promise<void>>();
+  auto pool = this->m_pool;
+
+  // Work submitted from within the pool must be run just like work submitted from outside of it
+  for (size_t i = nRoots; i--;)
+    *pool += [=] {
+      for (size_t j = nChildren; j--;)
+        *pool += [=] {
+          if (!--*ctr)
+            p->set_value();
+        };
+    };
+
+  auto rs = p->get_future();
+  ASSERT_EQ(std::future_status::ready, rs.wait_for(std::chrono::seconds(5))) << "Nested submissions did not complete in a timely fashion";
+}
+
+REGISTER_TYPED_TEST_CASE_P(ThreadPoolTest, PoolOverload, NestedSubmission);
 
 typedef ::testing::Types<
 #ifdef _MSC_VER
@@ -58,8 +81,106 @@ typedef ::testing::Types<
   autowiring::SystemThreadPoolWinLH,
 #endif
 
-  // All platforms test the STL thread pool
-  autowiring::SystemThreadPoolStl
+  // All platforms test the STL and work-stealing thread pools
+  autowiring::SystemThreadPoolStl,
+  autowiring::SystemThreadPoolStealing
 > t_testTypes;
 
 INSTANTIATE_TYPED_TEST_CASE_P(My, ThreadPoolTest, t_testTypes);
+
+TEST(SystemThreadPoolStealingTest, HoldsWorkUntilRestarted) {
+  auto pool = autowiring::SystemThreadPool::New(autowiring::SystemThreadPoolType::WorkStealing);
+  ASSERT_TRUE(std::dynamic_pointer_cast<autowiring::SystemThreadPoolStealing>(pool) != nullptr) << "Work-stealing pool was not created as requested";
+
+  auto first = std::make_shared<std::promise<void>>();
+  auto token = pool->Start();
+  *pool += [first] { first->set_value(); };
+  ASSERT_EQ(std::future_status::ready, first->get_future().wait_for(std::chrono::seconds(5))) << "Work was not run by a started pool";
+  token.reset();
+
+  // Work submitted while stopped must wait for the pool to be started again
+  auto second = std::make_shared<std::promise<void>>();
+  auto rs = second->get_future();
+  *pool += [second] { second->set_value(); };
+  token = pool->Start();
+  ASSERT_EQ(std::future_status::ready, rs.wait_for(std::chrono::seconds(5))) << "Work submitted to a stopped pool was not run when it was restarted";
+}
+
+TEST(SystemThreadPoolStealingTest, SingleRootFanOutWakesWorkers) {
+  static const size_t nChildren = 4;
+  static const size_t nBusy = 3;
+
+  auto pool = std::make_shared<autowiring::SystemThreadPoolStealing>();
+  pool->SuggestThreadPoolSize(nChildren);
+  auto token = pool->Start();
+
+  // Give the workers time to find nothing to do and go to sleep
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  // Each child holds its worker until enough children are running at once, so the peak can only be
+  // reached if sleeping workers were woken for the work queued behind the first child
+  struct State {
+    std::mutex lock;
+    std::condition_variable cv;
+    size_t nRunning = 0;
+    size_t nPeak = 0;
+    size_t nDone = 0;
+  };
+  auto state = std::make_shared<State>();
+
+  *pool += [pool, state] {
+    for (size_t i = nChildren; i--;)
+      *pool += [state] {
+        std::unique_lock<std::mutex> lk(state->lock);
+        state->nPeak = std::max(state->nPeak, ++state->nRunning);
+        state->cv.notify_all();
+        state->cv.wait_for(lk, std::chrono::seconds(1), [state] { return state->nPeak >= nBusy; });
+        state->nRunning--;
+        state->nDone++;
+        state->cv.notify_all();
+      };
+  };
+
+  std::unique_lock<std::mutex> lk(state->lock);
+  ASSERT_TRUE(state->cv.wait_for(lk, std::chrono::seconds(10), [state] { return state->nDone == nChildren; })) << "Fanned out work did not complete";
+  ASSERT_LE(nBusy, state->nPeak) << "Work fanned out from a single root was not spread across sleeping workers";
+}
+
+TEST(SystemThreadPoolStlTest, GrowsAndRetiresIdleWorkers) {
+  auto pool = std::make_shared<autowiring::SystemThreadPoolStl>();
+  pool->SuggestThreadPoolSize(1);
+  pool->SetMaxThreadPoolSize(4);
+  pool->SetGrowthThresholds(1, std::chrono::hours(1));
+  pool->SetIdleTimeout(std::chrono::milliseconds(20));
+  auto token = pool->Start();
+  ASSERT_EQ(2UL, pool->GetThreadCount()) << "A suggested size below the default minimum lowered the minimum";
+
+  // Occupy workers until the backlog is large enough to grow the pool to its maximum size.  No thunk
+  // can finish until it is released, so the queue length grows with every submission however the
+  // workers are scheduled, and no worker may retire while the queue is nonempty.
+  auto release = std::make_shared<std::promise<void>>();
+  std::shared_future<void> released = release->get_future().share();
+  auto ctr = std::make_shared<std::atomic<size_t>>(8);
+  auto done = std::make_shared<std::promise<void>>();
+  for (size_t i = 8; i--;)
+    *pool += [=] {
+      released.wait();
+      if (!--*ctr)
+        done->set_value();
+    };
+  ASSERT_EQ(4UL, pool->GetThreadCount()) << "Pool did not grow to its maximum size under backlog";
+
+  release->set_value();
+  ASSERT_EQ(std::future_status::ready, done->get_future().wait_for(std::chrono::seconds(5))) << "Backlog was not processed";
+
+  // Workers beyond the minimum size must eventually be retired
+  auto limit = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (pool->GetThreadCount() > 2 && std::chrono::steady_clock::now() < limit)
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  ASSERT_EQ(2UL, pool->GetThreadCount()) << "Idle workers were not retired";
+
+  // Retired workers must be replaced if the backlog grows again
+  auto again = std::make_shared<std::promise<void>>();
+  *pool += [again] { again->set_value(); };
+  ASSERT_EQ(std::future_status::ready, again->get_future().wait_for(std::chrono::seconds(5))) << "Pool stopped running work after retiring workers";
+}
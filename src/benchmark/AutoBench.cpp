@@ -7,6 +7,7 @@
 #include "ObjectPoolBm.h"
 #include "PrintableDuration.h"
 #include "PriorityBoost.h"
+#include "ThreadPoolBm.h"
 #include <map>
 #include <iomanip>
 #include <iostream>
@@ -48,6 +49,7 @@ static std::map<std::string, Entry> sc_commands = {
   MakeEntry("contextenum", "CoreContextEnumerator profiling", &ContextTrackingBm::ContextEnum),
   MakeEntry("contextmap", "ContextMap profiling", &ContextTrackingBm::ContextMap),
   MakeEntry("objpool", "Object pool behaviors", &ObjectPoolBm::Allocation),
+  MakeEntry("threadpool", "Thread pool submission rate", &ThreadPoolBm::Submission),
 };
 
 static Benchmark All(void) {
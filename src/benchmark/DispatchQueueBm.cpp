@@ -4,7 +4,18 @@
 #include "Benchmark.h"
 #include <autowiring/CoreThread.h>
 #include FUTURE_HEADER
+#include <stdexcept>
+#include <string>
 #include <thread>
+#include <vector>
+
+// Thunk storage is obtained a slab at a time, never once per lambda, so even if no lambda were run
+// until all of them had been pended there could be no more allocations than slabs
+static void CheckHeapAllocations(size_t nAllocations, size_t nLambdas) {
+  const size_t nSlabs = (nLambdas + autowiring::DispatchThunkPool::sc_slabBlocks - 1) / autowiring::DispatchThunkPool::sc_slabBlocks;
+  if (nAllocations > nSlabs)
+    throw std::runtime_error("Dispatch queue obtained thunk storage from the heap more often than once per slab");
+}
 
 Benchmark DispatchQueueBm::Dispatch(void) {
   static const size_t n = 10000;
@@ -67,12 +78,42 @@ Benchmark DispatchQueueBm::Dispatch(void) {
         std::string s = "Hello world";
         auto l = [&x, s] { x += s.length(); };
 
+        size_t nAllocations = autowiring::DispatchThunkBase::GetHeapAllocationCount();
         sw.Start();
         for (size_t i = n; i--;)
           *ct += l;
         ctxt->SignalShutdown();
         ctxt->Wait();
         sw.Stop(n);
+        CheckHeapAllocations(autowiring::DispatchThunkBase::GetHeapAllocationCount() - nAllocations, n);
+      }
+    },
+    {
+      "DispatchQueue::operator+= (8 producers)",
+      [](Stopwatch& sw) {
+        static const size_t nProducers = 8;
+        AutoCreateContext ctxt;
+        CurrentContextPusher pshr(ctxt);
+        AutoRequired<CoreThread> ct;
+        ctxt->Initiate();
+
+        std::atomic<size_t> x{0};
+        auto l = [&x] { x++; };
+
+        std::vector<std::thread> producers;
+        size_t nAllocations = autowiring::DispatchThunkBase::GetHeapAllocationCount();
+        sw.Start();
+        for (size_t i = nProducers; i--;)
+          producers.emplace_back([&] {
+            for (size_t j = n / nProducers; j--;)
+              *ct += l;
+          });
+        for (auto& producer : producers)
+          producer.join();
+        ctxt->SignalShutdown();
+        ctxt->Wait();
+        sw.Stop(n);
+        CheckHeapAllocations(autowiring::DispatchThunkBase::GetHeapAllocationCount() - nAllocations, n);
       }
     }
   };
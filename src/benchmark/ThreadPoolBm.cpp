@@ -0,0 +1,67 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#include "stdafx.h"
+#include "ThreadPoolBm.h"
+#include "Benchmark.h"
+#include <autowiring/SystemThreadPoolStealing.h>
+#include <autowiring/SystemThreadPoolStl.h>
+#include FUTURE_HEADER
+#include <stdexcept>
+
+static const size_t n = 10000;
+
+// Number of jobs submitted from outside of the pool in the nested case, each one submits the rest from inside
+static const size_t nRoots = 16;
+
+template<typename T>
+void profile_external(Stopwatch& sw) {
+  auto pool = std::make_shared<T>();
+  pool->SuggestThreadPoolSize(4);
+  auto token = pool->Start();
+
+  std::atomic<size_t> remaining{n};
+  std::promise<void> done;
+
+  sw.Start();
+  for (size_t i = n; i--;)
+    *pool += [&] {
+      if (!--remaining)
+        done.set_value();
+    };
+  if (done.get_future().wait_for(std::chrono::seconds(30)) != std::future_status::ready)
+    throw std::runtime_error("Thread pool did not complete submitted work");
+  sw.Stop(n);
+}
+
+template<typename T>
+void profile_nested(Stopwatch& sw) {
+  auto pool = std::make_shared<T>();
+  pool->SuggestThreadPoolSize(4);
+  auto token = pool->Start();
+
+  std::atomic<size_t> remaining{n};
+  std::promise<void> done;
+  auto leaf = [&] {
+    if (!--remaining)
+      done.set_value();
+  };
+
+  sw.Start();
+  for (size_t i = nRoots; i--;)
+    *pool += [&] {
+      for (size_t j = n / nRoots - 1; j--;)
+        *pool += leaf;
+      leaf();
+    };
+  if (done.get_future().wait_for(std::chrono::seconds(30)) != std::future_status::ready)
+    throw std::runtime_error("Thread pool did not complete submitted work");
+  sw.Stop(n);
+}
+
+Benchmark ThreadPoolBm::Submission(void) {
+  return {
+    { "SystemThreadPoolStl (external)", &profile_external<autowiring::SystemThreadPoolStl> },
+    { "SystemThreadPoolStealing (external)", &profile_external<autowiring::SystemThreadPoolStealing> },
+    { "SystemThreadPoolStl (nested)", &profile_nested<autowiring::SystemThreadPoolStl> },
+    { "SystemThreadPoolStealing (nested)", &profile_nested<autowiring::SystemThreadPoolStealing> }
+  };
+}
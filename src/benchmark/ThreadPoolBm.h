@@ -0,0 +1,9 @@
+// Copyright (C) 2012-2015 Leap Motion, Inc. All rights reserved.
+#pragma once
+
+struct Benchmark;
+
+class ThreadPoolBm {
+public:
+  static Benchmark Submission(void);
+};